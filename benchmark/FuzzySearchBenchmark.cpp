@@ -7,6 +7,8 @@
 
 #include <Files.h>
 #include <FuzzySearch.h>
+#include <FuzzySearchCorpus.h>
+#include <FuzzySearchSearcher.h>
 
 std::vector<std::string> StringSearch(const std::vector<std::string>& split_by_space, const std::vector<std::string>& files)
 {
@@ -100,6 +102,50 @@ TEST_CASE("Fuzzy search benchmark")
 
 	BENCHMARK("FuzzyShortPattern") { return FuzzySearch::Search<const char*>("TABLE", files.begin(), files.end(), &GetStringFunc, config); };
 
+	FuzzySearch::Corpus corpus;
+	for (const std::string& file : files)
+	{
+		corpus.Add(file);
+	}
+
+	BENCHMARK("CorpusLongPattern") { return corpus.Search("qt base view list", config); };
+
+	BENCHMARK("CorpusShortPattern") { return corpus.Search("TABLE", config); };
+
+	FuzzySearch::CorpusConfig folded_config;
+	folded_config.m_KeepFoldedCopy = true;
+	FuzzySearch::Corpus folded_corpus(folded_config);
+	for (const std::string& file : files)
+	{
+		folded_corpus.Add(file);
+	}
+
+	BENCHMARK("FoldedCorpusLongPattern") { return folded_corpus.Search("qt base view list", config); };
+
+	BENCHMARK("FoldedCorpusShortPattern") { return folded_corpus.Search("TABLE", config); };
+
+	FuzzySearch::CorpusConfig block_config = folded_config;
+	block_config.m_TransposedBlocks = true;
+	FuzzySearch::Corpus block_corpus(block_config);
+	for (const std::string& file : files)
+	{
+		block_corpus.Add(file);
+	}
+
+	BENCHMARK("BlockCorpusLongPattern") { return block_corpus.Search("qt base view list", config); };
+
+	BENCHMARK("BlockCorpusShortPattern") { return block_corpus.Search("TABLE", config); };
+
+	const std::string long_pattern = "qt base view list";
+	const std::string short_pattern = "TABLE";
+
+	FuzzySearch::Searcher searcher;
+	searcher.SetCorpus(&folded_corpus);
+
+	BENCHMARK("SearcherLongPattern") { return searcher.Search(long_pattern, config).size(); };
+
+	BENCHMARK("SearcherShortPattern") { return searcher.Search(short_pattern, config).size(); };
+
 	BENCHMARK("BoyerMooreLongPattern") { return BoyerMoore(split_by_space_long, files); };
 
 	BENCHMARK("BoyerMooreShortPattern") { return BoyerMoore(split_by_space_short, files); };
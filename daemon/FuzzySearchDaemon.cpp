@@ -0,0 +1,286 @@
+#include <FuzzySearchCorpusImage.h>
+#include <FuzzySearchCrawler.h>
+#include <FuzzySearchGitIndex.h>
+#include <FuzzySearchServer.h>
+#include <FuzzySearchWatcher.h>
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace FuzzySearch;
+
+namespace
+{
+	struct Options
+	{
+		std::string m_SocketPath;
+		std::vector<std::string> m_Roots;
+		std::vector<std::string> m_IgnorePatterns;
+		uint32_t m_ThreadCount = 0;
+		bool m_Watch = false;
+		bool m_Git = false;
+		std::string m_ImagePath;
+		// Client mode, send one query to a running daemon
+		bool m_Query = false;
+		std::string m_Pattern;
+		uint32_t m_MaxResults = 20;
+	};
+
+	Server* g_Server = nullptr;
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr,
+			"usage: fuzzy_search_daemon [options] <socket> <directory>...\n"
+			"       fuzzy_search_daemon --query <pattern> [--max-results N] <socket>\n"
+			"\n"
+			"  --threads N      threads for crawling and searching, all cores by default\n"
+			"  --ignore GLOB    skip files and directories matching GLOB, can be repeated\n"
+			"  --watch          keep the corpus in sync with the directories (Linux)\n"
+			"  --git            read the tracked files of every directory from its .git/index,\n"
+			"                   not with --watch, which crawls and follows every file\n"
+			"  --image PATH     write the indexed corpus as an image other processes can attach to,\n"
+			"                   with --watch it is written again after every change\n");
+	}
+
+	bool ParseOptions(int argc, char** argv, Options& out_options)
+	{
+		std::vector<std::string> positional;
+		for (int index = 1; index < argc; ++index)
+		{
+			const std::string arg = argv[index];
+			const bool has_value = index + 1 < argc;
+			if (arg == "--threads" && has_value)
+			{
+				out_options.m_ThreadCount = static_cast<uint32_t>(std::strtoul(argv[++index], nullptr, 10));
+			}
+			else if (arg == "--ignore" && has_value)
+			{
+				out_options.m_IgnorePatterns.push_back(argv[++index]);
+			}
+			else if (arg == "--image" && has_value)
+			{
+				out_options.m_ImagePath = argv[++index];
+			}
+			else if (arg == "--query" && has_value)
+			{
+				out_options.m_Query = true;
+				out_options.m_Pattern = argv[++index];
+			}
+			else if (arg == "--max-results" && has_value)
+			{
+				out_options.m_MaxResults = static_cast<uint32_t>(std::strtoul(argv[++index], nullptr, 10));
+			}
+			else if (arg == "--watch")
+			{
+				out_options.m_Watch = true;
+			}
+			else if (arg == "--git")
+			{
+				out_options.m_Git = true;
+			}
+			else if (!arg.empty() && arg[0] == '-')
+			{
+				return false;
+			}
+			else
+			{
+				positional.push_back(arg);
+			}
+		}
+
+		if (positional.empty() || (out_options.m_Query && positional.size() != 1) || (!out_options.m_Query && positional.size() < 2))
+		{
+			return false;
+		}
+		// The watcher keeps every file below the directories, it has no notion of what git tracks
+		if (out_options.m_Git && out_options.m_Watch)
+		{
+			std::fprintf(stderr, "--git cannot be combined with --watch\n");
+			return false;
+		}
+		out_options.m_SocketPath = positional[0];
+		out_options.m_Roots.assign(positional.begin() + 1, positional.end());
+		return true;
+	}
+
+	int RunQuery(const Options& options)
+	{
+		using Clock = std::chrono::steady_clock;
+
+		Client client;
+		if (!client.Connect(options.m_SocketPath))
+		{
+			std::fprintf(stderr, "cannot connect to %s\n", options.m_SocketPath.c_str());
+			return EXIT_FAILURE;
+		}
+
+		SearchRequest request;
+		request.m_Pattern = options.m_Pattern;
+		request.m_MaxResults = options.m_MaxResults;
+		request.m_SearchConfig.m_MatchMode = MatchMode::E_SOURCE_FILES;
+		request.m_Flags = RequestFlags::E_INCLUDE_STRINGS;
+
+		const Clock::time_point start = Clock::now();
+		SearchResponse response;
+		if (!client.Send(request) || !client.Flush() || !client.Receive(response) || response.m_Status != ResponseStatus::E_OK)
+		{
+			std::fprintf(stderr, "query failed\n");
+			return EXIT_FAILURE;
+		}
+		const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+
+		for (size_t index = 0; index < response.m_Results.size(); ++index)
+		{
+			std::printf("%6d %s\n", response.m_Results[index].m_Score, response.m_Strings[index].c_str());
+		}
+		std::fprintf(stderr, "%zu results from version %llu in %lld us\n", response.m_Results.size(),
+			static_cast<unsigned long long>(response.m_Version), static_cast<long long>(elapsed.count()));
+		return EXIT_SUCCESS;
+	}
+
+	// Fills the corpus once, from the git index of a root when asked to and by crawling it otherwise
+	void IndexRoots(const Options& options, const CrawlerConfig& crawler_config, VersionedCorpus& corpus)
+	{
+		CorpusBatch batch;
+		std::vector<std::string> crawl_roots;
+		for (const std::string& root : options.m_Roots)
+		{
+			const std::string index_path = root + "/.git/index";
+			if (!options.m_Git || !std::filesystem::exists(index_path))
+			{
+				crawl_roots.push_back(root);
+				continue;
+			}
+
+			GitIndexConfig git_config;
+			git_config.m_PathPrefix = root + "/";
+			const GitIndexError error = ReadGitIndex(index_path, git_config, batch);
+			if (error != GitIndexError::E_NONE)
+			{
+				std::fprintf(stderr, "%s: %s, crawling instead\n", index_path.c_str(), GitIndexErrorName(error));
+				crawl_roots.push_back(root);
+			}
+		}
+
+		if (!crawl_roots.empty())
+		{
+			Crawler crawler(crawler_config);
+			crawler.Crawl(crawl_roots, batch);
+		}
+
+		corpus.Commit(batch);
+	}
+
+	bool WriteImage(const std::string& path, const VersionedCorpus& corpus)
+	{
+		const VersionedCorpus::Snapshot snapshot = corpus.Acquire();
+		const CorpusImageError error = CorpusImage::Write(*snapshot, corpus.Version(), path);
+		if (error != CorpusImageError::E_NONE)
+		{
+			std::fprintf(stderr, "%s: %s\n", path.c_str(), CorpusImageErrorName(error));
+			return false;
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	if (options.m_Query)
+	{
+		return RunQuery(options);
+	}
+
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point start = Clock::now();
+
+	CorpusConfig corpus_config;
+	corpus_config.m_SearchConfig.m_MatchMode = MatchMode::E_SOURCE_FILES;
+	corpus_config.m_BlockSummaries = true;
+	VersionedCorpus corpus(corpus_config);
+
+	CrawlerConfig crawler_config;
+	crawler_config.m_ThreadCount = options.m_ThreadCount;
+	crawler_config.m_IgnorePatterns = options.m_IgnorePatterns;
+
+	std::unique_ptr<Watcher> watcher;
+	if (options.m_Watch)
+	{
+		WatcherConfig watcher_config;
+		watcher_config.m_CrawlerConfig = crawler_config;
+		watcher = std::make_unique<Watcher>(corpus, watcher_config);
+		if (!watcher->Start(options.m_Roots))
+		{
+			std::fprintf(stderr, "cannot watch the directories\n");
+			return EXIT_FAILURE;
+		}
+	}
+	else
+	{
+		IndexRoots(options, crawler_config, corpus);
+	}
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+	std::fprintf(stderr, "indexed %zu paths in %lld ms\n", corpus.Acquire()->Size(), static_cast<long long>(elapsed.count()));
+
+	if (!options.m_ImagePath.empty() && !WriteImage(options.m_ImagePath, corpus))
+	{
+		return EXIT_FAILURE;
+	}
+
+	ServerConfig server_config;
+	server_config.m_SchedulerConfig.m_SearcherConfig.m_ThreadCount = options.m_ThreadCount;
+	Server server(corpus, server_config);
+	if (!server.Listen(options.m_SocketPath))
+	{
+		std::fprintf(stderr, "cannot listen on %s\n", options.m_SocketPath.c_str());
+		return EXIT_FAILURE;
+	}
+
+	// Changes the watcher commits also replace the image, processes that attached to it pick them up with a refresh
+	std::atomic<bool> stop_watching{ false };
+	std::thread watch_thread;
+	if (watcher)
+	{
+		watch_thread = std::thread([&]()
+		{
+			while (!stop_watching)
+			{
+				if (watcher->Poll(std::chrono::milliseconds(100)) > 0 && !options.m_ImagePath.empty())
+				{
+					WriteImage(options.m_ImagePath, corpus);
+				}
+			}
+		});
+	}
+
+	g_Server = &server;
+	auto stop = [](int) { g_Server->Stop(); };
+	std::signal(SIGINT, stop);
+	std::signal(SIGTERM, stop);
+
+	server.Run();
+
+	if (watch_thread.joinable())
+	{
+		stop_watching = true;
+		watch_thread.join();
+	}
+	return EXIT_SUCCESS;
+}
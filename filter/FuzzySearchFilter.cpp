@@ -0,0 +1,186 @@
+#include <FuzzySearchStreamFilter.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+using namespace FuzzySearch;
+
+namespace
+{
+	struct Options
+	{
+		std::string m_Pattern;
+		StreamFilterConfig m_Config;
+		bool m_Stats = false;
+	};
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr,
+			"usage: fuzzy_search_filter [options] <pattern> < lines\n"
+			"\n"
+			"  -n N             number of best lines to print, 50 by default\n"
+			"  --interval MS    time between redraws while reading when stdout is a terminal, 100 by default\n"
+			"  --threads N      match threads, all cores by default\n"
+			"  --mode MODE      strings, filenames or source-files (default)\n"
+			"  --stats          print line, match and timing counts to stderr\n");
+	}
+
+	bool ParseMatchMode(const std::string& name, MatchMode& out_mode)
+	{
+		if (name == "strings")
+		{
+			out_mode = MatchMode::E_STRINGS;
+		}
+		else if (name == "filenames")
+		{
+			out_mode = MatchMode::E_FILENAMES;
+		}
+		else if (name == "source-files")
+		{
+			out_mode = MatchMode::E_SOURCE_FILES;
+		}
+		else
+		{
+			return false;
+		}
+		return true;
+	}
+
+	bool ParseOptions(int argc, char** argv, Options& out_options)
+	{
+		out_options.m_Config.m_SearchConfig.m_MatchMode = MatchMode::E_SOURCE_FILES;
+
+		std::vector<std::string> positional;
+		for (int index = 1; index < argc; ++index)
+		{
+			const std::string arg = argv[index];
+			const bool has_value = index + 1 < argc;
+			if (arg == "-n" && has_value)
+			{
+				out_options.m_Config.m_MaxResults = std::strtoul(argv[++index], nullptr, 10);
+			}
+			else if (arg == "--interval" && has_value)
+			{
+				out_options.m_Config.m_UpdateInterval = std::chrono::milliseconds(std::strtoul(argv[++index], nullptr, 10));
+			}
+			else if (arg == "--threads" && has_value)
+			{
+				out_options.m_Config.m_MatchThreadCount = std::strtoul(argv[++index], nullptr, 10);
+			}
+			else if (arg == "--mode" && has_value)
+			{
+				if (!ParseMatchMode(argv[++index], out_options.m_Config.m_SearchConfig.m_MatchMode))
+				{
+					return false;
+				}
+			}
+			else if (arg == "--stats")
+			{
+				out_options.m_Stats = true;
+			}
+			else if (!arg.empty() && arg[0] == '-')
+			{
+				return false;
+			}
+			else
+			{
+				positional.push_back(arg);
+			}
+		}
+
+		if (positional.size() != 1)
+		{
+			return false;
+		}
+		out_options.m_Pattern = positional[0];
+		return true;
+	}
+
+	// Returns whatever is available instead of waiting for a full buffer, a slow producer still gets matched as it writes
+	size_t ReadInput(char* buffer, size_t size)
+	{
+#if defined(__unix__) || defined(__APPLE__)
+		for (;;)
+		{
+			const ssize_t read_size = read(STDIN_FILENO, buffer, size);
+			if (read_size >= 0)
+			{
+				return static_cast<size_t>(read_size);
+			}
+			if (errno != EINTR)
+			{
+				return 0;
+			}
+		}
+#else
+		return std::fread(buffer, 1, size, stdin);
+#endif
+	}
+
+	bool IsTerminal()
+	{
+#if defined(__unix__) || defined(__APPLE__)
+		return isatty(STDOUT_FILENO) != 0;
+#else
+		return false;
+#endif
+	}
+
+	void PrintResults(const std::vector<StreamMatch>& results)
+	{
+		for (const StreamMatch& match : results)
+		{
+			std::fwrite(match.m_Line.data(), 1, match.m_Line.size(), stdout);
+			std::fputc('\n', stdout);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point start = Clock::now();
+	const bool redraw = IsTerminal();
+
+	StreamFilter filter(options.m_Pattern, options.m_Config);
+	const StreamStats stats = filter.Run(ReadInput, [redraw](const std::vector<StreamMatch>& results, bool is_final)
+	{
+		if (!is_final && !redraw)
+		{
+			return;
+		}
+		if (redraw)
+		{
+			// Home and clear screen, the best lines so far replace the previous ones
+			std::fputs("\x1b[H\x1b[2J", stdout);
+		}
+		PrintResults(results);
+		std::fflush(stdout);
+	});
+
+	if (options.m_Stats)
+	{
+		const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+		std::fprintf(stderr, "%llu lines, %llu bytes, %llu matches, %llu updates in %lld ms\n",
+			static_cast<unsigned long long>(stats.m_Lines), static_cast<unsigned long long>(stats.m_Bytes),
+			static_cast<unsigned long long>(stats.m_Matches), static_cast<unsigned long long>(stats.m_Updates),
+			static_cast<long long>(elapsed.count()));
+	}
+	return EXIT_SUCCESS;
+}
@@ -1,7 +1,26 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string>
 #include <vector>
 
+#include "FuzzySearchKernels.h"
+
+// Set FUZZY_SEARCH_STATS to 1 (FUZZY_SEARCH_ENABLE_STATS cmake option) to have Search fill SearchStats.
+// The value has to be the same in every translation unit including this header.
+#ifndef FUZZY_SEARCH_STATS
+#define FUZZY_SEARCH_STATS 0
+#endif
+
+#if FUZZY_SEARCH_STATS
+#define FUZZY_SEARCH_STAT(...) __VA_ARGS__
+#else
+#define FUZZY_SEARCH_STAT(...)
+#endif
+
 namespace FuzzySearch
 {
 	template<typename String>
@@ -27,6 +46,18 @@ namespace FuzzySearch
 
 		inline int operator[](size_t /*index*/) const { static_assert(sizeof(String) == 0, "Create a specialization of FuzzySearchStringRef with the correct type"); return 0; }
 
+		// Index of the first character at or after start_index with ToLower(index) == lower_char, Length() if there is none.
+		// Specialize it when the string can be searched faster than one ToLower at a time.
+		inline int FindLower(int lower_char, int start_index) const
+		{
+			const int length = Length();
+			while (start_index < length && ToLower(start_index) != lower_char)
+			{
+				++start_index;
+			}
+			return start_index;
+		}
+
 	private:
 		const String* m_String{ nullptr };
 	};
@@ -38,17 +69,112 @@ namespace FuzzySearch
 		E_SOURCE_FILES
 	};
 
-	struct PatternMatch
+	/*
+	 * SearchStats describes where the time of a single Search call went.
+	 *
+	 * It is only filled when FUZZY_SEARCH_STATS is enabled, otherwise all of the instrumentation compiles away.
+	*/
+	struct SearchStats
+	{
+		size_t m_EntriesScanned = 0;
+		size_t m_EntriesRejectedEarly = 0;
+		size_t m_FuzzyMatchCalls = 0;
+		size_t m_SequentialMatchCalls = 0;
+		size_t m_ResultsKept = 0;
+		std::chrono::nanoseconds m_ScanTime{ 0 };
+		std::chrono::nanoseconds m_SortTime{ 0 };
+	};
+
+	template<typename Allocator = std::allocator<int>>
+	struct BasicPatternMatch
 	{
 		int m_Score = 0;
-		std::vector<int> m_Matches;
+		std::vector<int, Allocator> m_Matches;
 	};
 
+	using PatternMatch = BasicPatternMatch<>;
+
 	/*
-	 * InputPattern struct contains small helper buffers to avoid reallocating inside FuzzyMatch.
+	 * CompiledPattern is the immutable, preprocessed form of a search pattern.
+	 *
+	 * It only holds case folded bytes and per character flags so a single instance can be shared
+	 * between any number of threads matching the same query, each with its own MatchScratch.
+	*/
+	class CompiledPattern
+	{
+	public:
+		CompiledPattern() = default;
+
+		template<typename String>
+		explicit CompiledPattern(const FuzzySearchStringRef<String>& pattern)
+		{
+			Compile(pattern);
+		}
+
+		// Reuses the existing buffers, recompiling a pattern of the same or smaller length does not allocate
+		template<typename String>
+		void Compile(const FuzzySearchStringRef<String>& pattern);
+
+		inline int Length() const { return static_cast<int>(m_Folded.size()); }
+		inline bool Empty() const { return m_Folded.empty(); }
+		inline int ToLower(int index) const { return m_Folded[index]; }
+		inline bool IsSpace(int index) const { return m_Folded[index] == ' '; }
+
+		// Bonus for a match covering pattern[start, start + length) when that range is a whole word of the pattern
+		inline int CalculateWholeWordMatch(int start, int length) const;
+
+		struct Token
+		{
+			int m_Start = 0;
+			int m_Length = 0;
+		};
+
+		// Space separated parts of the pattern, they can match anywhere in str independently of each other
+		const std::vector<Token>& Tokens() const { return m_Tokens; }
+
+	private:
+		std::string m_Folded;
+		// m_WordBoundary[index + 1] is set when pattern[index] is a separator or index is outside of the pattern
+		std::vector<uint8_t> m_WordBoundary;
+		std::vector<Token> m_Tokens;
+	};
+
+	/*
+	 * MatchScratch holds the mutable buffers FuzzyMatch needs, one per thread.
+	 *
+	 * Buffers only ever grow so reusing the same instance for every match does not allocate.
+	*/
+	struct MatchScratch
+	{
+		// Best sequential match found for a single pattern character, it covers str[m_Start, m_Start + m_Length)
+		struct RunMatch
+		{
+			int m_Score = 0;
+			int m_Start = 0;
+			int m_Length = 0;
+		};
+
+		void Prepare(int pattern_length)
+		{
+			if (static_cast<int>(m_Runs.size()) < pattern_length)
+			{
+				m_Runs.resize(pattern_length);
+			}
+		}
+
+		std::vector<RunMatch> m_Runs;
+		std::vector<int> m_AlignmentBuffer;
+#if FUZZY_SEARCH_STATS
+		SearchStats* m_Stats{ nullptr };
+#endif
+	};
+
+	/*
+	 * InputPattern keeps the pattern string together with its CompiledPattern and a MatchScratch.
 	 *
 	 * If you are going to search for the same pattern in multiple different strings
 	 * reuse the same instance of InputPattern for every search instead of recreating it.
+	 * To match one pattern from multiple threads share a CompiledPattern and give every thread a MatchScratch instead.
 	*/
 	template<typename String>
 	struct InputPattern
@@ -58,6 +184,11 @@ namespace FuzzySearch
 			SetString(str);
 		}
 
+		InputPattern(const InputPattern& lhs)
+		{
+			SetString(lhs.m_String);
+		}
+
 		InputPattern& operator=(const InputPattern& lhs)
 		{
 			SetString(lhs.m_String);
@@ -68,34 +199,106 @@ namespace FuzzySearch
 		{
 			m_String = str;
 			m_Pattern = { m_String };
-			m_PatternMatches.resize(m_Pattern.Length());
-			m_MatchIndexes.resize(m_Pattern.Length());
+			m_Compiled.Compile(m_Pattern);
+			m_Scratch.Prepare(m_Compiled.Length());
 		}
 
 		String m_String;
 		FuzzySearchStringRef<String> m_Pattern;
-		std::vector<PatternMatch> m_PatternMatches;
-		std::vector<int> m_MatchIndexes;
+		CompiledPattern m_Compiled;
+		MatchScratch m_Scratch;
 	};
 
 	struct SearchConfig
 	{
 		MatchMode m_MatchMode { MatchMode::E_STRINGS };
 		uint8_t m_MaxUnmatchedCharactersFromPattern { 2 };
+		// Number of best results from Search that are rescored with OptimalMatch, 0 disables rescoring
+		uint16_t m_OptimalRescoreCount { 0 };
 	};
 
+	template<typename String>
+	bool FuzzyMatch(const CompiledPattern& pattern, MatchScratch& scratch, const FuzzySearchStringRef<String>& str, SearchConfig search_config, PatternMatch& out_match);
+
+	// Same as above for callers that already know where the filename starts in str, it has to be what FindFilenameStart returns
+	template<typename String>
+	bool FuzzyMatch(const CompiledPattern& pattern, MatchScratch& scratch, const FuzzySearchStringRef<String>& str, int filename_start_index, SearchConfig search_config, PatternMatch& out_match);
+
+	// Index of the first character after the last path separator for E_FILENAMES and E_SOURCE_FILES, 0 otherwise
+	template<typename String>
+	int FindFilenameStart(const FuzzySearchStringRef<String>& str, MatchMode match_mode);
+
 	template<typename String>
 	PatternMatch FuzzyMatch(InputPattern<String>& input_pattern, const FuzzySearchStringRef<String>& str, SearchConfig search_config);
 
+	/*
+	 * Same as above but writes the result into out_match, reusing its buffer.
+	 *
+	 * Together with a reused InputPattern this does not allocate once out_match has capacity for the pattern length.
+	*/
+	template<typename String>
+	bool FuzzyMatch(InputPattern<String>& input_pattern, const FuzzySearchStringRef<String>& str, SearchConfig search_config, PatternMatch& out_match);
+
+	/*
+	 * OptimalMatch uses the same bonus model as FuzzyMatch but it considers every alignment of the pattern instead of
+	 * committing to the best run for each pattern character, so it never scores lower than FuzzyMatch.
+	 *
+	 * It runs in O(pattern length^2 * str length) time so Search only uses it to rescore its best results.
+	*/
+	template<typename String>
+	bool OptimalMatch(const CompiledPattern& pattern, MatchScratch& scratch, const FuzzySearchStringRef<String>& str, SearchConfig search_config, PatternMatch& out_match);
+
 	template<typename String>
-	struct SearchResult
+	bool OptimalMatch(InputPattern<String>& input_pattern, const FuzzySearchStringRef<String>& str, SearchConfig search_config, PatternMatch& out_match);
+
+	template<typename String, typename Allocator = std::allocator<int>>
+	struct BasicSearchResult
 	{
 		String m_String;
-		PatternMatch m_PatternMatch;
+		BasicPatternMatch<Allocator> m_PatternMatch;
+	};
+
+	template<typename String>
+	using SearchResult = BasicSearchResult<String>;
+
+	// Results that live in a std::pmr::memory_resource, the matches of every result come from the same resource
+	namespace pmr
+	{
+		using PatternMatch = BasicPatternMatch<std::pmr::polymorphic_allocator<int>>;
+
+		template<typename String>
+		using SearchResult = BasicSearchResult<String, std::pmr::polymorphic_allocator<int>>;
+	}
+
+	/*
+	 * Bump allocator for the results of one query.
+	 *
+	 * Allocations are served from a buffer owned by the arena and only go to the heap once it is full.
+	 * Reset releases everything at once, results allocated from the arena have to be destroyed before that.
+	*/
+	class QueryArena
+	{
+	public:
+		explicit QueryArena(size_t buffer_size = 64 * 1024);
+
+		QueryArena(const QueryArena&) = delete;
+		QueryArena& operator=(const QueryArena&) = delete;
+
+		std::pmr::memory_resource& Resource() { return m_Resource; }
+		void Reset() { m_Resource.release(); }
+
+	private:
+		std::unique_ptr<std::byte[]> m_Buffer;
+		std::pmr::monotonic_buffer_resource m_Resource;
 	};
 
 	template<typename String, typename Iterator, typename Func>
-	std::vector<SearchResult<String>> Search(const String& pattern_str, Iterator begin, Iterator end, Func&& get_string_func, SearchConfig search_config);
+	std::vector<SearchResult<String>> Search(const String& pattern_str, Iterator begin, Iterator end, Func&& get_string_func, SearchConfig search_config, SearchStats* search_stats = nullptr);
+
+	// Same as Search but the result vector and every match buffer are allocated from memory_resource, for example QueryArena::Resource()
+	template<typename String, typename Iterator, typename Func>
+	std::pmr::vector<pmr::SearchResult<String>> Search(const String& pattern_str, Iterator begin, Iterator end, Func&& get_string_func, SearchConfig search_config,
+	                                                   std::pmr::memory_resource& memory_resource, SearchStats* search_stats = nullptr);
 
 } // namespace NFuzzySearch
 
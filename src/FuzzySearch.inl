@@ -1,9 +1,11 @@
 #include "FuzzySearch.h"
 
 #include <string>
-#include <numeric>
+#include <string_view>
 #include <cstring>
 #include <algorithm>
+#include <array>
+#include <limits>
 
 namespace FuzzySearch
 {
@@ -18,6 +20,36 @@ namespace FuzzySearch
 
 	constexpr int max_leading_letter_penalty = -10;
 
+	// Character classes used by the bonus calculation, one table lookup instead of a chain of comparisons
+	constexpr uint8_t character_separator = 1 << 0; // '/', '\\', '_' and ' '
+	constexpr uint8_t character_lower = 1 << 1;     // 'a' - 'z'
+	constexpr uint8_t character_upper = 1 << 2;     // 'A' - 'Z'
+
+	constexpr std::array<uint8_t, 256> MakeCharacterClasses()
+	{
+		std::array<uint8_t, 256> character_classes{};
+		for (int c = 'a'; c <= 'z'; ++c)
+		{
+			character_classes[c] = character_lower;
+		}
+		for (int c = 'A'; c <= 'Z'; ++c)
+		{
+			character_classes[c] = character_upper;
+		}
+		character_classes['/'] = character_separator;
+		character_classes['\\'] = character_separator;
+		character_classes['_'] = character_separator;
+		character_classes[' '] = character_separator;
+		return character_classes;
+	}
+
+	constexpr std::array<uint8_t, 256> character_classes = MakeCharacterClasses();
+
+	inline uint8_t GetCharacterClass(int c)
+	{
+		return character_classes[static_cast<unsigned char>(c)];
+	}
+
 	// std::string specialization
 	template<> inline int FuzzySearchStringRef<std::string>::Length() const { return (int)m_String->length(); }
 	template<> inline bool FuzzySearchStringRef<std::string>::Empty() const { return m_String->empty(); }
@@ -33,10 +65,11 @@ namespace FuzzySearch
 		return (int)found;
 	}
 
-	template<> inline bool FuzzySearchStringRef<std::string>::IsLower(size_t index) const { return (m_String->at(index) & 0x20) != 0; }
+	template<> inline bool FuzzySearchStringRef<std::string>::IsLower(size_t index) const { return (GetCharacterClass(m_String->at(index)) & character_lower) != 0; }
 	template<> inline int FuzzySearchStringRef<std::string>::ToLower(size_t index) const { return (m_String->at(index) | 0x20); }
 
 	template<> inline int FuzzySearchStringRef<std::string>::operator[](size_t index) const { return m_String->at(index); }
+	template<> inline int FuzzySearchStringRef<std::string>::FindLower(int lower_char, int start_index) const { return FindLowerByte(m_String->data(), Length(), start_index, lower_char); }
 
 	// cosnt char* specialization
 	template<> inline int FuzzySearchStringRef<const char*>::Length() const { return (int)strlen(*m_String); }
@@ -54,10 +87,32 @@ namespace FuzzySearch
 		return -1;
 	}
 
-	template<> inline bool FuzzySearchStringRef<const char*>::IsLower(size_t index) const { return ((*m_String)[index] & 0x20) != 0; }
+	template<> inline bool FuzzySearchStringRef<const char*>::IsLower(size_t index) const { return (GetCharacterClass((*m_String)[index]) & character_lower) != 0; }
 	template<> inline int FuzzySearchStringRef<const char*>::ToLower(size_t index) const { return ((*m_String)[index] | 0x20); }
 
 	template<> inline int FuzzySearchStringRef<const char*>::operator[](size_t index) const { return (*m_String)[index]; }
+	template<> inline int FuzzySearchStringRef<const char*>::FindLower(int lower_char, int start_index) const { return FindLowerByte(*m_String, Length(), start_index, lower_char); }
+
+	// std::string_view specialization
+	template<> inline int FuzzySearchStringRef<std::string_view>::Length() const { return (int)m_String->length(); }
+	template<> inline bool FuzzySearchStringRef<std::string_view>::Empty() const { return m_String->empty(); }
+
+	template<> inline bool FuzzySearchStringRef<std::string_view>::Equals(int start, int length, const char* str) const { return m_String->compare(start, length, str) == 0; }
+	template<> inline int FuzzySearchStringRef<std::string_view>::FindLastOf(const char* str) const
+	{
+		size_t found = m_String->find_last_of(str);
+		if (found == std::string_view::npos)
+		{
+			return -1;
+		}
+		return (int)found;
+	}
+
+	template<> inline bool FuzzySearchStringRef<std::string_view>::IsLower(size_t index) const { return (GetCharacterClass((*m_String)[index]) & character_lower) != 0; }
+	template<> inline int FuzzySearchStringRef<std::string_view>::ToLower(size_t index) const { return ((*m_String)[index] | 0x20); }
+
+	template<> inline int FuzzySearchStringRef<std::string_view>::operator[](size_t index) const { return (*m_String)[index]; }
+	template<> inline int FuzzySearchStringRef<std::string_view>::FindLower(int lower_char, int start_index) const { return FindLowerByte(m_String->data(), Length(), start_index, lower_char); }
 
 	// fuzzy search impl
 
@@ -99,18 +154,48 @@ namespace FuzzySearch
 	template<typename String>
 	inline bool IsSeparator(const FuzzySearchStringRef<String>& str, int index)
 	{
-		bool is_slash = index < 0 || index >= str.Length() || str[index] == '\\' || str[index] == '/';
-		bool is_separator = is_slash || str[index] == '_' || str[index] == ' ';
-		return is_separator;
+		return index < 0 || index >= str.Length() || (GetCharacterClass(str[index]) & character_separator) != 0;
 	}
 
+	// compiled pattern
+
 	template<typename String>
-	inline int CalculateWholeWordMatch(const FuzzySearchStringRef<String>& pattern, int match_start, int match_length)
+	void CompiledPattern::Compile(const FuzzySearchStringRef<String>& pattern)
 	{
-		const int index_before_match = match_start - 1;
-		const int index_after_match = match_start + match_length;
-		const bool match_is_start_of_word = IsSeparator(pattern, index_before_match);
-		const bool match_is_end_of_word = IsSeparator(pattern, index_after_match);
+		const int pattern_length = static_cast<int>(pattern.Length());
+
+		m_Folded.resize(pattern_length);
+		for (int index = 0; index < pattern_length; ++index)
+		{
+			m_Folded[index] = static_cast<char>(pattern.ToLower(index));
+		}
+
+		m_WordBoundary.resize(pattern_length + 2);
+		for (int index = -1; index <= pattern_length; ++index)
+		{
+			m_WordBoundary[index + 1] = IsSeparator(pattern, index) ? 1 : 0;
+		}
+
+		m_Tokens.clear();
+		for (int index = 0; index < pattern_length; ++index)
+		{
+			if (IsSpace(index))
+			{
+				continue;
+			}
+
+			if (index == 0 || IsSpace(index - 1))
+			{
+				m_Tokens.push_back({ index, 0 });
+			}
+			++m_Tokens.back().m_Length;
+		}
+	}
+
+	inline int CompiledPattern::CalculateWholeWordMatch(int match_start, int match_length) const
+	{
+		const bool match_is_start_of_word = m_WordBoundary[match_start] != 0;
+		const bool match_is_end_of_word = m_WordBoundary[match_start + match_length + 1] != 0;
 
 		if (match_is_start_of_word && match_is_end_of_word)
 		{
@@ -120,8 +205,51 @@ namespace FuzzySearch
 		return 0;
 	}
 
+	// fuzzy match impl
+
 	template<typename String>
-	int CalculateSequentialMatchScore(const FuzzySearchStringRef<String>& str, int filename_start_index,  MatchMode match_mode, const std::vector<int>& matches, int match_length)
+	inline int CalculateIndexBonus(const FuzzySearchStringRef<String>& str, int filename_start_index, MatchMode match_mode, int curr_index)
+	{
+		int out_score = 0;
+
+		// Check for bonuses based on neighbour character value
+		if (match_mode == MatchMode::E_FILENAMES || match_mode == MatchMode::E_SOURCE_FILES)
+		{
+			// The start of str counts as a separator
+			const uint8_t prev_class = curr_index > 0 ? GetCharacterClass(str[curr_index - 1]) : character_separator;
+			const uint8_t curr_class = GetCharacterClass(str[curr_index]);
+			bool is_prev_separator = (prev_class & character_separator) != 0;
+			bool is_prev_lower = (prev_class & (character_separator | character_lower)) != 0;
+			bool is_curr_upper = (curr_class & character_upper) != 0;
+
+			// Camel case
+			if (is_prev_lower && is_curr_upper)
+			{
+				out_score += camel_bonus;
+			}
+			// Separator
+			else if (is_prev_separator)
+			{
+				out_score += separator_bonus;
+			}
+		}
+
+		if (curr_index >= filename_start_index)
+		{
+			// Bonus for matching the filename
+			out_score += filename_bonus;
+			if (curr_index == filename_start_index)
+			{
+				// First letter
+				out_score += first_letter_bonus;
+			}
+		}
+
+		return out_score;
+	}
+
+	template<typename String>
+	int CalculateSequentialMatchScore(const FuzzySearchStringRef<String>& str, int filename_start_index, MatchMode match_mode, int match_start, int match_length)
 	{
 		int out_score = 5;
 		const int str_length = static_cast<int>(str.Length());
@@ -132,26 +260,8 @@ namespace FuzzySearch
 		// Apply ordering bonuses
 		for (int i = 0; i < match_length; ++i)
 		{
-			int curr_index = matches[i];
-			// Check for bonuses based on neighbour character value
-			if (match_mode == MatchMode::E_FILENAMES || match_mode == MatchMode::E_SOURCE_FILES)
-			{
-				int prev_index = curr_index - 1;
-				bool is_prev_separator = IsSeparator(str, prev_index);
-				bool is_prev_lower = is_prev_separator || str.IsLower(prev_index);
-				bool is_curr_upper = !str.IsLower(curr_index);
-
-				// Camel case
-				if (is_prev_lower && is_curr_upper)
-				{
-					out_score += camel_bonus;
-				}
-				// Separator
-				else if (is_prev_separator)
-				{
-					out_score += separator_bonus;
-				}
-			}
+			int curr_index = match_start + i;
+			out_score += CalculateIndexBonus(str, filename_start_index, match_mode, curr_index);
 
 			if (curr_index >= filename_start_index)
 			{
@@ -160,14 +270,6 @@ namespace FuzzySearch
 				{
 					first_match_in_filename = curr_index;
 				}
-
-				// Bonus for matching the filename
-				out_score += filename_bonus;
-				if (curr_index == filename_start_index)
-				{
-					// First letter
-					out_score += first_letter_bonus;
-				}
 				++matches_in_filename;
 			}
 		}
@@ -192,7 +294,7 @@ namespace FuzzySearch
 	}
 
 	template<typename String>
-	inline int FindSequentialMatch(const FuzzySearchStringRef<String>& pattern, int pattern_index, const FuzzySearchStringRef<String>& str, int str_index) noexcept
+	inline int FindSequentialMatch(const CompiledPattern& pattern, int pattern_index, const FuzzySearchStringRef<String>& str, int str_index) noexcept
 	{
 		// The pattern characters usually mismatch str characters so this early out just helps optizmier/cpu
 		if (pattern.ToLower(pattern_index) != str.ToLower(str_index))
@@ -200,7 +302,7 @@ namespace FuzzySearch
 			return 0;
 		}
 
-		const int pattern_length = static_cast<int>(pattern.Length());
+		const int pattern_length = pattern.Length();
 		const int str_length = static_cast<int>(str.Length());
 
 		int matched_chars = 0;
@@ -216,51 +318,73 @@ namespace FuzzySearch
 		return matched_chars;
 	}
 
-	template<typename String>
-	PatternMatch CalculatePatternScore(const FuzzySearchStringRef<String>& pattern, const std::vector<PatternMatch>& in_matches)
+	inline void CalculatePatternScore(int pattern_length, const std::vector<MatchScratch::RunMatch>& in_matches, PatternMatch& out_match)
 	{
-		const int pattern_length = static_cast<int>(pattern.Length());
-
-		PatternMatch out_match;
+		out_match.m_Score = 0;
+		out_match.m_Matches.clear();
 		out_match.m_Matches.reserve(pattern_length);
 
 		for (int pattern_index = 0; pattern_index < pattern_length; ++pattern_index)
 		{
-			const PatternMatch& match = in_matches[pattern_index];
+			const MatchScratch::RunMatch& match = in_matches[pattern_index];
 			if (match.m_Score > 0)
 			{
 				out_match.m_Score += match.m_Score;
-				out_match.m_Matches.insert(out_match.m_Matches.end(), match.m_Matches.begin(), match.m_Matches.end());
+				for (int str_index = match.m_Start; str_index < match.m_Start + match.m_Length; ++str_index)
+				{
+					out_match.m_Matches.push_back(str_index);
+				}
 
 				// Advance the pattern_index by the match length, m_Score is only set for the first character of a match
-				pattern_index += static_cast<int>(match.m_Matches.size() - 1);
+				pattern_index += match.m_Length - 1;
 			}
 		}
-
-		return out_match;
 	}
 
 	template<typename String>
-	PatternMatch FuzzyMatch(InputPattern<String>& input_pattern, const FuzzySearchStringRef<String>& str, SearchConfig search_config)
+	inline int FindFilenameStart(const FuzzySearchStringRef<String>& str, MatchMode match_mode)
 	{
-		const FuzzySearchStringRef<String>& pattern = input_pattern.m_Pattern;
-
-		const int pattern_length = static_cast<int>(pattern.Length());
-		const int str_length = static_cast<int>(str.Length());
-
-		std::vector<PatternMatch>& pattern_matches = input_pattern.m_PatternMatches;
-		std::vector<int>& match_indexes = input_pattern.m_MatchIndexes;
-
-		int filename_start_index = 0;
-		if (search_config.m_MatchMode == MatchMode::E_SOURCE_FILES || search_config.m_MatchMode == MatchMode::E_FILENAMES)
+		if (match_mode == MatchMode::E_SOURCE_FILES || match_mode == MatchMode::E_FILENAMES)
 		{
 			auto found_separator = str.FindLastOf("\\/");
 			if (found_separator != -1)
 			{
-				filename_start_index = static_cast<int>(found_separator) + 1;
+				return static_cast<int>(found_separator) + 1;
 			}
 		}
 
+		return 0;
+	}
+
+	template<typename String>
+	PatternMatch FuzzyMatch(InputPattern<String>& input_pattern, const FuzzySearchStringRef<String>& str, SearchConfig search_config)
+	{
+		PatternMatch out_match;
+		FuzzyMatch(input_pattern.m_Compiled, input_pattern.m_Scratch, str, search_config, out_match);
+		return out_match;
+	}
+
+	template<typename String>
+	bool FuzzyMatch(InputPattern<String>& input_pattern, const FuzzySearchStringRef<String>& str, SearchConfig search_config, PatternMatch& out_match)
+	{
+		return FuzzyMatch(input_pattern.m_Compiled, input_pattern.m_Scratch, str, search_config, out_match);
+	}
+
+	template<typename String>
+	bool FuzzyMatch(const CompiledPattern& pattern, MatchScratch& scratch, const FuzzySearchStringRef<String>& str, SearchConfig search_config, PatternMatch& out_match)
+	{
+		return FuzzyMatch(pattern, scratch, str, FindFilenameStart(str, search_config.m_MatchMode), search_config, out_match);
+	}
+
+	template<typename String>
+	bool FuzzyMatch(const CompiledPattern& pattern, MatchScratch& scratch, const FuzzySearchStringRef<String>& str, int filename_start_index, SearchConfig search_config, PatternMatch& out_match)
+	{
+		const int pattern_length = pattern.Length();
+		const int str_length = static_cast<int>(str.Length());
+
+		scratch.Prepare(pattern_length);
+		std::vector<MatchScratch::RunMatch>& pattern_matches = scratch.m_Runs;
+
 		int str_start = 0;
 		int unmatched_characters_from_pattern = 0;
 
@@ -273,32 +397,40 @@ namespace FuzzySearch
 
 			// When pattern contains a space, start a search from the beginning of str
 			// again to allow out of order matches from the pattern
-			if (pattern[pattern_index] == ' ')
+			if (pattern.IsSpace(pattern_index))
 			{
 				str_start = 0;
 				continue;
 			}
 
+			const int first_char = pattern.ToLower(pattern_index);
 			for (int str_index = str_start; str_index < str_length; ++str_index)
 			{
+				// Jump straight to the next position where a sequential match can start
+				str_index = str.FindLower(first_char, str_index);
+				if (str_index >= str_length)
+				{
+					break;
+				}
+
+				FUZZY_SEARCH_STAT(if (scratch.m_Stats != nullptr) { ++scratch.m_Stats->m_SequentialMatchCalls; })
 				const int match_length = FindSequentialMatch(pattern, pattern_index, str, str_index);
 				if (match_length > 0)
 				{
-					// We know that the sequential match started at str_index so fill match_indexes
-					std::iota(match_indexes.begin(), match_indexes.begin() + match_length, str_index);
-
-					int match_score = CalculateSequentialMatchScore(str, filename_start_index, search_config.m_MatchMode, match_indexes, match_length);
+					// The sequential match covers str[str_index, str_index + match_length)
+					int match_score = CalculateSequentialMatchScore(str, filename_start_index, search_config.m_MatchMode, str_index, match_length);
 
 					// Apply whole word bonus if the match is a whole word from the pattern
-					match_score += CalculateWholeWordMatch(pattern, pattern_index, match_length);
+					match_score += pattern.CalculateWholeWordMatch(pattern_index, match_length);
 
 					if (match_score > pattern_matches[pattern_index].m_Score)
 					{
 						best_match_length = match_length;
 
-						PatternMatch& match = pattern_matches[pattern_index];
+						MatchScratch::RunMatch& match = pattern_matches[pattern_index];
 						match.m_Score = match_score;
-						match.m_Matches.assign(match_indexes.begin(), match_indexes.begin() + best_match_length);
+						match.m_Start = str_index;
+						match.m_Length = best_match_length;
 
 						// Skip searching for matches in str that we already used in our currect best match, doing this to improve performance
 						// -1 because we will increment str_index at the end of the loop
@@ -318,51 +450,510 @@ namespace FuzzySearch
 				// Allow some unmatched characters (typos etc...)
 				if (unmatched_characters_from_pattern > search_config.m_MaxUnmatchedCharactersFromPattern)
 				{
-					return { 0, std::vector<int>() };
+					FUZZY_SEARCH_STAT(if (scratch.m_Stats != nullptr) { ++scratch.m_Stats->m_EntriesRejectedEarly; })
+					out_match.m_Score = 0;
+					out_match.m_Matches.clear();
+					return false;
 				}
 			}
 		}
 
-		return CalculatePatternScore(pattern, pattern_matches);
+		CalculatePatternScore(pattern_length, pattern_matches, out_match);
+		return out_match.m_Score > 0;
 	}
 
-	template<typename String, typename Iterator, typename Func>
-	std::vector<SearchResult<String>> Search(const String& pattern_str, Iterator begin, Iterator end, Func&& get_string_func, SearchConfig search_config)
+	template<typename String>
+	bool OptimalMatch(InputPattern<String>& input_pattern, const FuzzySearchStringRef<String>& str, SearchConfig search_config, PatternMatch& out_match)
+	{
+		return OptimalMatch(input_pattern.m_Compiled, input_pattern.m_Scratch, str, search_config, out_match);
+	}
+
+	template<typename String>
+	bool OptimalMatch(const CompiledPattern& pattern, MatchScratch& scratch, const FuzzySearchStringRef<String>& str, SearchConfig search_config, PatternMatch& out_match)
 	{
-		InputPattern<String> input_pattern(pattern_str);
-		if (input_pattern.m_Pattern.Empty())
+		constexpr int no_score = std::numeric_limits<int>::min() / 4;
+
+		const int pattern_length = pattern.Length();
+		const int str_length = static_cast<int>(str.Length());
+		const int row_length = str_length + 1;
+		const int max_unmatched = search_config.m_MaxUnmatchedCharactersFromPattern;
+		const int unmatched_count = max_unmatched + 1;
+
+		out_match.m_Score = 0;
+		out_match.m_Matches.clear();
+
+		// Layout of the scratch buffer, every row is indexed by a position in str:
+		//  run_lengths[pattern_index]            - length of the sequential match starting at (pattern_index, str_index)
+		//  bonus_prefix                          - prefix sum of CalculateIndexBonus for every str index
+		//  run_end[pattern_index][unmatched]     - best score of an alignment whose last run ends exactly at str_index
+		//  available[pattern_index][unmatched]   - best score of an alignment whose last run ends at or before str_index
+		//  runs                                  - (str_index, match_length) pairs of the best alignment
+		const size_t table_size = static_cast<size_t>(pattern_length + 1) * unmatched_count * row_length;
+		std::vector<int>& buffer = scratch.m_AlignmentBuffer;
+		buffer.assign(static_cast<size_t>(pattern_length + 1) * row_length + row_length + 2 * table_size + 2 * pattern_length, no_score);
+
+		int* const run_lengths = buffer.data();
+		int* const bonus_prefix = run_lengths + static_cast<size_t>(pattern_length + 1) * row_length;
+		int* const run_end = bonus_prefix + row_length;
+		int* const available = run_end + table_size;
+		int* const runs = available + table_size;
+
+		auto row = [unmatched_count, row_length](int* table, int pattern_index, int unmatched)
 		{
-			return {};
+			return table + (static_cast<size_t>(pattern_index) * unmatched_count + unmatched) * row_length;
+		};
+
+		int max_run_length = 0;
+		for (int pattern_index = pattern_length; pattern_index >= 0; --pattern_index)
+		{
+			int* run_length_row = run_lengths + static_cast<size_t>(pattern_index) * row_length;
+			for (int str_index = str_length; str_index >= 0; --str_index)
+			{
+				const bool is_match = pattern_index < pattern_length && str_index < str_length && pattern.ToLower(pattern_index) == str.ToLower(str_index);
+				run_length_row[str_index] = is_match ? run_lengths[static_cast<size_t>(pattern_index + 1) * row_length + str_index + 1] + 1 : 0;
+				max_run_length = std::max(max_run_length, run_length_row[str_index]);
+			}
 		}
 
-		std::vector<SearchResult<String>> search_results;
+		const MatchMode match_mode = search_config.m_MatchMode;
+		const int filename_start_index = FindFilenameStart(str, match_mode);
+		const int filename_length = str_length - filename_start_index;
+		const int source_file_bonus = match_mode == MatchMode::E_SOURCE_FILES && IsSourceFile(str) ? 2 : 0;
+
+		bonus_prefix[0] = 0;
+		for (int str_index = 0; str_index < str_length; ++str_index)
+		{
+			bonus_prefix[str_index + 1] = bonus_prefix[str_index] + CalculateIndexBonus(str, filename_start_index, match_mode, str_index);
+		}
+
+		// Same result as CalculateSequentialMatchScore + CalculateWholeWordMatch for the run str[str_index, str_index + match_length)
+		// written without branches so the loops over str_index below vectorize
+		auto run_score = [bonus_prefix, filename_start_index, filename_length](int str_index, int match_length, int run_bonus)
+		{
+			const int run_last = str_index + match_length - 1;
+			const int in_filename = run_last >= filename_start_index ? 1 : 0;
+			const int first_in_filename = std::max(str_index, filename_start_index);
+			const int matches_in_filename = in_filename * (str_index + match_length - first_in_filename);
+			const int leading_penalty = in_filename * std::max(leading_letter_penalty * (first_in_filename - filename_start_index), max_leading_letter_penalty);
+			const int unmatched_penalty = std::min(unmatched_letter_penalty * ((filename_length - matches_in_filename) / 3), 0);
+			return run_bonus + bonus_prefix[str_index + match_length] - bonus_prefix[str_index] + leading_penalty + unmatched_penalty;
+		};
+
+		auto run_bonus = [&pattern, source_file_bonus](int pattern_index, int match_length)
+		{
+			return 5 + source_file_bonus + sequential_bonus * (match_length - 1) + pattern.CalculateWholeWordMatch(pattern_index, match_length);
+		};
+
+		// Nothing matched yet, the first run can start anywhere
+		std::fill(row(available, 0, 0), row(available, 0, 0) + row_length, 0);
+
+		for (int pattern_index = 0; pattern_index <= pattern_length; ++pattern_index)
+		{
+			for (int unmatched = 0; unmatched < unmatched_count; ++unmatched)
+			{
+				const int* end_row = row(run_end, pattern_index, unmatched);
+				int* available_row = row(available, pattern_index, unmatched);
+
+				int best = no_score;
+				for (int str_index = 0; str_index < row_length; ++str_index)
+				{
+					best = std::max(best, end_row[str_index]);
+					available_row[str_index] = std::max(available_row[str_index], best);
+				}
+			}
+
+			if (pattern_index == pattern_length)
+			{
+				break;
+			}
+
+			const int* run_length_row = run_lengths + static_cast<size_t>(pattern_index) * row_length;
+			for (int unmatched = 0; unmatched < unmatched_count; ++unmatched)
+			{
+				const int* available_row = row(available, pattern_index, unmatched);
+				if (available_row[str_length] == no_score)
+				{
+					continue;
+				}
+
+				// Space restarts the search from the beginning of str, same as FuzzyMatch
+				if (pattern.IsSpace(pattern_index))
+				{
+					int* next_row = row(available, pattern_index + 1, unmatched);
+					for (int str_index = 0; str_index < row_length; ++str_index)
+					{
+						next_row[str_index] = std::max(next_row[str_index], available_row[str_length]);
+					}
+					continue;
+				}
+
+				// Leave this pattern character unmatched
+				if (unmatched + 1 < unmatched_count)
+				{
+					int* next_row = row(available, pattern_index + 1, unmatched + 1);
+					for (int str_index = 0; str_index < row_length; ++str_index)
+					{
+						next_row[str_index] = std::max(next_row[str_index], available_row[str_index]);
+					}
+				}
+
+				// Match pattern[pattern_index, pattern_index + match_length) to every str[str_index, str_index + match_length)
+				const int max_match_length = std::min(max_run_length, pattern_length - pattern_index);
+				for (int match_length = 1; match_length <= max_match_length; ++match_length)
+				{
+					const int bonus = run_bonus(pattern_index, match_length);
+					int* next_end_row = row(run_end, pattern_index + match_length, unmatched) + match_length;
+					for (int str_index = 0; str_index + match_length <= str_length; ++str_index)
+					{
+						const int score = run_score(str_index, match_length, bonus);
+						const int previous_score = available_row[str_index];
+						const bool is_valid = (run_length_row[str_index] >= match_length) & (score > 0);
+						const int candidate = is_valid ? previous_score + score : no_score;
+						next_end_row[str_index] = std::max(next_end_row[str_index], candidate);
+					}
+				}
+			}
+		}
+
+		int best_unmatched = 0;
+		for (int unmatched = 1; unmatched < unmatched_count; ++unmatched)
+		{
+			if (row(available, pattern_length, unmatched)[str_length] > row(available, pattern_length, best_unmatched)[str_length])
+			{
+				best_unmatched = unmatched;
+			}
+		}
+
+		const int best_score = row(available, pattern_length, best_unmatched)[str_length];
+		if (best_score <= 0)
+		{
+			return false;
+		}
+
+		// Walk the tables back to recover the runs, they come out in reverse pattern order
+		int run_count = 0;
+
+		int pattern_index = pattern_length;
+		int unmatched = best_unmatched;
+		int str_index = str_length;
+		int score = best_score;
+		while (pattern_index > 0)
+		{
+			const int* end_row = row(run_end, pattern_index, unmatched);
+			int run_end_index = 0;
+			while (run_end_index <= str_index && end_row[run_end_index] != score)
+			{
+				++run_end_index;
+			}
+
+			bool found_run = false;
+			if (run_end_index <= str_index)
+			{
+				for (int match_length = 1; match_length <= std::min(pattern_index, run_end_index); ++match_length)
+				{
+					const int run_pattern_index = pattern_index - match_length;
+					const int run_str_index = run_end_index - match_length;
+					const int previous_score = row(available, run_pattern_index, unmatched)[run_str_index];
+					const int run_length = run_lengths[static_cast<size_t>(run_pattern_index) * row_length + run_str_index];
+					if (run_length < match_length || previous_score == no_score)
+					{
+						continue;
+					}
+
+					const int current_score = run_score(run_str_index, match_length, run_bonus(run_pattern_index, match_length));
+					if (current_score > 0 && previous_score + current_score == score)
+					{
+						runs[run_count++] = run_str_index;
+						runs[run_count++] = match_length;
+						pattern_index = run_pattern_index;
+						str_index = run_str_index;
+						score = previous_score;
+						found_run = true;
+						break;
+					}
+				}
+			}
+
+			if (found_run)
+			{
+				continue;
+			}
+
+			if (pattern.IsSpace(pattern_index - 1) && row(available, pattern_index - 1, unmatched)[str_length] == score)
+			{
+				--pattern_index;
+				str_index = str_length;
+			}
+			else
+			{
+				--pattern_index;
+				--unmatched;
+			}
+		}
+
+		out_match.m_Score = best_score;
+		for (int run = run_count - 2; run >= 0; run -= 2)
+		{
+			for (int index = 0; index < runs[run + 1]; ++index)
+			{
+				out_match.m_Matches.push_back(runs[run] + index);
+			}
+		}
+
+		return true;
+	}
+
+	// Result order packed into one integer, ascending keys are descending scores and then ascending lengths.
+	// m_Index is the position of the result before ranking and breaks ties.
+	struct RankKey
+	{
+		uint64_t m_Key = 0;
+		uint32_t m_Index = 0;
+	};
+
+	inline uint64_t MakeRankKey(int score, size_t length)
+	{
+		// Flipping the sign bit orders the scores as unsigned, inverting makes higher scores smaller
+		const uint32_t score_key = ~(static_cast<uint32_t>(score) ^ 0x80000000u);
+		const uint32_t length_key = static_cast<uint32_t>(std::min<size_t>(length, std::numeric_limits<uint32_t>::max()));
+		return static_cast<uint64_t>(score_key) << 32 | length_key;
+	}
+
+	inline uint64_t ReplaceRankKeyScore(uint64_t key, int score)
+	{
+		return MakeRankKey(score, static_cast<uint32_t>(key));
+	}
+
+	inline bool CompareRankKeys(const RankKey& lhs, const RankKey& rhs) noexcept
+	{
+		return lhs.m_Key != rhs.m_Key ? lhs.m_Key < rhs.m_Key : lhs.m_Index < rhs.m_Index;
+	}
+
+	/*
+	 * Sorts keys by (m_Key, m_Index) with a LSD radix sort, keys have to start out in m_Index order.
+	 *
+	 * Every pass is stable so equal keys keep their index order. Bytes that are the same in every key are skipped,
+	 * scores and lengths are small so a typical ranking takes three or four passes over the keys.
+	 * buffer has room for count keys, the sorted keys end up in keys.
+	*/
+	inline void SortRankKeys(RankKey* keys, RankKey* buffer, size_t count)
+	{
+		// Below this a comparison sort is cheaper than clearing and scanning the histograms
+		constexpr size_t radix_sort_threshold = 256;
+
+		if (count < radix_sort_threshold)
+		{
+			std::sort(keys, keys + count, &CompareRankKeys);
+			return;
+		}
+
+		std::array<std::array<uint32_t, 256>, sizeof(uint64_t)> histograms{};
+		for (const RankKey* rank_key = keys; rank_key != keys + count; ++rank_key)
+		{
+			for (size_t byte = 0; byte < sizeof(uint64_t); ++byte)
+			{
+				++histograms[byte][(rank_key->m_Key >> (byte * 8)) & 0xFF];
+			}
+		}
+
+		RankKey* source = keys;
+		RankKey* destination = buffer;
+		for (size_t byte = 0; byte < sizeof(uint64_t); ++byte)
+		{
+			std::array<uint32_t, 256>& histogram = histograms[byte];
+			const size_t shift = byte * 8;
+			if (histogram[(source[0].m_Key >> shift) & 0xFF] == count)
+			{
+				continue;
+			}
+
+			uint32_t offset = 0;
+			for (uint32_t& bucket : histogram)
+			{
+				const uint32_t bucket_count = bucket;
+				bucket = offset;
+				offset += bucket_count;
+			}
+
+			for (const RankKey* rank_key = source; rank_key != source + count; ++rank_key)
+			{
+				destination[histogram[(rank_key->m_Key >> shift) & 0xFF]++] = *rank_key;
+			}
+			std::swap(source, destination);
+		}
+
+		if (source != keys)
+		{
+			std::copy(source, source + count, keys);
+		}
+	}
+
+	template<typename Allocator>
+	void SortRankKeys(std::vector<RankKey, Allocator>& keys, std::vector<RankKey, Allocator>& buffer)
+	{
+		buffer.resize(keys.size());
+		SortRankKeys(keys.data(), buffer.data(), keys.size());
+	}
+
+	template<typename String, typename Allocator>
+	bool CompareSearchResults(const BasicSearchResult<String, Allocator>& lhs, const BasicSearchResult<String, Allocator>& rhs) noexcept
+	{
+		if (lhs.m_PatternMatch.m_Score > rhs.m_PatternMatch.m_Score)
+		{
+			return true;
+		}
+		else if (lhs.m_PatternMatch.m_Score == rhs.m_PatternMatch.m_Score)
+		{
+			return FuzzySearchStringRef<String>(lhs.m_String).Length() < FuzzySearchStringRef<String>(rhs.m_String).Length();
+		}
+		return false;
+	}
+
+	// Moves a match out of the reused scratch match into a result, results with another allocator get a copy
+	inline void StorePatternMatch(PatternMatch& pattern_match, PatternMatch& out_match)
+	{
+		std::swap(out_match, pattern_match);
+	}
+
+	template<typename Allocator>
+	void StorePatternMatch(const PatternMatch& pattern_match, BasicPatternMatch<Allocator>& out_match)
+	{
+		out_match.m_Score = pattern_match.m_Score;
+		out_match.m_Matches.assign(pattern_match.m_Matches.begin(), pattern_match.m_Matches.end());
+	}
+
+	inline QueryArena::QueryArena(size_t buffer_size)
+		: m_Buffer(std::make_unique<std::byte[]>(buffer_size))
+		, m_Resource(m_Buffer.get(), buffer_size)
+	{}
+
+	template<typename String, typename Iterator, typename Func, typename Result, typename ResultAllocator>
+	void SearchInto(const String& pattern_str, Iterator begin, Iterator end, Func&& get_string_func, SearchConfig search_config, SearchStats* search_stats,
+	                std::vector<Result, ResultAllocator>& search_results)
+	{
+#if FUZZY_SEARCH_STATS
+		SearchStats stats;
+		const auto scan_start = std::chrono::steady_clock::now();
+#else
+		(void)search_stats;
+#endif
+
+		const CompiledPattern pattern{ FuzzySearchStringRef<String>(pattern_str) };
+		if (pattern.Empty())
+		{
+			FUZZY_SEARCH_STAT(if (search_stats != nullptr) { *search_stats = stats; })
+			return;
+		}
+
+		MatchScratch scratch;
+		scratch.Prepare(pattern.Length());
+		FUZZY_SEARCH_STAT(scratch.m_Stats = &stats;)
+
 		search_results.reserve(std::distance(begin, end));
 
-		std::for_each(begin, end, [&input_pattern, &get_string_func, search_config, &search_results](const auto& element)
+		// The match buffers use the allocator of the result vector
+		using MatchAllocator = typename std::allocator_traits<ResultAllocator>::template rebind_alloc<int>;
+		const MatchAllocator match_allocator(search_results.get_allocator());
+
+		// Match into a reused buffer and only copy out the matches that are kept
+		PatternMatch pattern_match;
+		pattern_match.m_Matches.reserve(pattern.Length());
+
+		std::for_each(begin, end, [&pattern, &scratch, &get_string_func, search_config, &search_results, &pattern_match, &match_allocator](const auto& element)
 		{
-			SearchResult<String> search_result;
-			search_result.m_String = get_string_func(element);
-			search_result.m_PatternMatch = FuzzyMatch(input_pattern, FuzzySearchStringRef<String>(search_result.m_String), search_config);
+			const String& str = get_string_func(element);
+			FUZZY_SEARCH_STAT(++scratch.m_Stats->m_EntriesScanned; ++scratch.m_Stats->m_FuzzyMatchCalls;)
 
-			if (search_result.m_PatternMatch.m_Score > 0)
+			if (FuzzyMatch(pattern, scratch, FuzzySearchStringRef<String>(str), search_config, pattern_match))
 			{
-				search_results.push_back(std::move(search_result));
+				search_results.push_back({ str, { pattern_match.m_Score, { pattern_match.m_Matches.begin(), pattern_match.m_Matches.end(), match_allocator } } });
 			}
 		});
 
-		std::sort(search_results.begin(), search_results.end(), [](const SearchResult<String>& lhs, const SearchResult<String>& rhs) noexcept
+#if FUZZY_SEARCH_STATS
+		const auto sort_start = std::chrono::steady_clock::now();
+#endif
+
+		// Same order as CompareSearchResults with ties kept in input order, every length is computed once
+		using RankKeyAllocator = typename std::allocator_traits<ResultAllocator>::template rebind_alloc<RankKey>;
+		const RankKeyAllocator rank_key_allocator(search_results.get_allocator());
+		std::vector<RankKey, RankKeyAllocator> rank_keys(rank_key_allocator);
+		std::vector<RankKey, RankKeyAllocator> rank_buffer(rank_key_allocator);
+
+		rank_keys.reserve(search_results.size());
+		for (size_t index = 0; index < search_results.size(); ++index)
 		{
-			if (lhs.m_PatternMatch.m_Score > rhs.m_PatternMatch.m_Score)
+			const Result& search_result = search_results[index];
+			rank_keys.push_back({ MakeRankKey(search_result.m_PatternMatch.m_Score, FuzzySearchStringRef<String>(search_result.m_String).Length()), static_cast<uint32_t>(index) });
+		}
+		SortRankKeys(rank_keys, rank_buffer);
+
+		// Rescore the head of the list with the optimal alignment, it never scores lower than FuzzyMatch
+		// so these results stay ahead of the rest and only have to be reordered among themselves
+		const size_t rescore_count = std::min<size_t>(search_config.m_OptimalRescoreCount, search_results.size());
+		if (rescore_count > 0)
+		{
+			for (size_t index = 0; index < rescore_count; ++index)
 			{
-				return true;
+				RankKey& rank_key = rank_keys[index];
+				Result& search_result = search_results[rank_key.m_Index];
+				if (OptimalMatch(pattern, scratch, FuzzySearchStringRef<String>(search_result.m_String), search_config, pattern_match))
+				{
+					StorePatternMatch(pattern_match, search_result.m_PatternMatch);
+					rank_key.m_Key = ReplaceRankKeyScore(rank_key.m_Key, search_result.m_PatternMatch.m_Score);
+				}
 			}
-			else if (lhs.m_PatternMatch.m_Score == rhs.m_PatternMatch.m_Score)
+
+			std::sort(rank_keys.begin(), rank_keys.begin() + rescore_count, &CompareRankKeys);
+		}
+
+		// Apply the order in place one permutation cycle at a time, a placed position gets its own index
+		for (size_t cycle_start = 0; cycle_start < rank_keys.size(); ++cycle_start)
+		{
+			if (rank_keys[cycle_start].m_Index == cycle_start)
 			{
-				return FuzzySearchStringRef<String>(lhs.m_String).Length() < FuzzySearchStringRef<String>(rhs.m_String).Length();
+				continue;
 			}
-			return false;
-		});
 
+			Result cycle_result = std::move(search_results[cycle_start]);
+			size_t index = cycle_start;
+			while (rank_keys[index].m_Index != cycle_start)
+			{
+				const size_t source_index = rank_keys[index].m_Index;
+				search_results[index] = std::move(search_results[source_index]);
+				rank_keys[index].m_Index = static_cast<uint32_t>(index);
+				index = source_index;
+			}
+			search_results[index] = std::move(cycle_result);
+			rank_keys[index].m_Index = static_cast<uint32_t>(index);
+		}
+
+#if FUZZY_SEARCH_STATS
+		const auto sort_end = std::chrono::steady_clock::now();
+		stats.m_ResultsKept = search_results.size();
+		stats.m_ScanTime = std::chrono::duration_cast<std::chrono::nanoseconds>(sort_start - scan_start);
+		stats.m_SortTime = std::chrono::duration_cast<std::chrono::nanoseconds>(sort_end - sort_start);
+		if (search_stats != nullptr)
+		{
+			*search_stats = stats;
+		}
+#endif
+	}
+
+	template<typename String, typename Iterator, typename Func>
+	std::vector<SearchResult<String>> Search(const String& pattern_str, Iterator begin, Iterator end, Func&& get_string_func, SearchConfig search_config, SearchStats* search_stats)
+	{
+		std::vector<SearchResult<String>> search_results;
+		SearchInto(pattern_str, begin, end, get_string_func, search_config, search_stats, search_results);
+		return search_results;
+	}
+
+	template<typename String, typename Iterator, typename Func>
+	std::pmr::vector<pmr::SearchResult<String>> Search(const String& pattern_str, Iterator begin, Iterator end, Func&& get_string_func, SearchConfig search_config,
+	                                                   std::pmr::memory_resource& memory_resource, SearchStats* search_stats)
+	{
+		std::pmr::vector<pmr::SearchResult<String>> search_results(&memory_resource);
+		SearchInto(pattern_str, begin, end, get_string_func, search_config, search_stats, search_results);
 		return search_results;
 	}
 
@@ -0,0 +1,320 @@
+#pragma once
+
+#include "FuzzySearch.h"
+
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace FuzzySearch
+{
+	class CorpusImage;
+	class MappedFile;
+
+	struct CorpusConfig
+	{
+		// Search config the short query tables are built for, queries with a different config always scan
+		SearchConfig m_SearchConfig;
+
+		// Precompute the best results for every single character and the most common two character queries
+		bool m_PrecomputeShortQueries { false };
+		// Number of results stored for every precomputed query (K)
+		uint32_t m_ShortQueryResultCount { 50 };
+		// Number of most common bigrams in the corpus that get a precomputed table
+		uint32_t m_BigramTableSize { 256 };
+
+		// Keep a case folded copy of every string so matching compares plain bytes, doubles the string memory
+		bool m_KeepFoldedCopy { false };
+
+		// Also keep the folded strings transposed in blocks of 16, a search then rejects whole lanes of a block that lack
+		// too many pattern characters with a few vector operations per byte position. Costs 16 bytes per block row.
+		bool m_TransposedBlocks { false };
+
+		// Keep a 64 bit mask of the characters in every string and a summary of every Corpus::summary_block_size strings,
+		// a search skips whole blocks and single strings that lack too many pattern characters. Costs 8 bytes per string.
+		bool m_BlockSummaries { false };
+	};
+
+	// Corpus string together with its case folded copy, ToLower reads the copy and everything else the original
+	struct FoldedStringView
+	{
+		std::string_view m_Original;
+		const char* m_Folded = nullptr;
+	};
+
+	struct CorpusSearchResult
+	{
+		uint32_t m_Id = 0;
+		int m_Score = 0;
+		// Slice of CorpusSearchResults' position buffer holding the matched indexes
+		uint32_t m_MatchOffset = 0;
+		uint16_t m_MatchCount = 0;
+	};
+
+	// Matched indexes of one result, valid as long as the CorpusSearchResults it came from is unchanged
+	class MatchSpan
+	{
+	public:
+		MatchSpan() = default;
+		MatchSpan(const uint16_t* begin, size_t size)
+			: m_Begin(begin)
+			, m_Size(size)
+		{}
+
+		const uint16_t* begin() const { return m_Begin; }
+		const uint16_t* end() const { return m_Begin + m_Size; }
+		size_t size() const { return m_Size; }
+		bool empty() const { return m_Size == 0; }
+		uint16_t operator[](size_t index) const { return m_Begin[index]; }
+
+	private:
+		const uint16_t* m_Begin = nullptr;
+		size_t m_Size = 0;
+	};
+
+	/*
+	 * Result set of a corpus search.
+	 *
+	 * The matched indexes of all results share one flat buffer and every result refers to its slice by offset and count,
+	 * so a result is 16 bytes plus 2 bytes per match instead of a heap allocated vector. Corpus strings are at most
+	 * Corpus::max_string_length long so the indexes fit in 16 bits.
+	 *
+	 * Clearing keeps the capacity of both buffers, a set reused between queries stops allocating once it has grown.
+	*/
+	class CorpusSearchResults
+	{
+	public:
+		using iterator = std::vector<CorpusSearchResult>::iterator;
+		using const_iterator = std::vector<CorpusSearchResult>::const_iterator;
+
+		size_t size() const { return m_Results.size(); }
+		bool empty() const { return m_Results.empty(); }
+		const CorpusSearchResult& operator[](size_t index) const { return m_Results[index]; }
+		const_iterator begin() const { return m_Results.begin(); }
+		const_iterator end() const { return m_Results.end(); }
+
+		// Results can be reordered in place, their match slices stay valid
+		iterator begin() { return m_Results.begin(); }
+		iterator end() { return m_Results.end(); }
+
+		MatchSpan Matches(const CorpusSearchResult& search_result) const { return { m_MatchPositions.data() + search_result.m_MatchOffset, search_result.m_MatchCount }; }
+		MatchSpan Matches(size_t index) const { return Matches(m_Results[index]); }
+
+		void Reserve(size_t result_count, size_t match_count);
+		void Clear();
+		void Append(uint32_t id, const PatternMatch& pattern_match);
+		void Append(const CorpusSearchResult& search_result, MatchSpan matches);
+
+		// Replaces the match of a result, the new indexes are appended and the old slice is left unused until Compact
+		void SetMatch(size_t index, const PatternMatch& pattern_match);
+		// Drops every result after the first count
+		void Truncate(size_t count);
+		// Rewrites the position buffer in result order without unused slices
+		void Compact();
+
+	private:
+		std::vector<CorpusSearchResult> m_Results;
+		std::vector<uint16_t> m_MatchPositions;
+	};
+
+	/*
+	 * Corpus owns the strings that are searched and any index built on top of them.
+	 *
+	 * All strings are packed back to back into one buffer with parallel arrays for their offsets, lengths
+	 * and filename offsets, so a search is a linear sweep over memory instead of a pointer chase per string.
+	 *
+	 * Ids are assigned in insertion order. Results are ordered the same way as FuzzySearch::Search,
+	 * ties are broken by id so the order is deterministic.
+	 *
+	 * Strings can be removed and renamed in place, their id stays the same. Both leave the old bytes behind as dead
+	 * bytes and removed ids as tombstones that searches skip. Compact reclaims the dead bytes and hands the tombstoned
+	 * ids to later Adds, so an id is only reused after the Compact following its removal.
+	 *
+	 * A corpus attached to a CorpusImage reads its arrays straight from the mapped image. The first update copies them
+	 * into the corpus, copies of an attached corpus share the mapping.
+	*/
+	class Corpus
+	{
+	public:
+		// Longer strings are cut to this length when added
+		static constexpr size_t max_string_length = 0xFFFF;
+		// Rows kept per transposed block, longer strings skip the block prefilter
+		static constexpr int max_transposed_rows = 128;
+		// Strings per block summary
+		static constexpr uint32_t summary_block_size = 256;
+
+		explicit Corpus(CorpusConfig config = {});
+
+		void Reserve(size_t string_count, size_t byte_count);
+		uint32_t Add(std::string_view str);
+		// Replaces the string of a live id
+		void Rename(uint32_t id, std::string_view str);
+		// Tombstones the id, Get returns an empty string for it and searches skip it
+		void Remove(uint32_t id);
+		// Packs the live strings again and rebuilds the indexes, invalidates all views returned by Get
+		void Compact();
+
+		// Number of ids including tombstones, ids are always < Size()
+		size_t Size() const { return m_Image != nullptr ? m_ImageArrays.m_StringCount : m_Offsets.size(); }
+		size_t RemovedCount() const { return m_RemovedCount; }
+		bool IsRemoved(uint32_t id) const { return (m_Image != nullptr ? m_ImageArrays.m_Removed[id] : m_Removed[id]) != 0; }
+		// Bytes left behind by removed and renamed strings until the next Compact
+		size_t DeadBytes() const { return m_DeadBytes; }
+		// Bytes of all stored strings, dead ones included
+		size_t ByteSize() const { return m_Image != nullptr ? m_ImageArrays.m_ByteCount : m_Bytes.size(); }
+		std::string_view Get(uint32_t id) const;
+		int FilenameStart(uint32_t id) const { return m_Image != nullptr ? m_ImageArrays.m_FilenameOffsets[id] : m_FilenameOffsets[id]; }
+		const CorpusConfig& Config() const { return m_Config; }
+		// Set while the arrays are read from a mapped CorpusImage
+		bool IsAttached() const { return m_Image != nullptr; }
+
+		// (Re)builds the short query tables when CorpusConfig::m_PrecomputeShortQueries is set, adding strings invalidates them.
+		// Every table costs one scan of the corpus.
+		void BuildShortQueryTables();
+
+		// Returns the best max_results results, all results when max_results is 0.
+		// Single character queries and precomputed bigrams are answered from the short query tables when max_results <= K.
+		CorpusSearchResults Search(const std::string& pattern_str, SearchConfig search_config, size_t max_results = 0) const;
+
+		// Precomputed results Search would return for the query, nullptr when it has to scan.
+		// Can hold more than max_results results.
+		const CorpusSearchResults* FindShortQueryResults(const std::string& pattern_str, SearchConfig search_config, size_t max_results) const;
+
+		// Matches the strings with ids in [begin_id, end_id) and calls on_match(id, pattern_match) for every match.
+		// Building block for scanning the corpus in parts, Search and Searcher are implemented with it.
+		template<typename OnMatch>
+		void Match(const CompiledPattern& pattern, MatchScratch& scratch, SearchConfig search_config, uint32_t begin_id, uint32_t end_id,
+		           PatternMatch& pattern_match, OnMatch&& on_match) const;
+
+		// Rescores the head of sorted results with OptimalMatch and sorts it again, see SearchConfig::m_OptimalRescoreCount
+		void RescoreHead(const CompiledPattern& pattern, MatchScratch& scratch, SearchConfig search_config, CorpusSearchResults& search_results,
+		                 PatternMatch& pattern_match) const;
+
+	private:
+		struct ShortQueryTable
+		{
+			// Set when the table holds every result of the query and not just the best K
+			bool m_Complete = false;
+			CorpusSearchResults m_Results;
+		};
+
+		static uint16_t ShortQueryKey(const char* pattern, size_t length);
+
+		// Appends str to the string buffers for the id and updates the indexes
+		void Store(uint32_t id, std::string_view str);
+		// Writes the transposed block lane and character mask of the id, ids past the end are appended
+		void StoreIndexes(uint32_t id, std::string_view str);
+		void InvalidateShortQueryTables();
+
+		CorpusSearchResults Scan(const std::string& pattern_str, SearchConfig search_config, size_t max_results) const;
+
+		// Pattern characters of a search in buckets, and which bucket presence masks leave too many of them unmatched
+		struct BlockPrefilter
+		{
+			CharacterBuckets m_Buckets;
+			std::array<bool, 256> m_Reject{};
+		};
+
+		static bool BuildBlockPrefilter(const CompiledPattern& pattern, SearchConfig search_config, BlockPrefilter& prefilter);
+
+		// Characters of a search as character mask bits weighted by their pattern positions, and the shortest string
+		// that can hold enough of every word of the pattern
+		struct MaskPrefilter
+		{
+			uint64_t m_AllBits = 0;
+			int m_BitCount = 0;
+			std::array<uint8_t, 64> m_Bits{};
+			std::array<int, 64> m_Weights{};
+			int m_MinLength = 0;
+			int m_MaxUnmatched = 0;
+
+			bool Rejects(uint64_t character_mask, int length) const;
+		};
+
+		// OR of the character masks and longest length of the strings of a block
+		struct BlockSummary
+		{
+			uint64_t m_CharacterMask = 0;
+			uint16_t m_MaxLength = 0;
+		};
+
+		// Read only view of all arrays, points into the vectors below or into the attached image
+		struct Arrays
+		{
+			const char* m_Bytes = nullptr;
+			// nullptr without CorpusConfig::m_KeepFoldedCopy
+			const char* m_FoldedBytes = nullptr;
+			const uint32_t* m_Offsets = nullptr;
+			const uint16_t* m_Lengths = nullptr;
+			const uint16_t* m_FilenameOffsets = nullptr;
+			const uint8_t* m_Removed = nullptr;
+			const uint32_t* m_FreeIds = nullptr;
+			const uint8_t* m_BlockBytes = nullptr;
+			const uint32_t* m_BlockOffsets = nullptr;
+			const uint8_t* m_BlockRows = nullptr;
+			const uint64_t* m_CharacterMasks = nullptr;
+			const BlockSummary* m_BlockSummaries = nullptr;
+
+			size_t m_StringCount = 0;
+			size_t m_ByteCount = 0;
+			size_t m_FreeIdCount = 0;
+			size_t m_BlockByteCount = 0;
+			size_t m_BlockCount = 0;
+			size_t m_SummaryCount = 0;
+		};
+
+		Arrays GetArrays() const;
+		// Copies the arrays of the attached image into the vectors, every update starts with it
+		void Detach();
+
+		static int CharacterMaskBit(uint8_t folded_char);
+		static bool BuildMaskPrefilter(const CompiledPattern& pattern, SearchConfig search_config, MaskPrefilter& prefilter);
+
+		template<typename String, typename GetString, typename OnMatch>
+		void MatchStrings(const CompiledPattern& pattern, MatchScratch& scratch, SearchConfig search_config, uint32_t begin_id, uint32_t end_id,
+		                  PatternMatch& pattern_match, const Arrays& arrays, GetString&& get_string, OnMatch&& on_match) const;
+
+		CorpusConfig m_Config;
+
+		std::vector<char> m_Bytes;
+		// Same layout as m_Bytes, only filled with CorpusConfig::m_KeepFoldedCopy
+		std::vector<char> m_FoldedBytes;
+		std::vector<uint32_t> m_Offsets;
+		std::vector<uint16_t> m_Lengths;
+		// Start of the filename after the last path separator, used by E_FILENAMES and E_SOURCE_FILES
+		std::vector<uint16_t> m_FilenameOffsets;
+		std::vector<uint8_t> m_Removed;
+		size_t m_RemovedCount = 0;
+		size_t m_DeadBytes = 0;
+		// Tombstoned ids reclaimed by Compact, Add takes the smallest first
+		std::vector<uint32_t> m_FreeIds;
+
+		// Only filled with CorpusConfig::m_TransposedBlocks. Block b starts at m_BlockOffsets[b] and holds m_BlockRows[b] rows,
+		// row r has the folded byte r of the block's 16 strings and zeros past their end. Strings longer than their block's
+		// rows skip the prefilter.
+		std::vector<uint8_t> m_BlockBytes;
+		std::vector<uint32_t> m_BlockOffsets;
+		std::vector<uint8_t> m_BlockRows;
+
+		// Only filled with CorpusConfig::m_BlockSummaries, one mask per string and one summary per summary_block_size strings
+		std::vector<uint64_t> m_CharacterMasks;
+		std::vector<BlockSummary> m_BlockSummaries;
+
+		bool m_HasShortQueryTables = false;
+		std::array<ShortQueryTable, 256> m_CharacterTables;
+		std::unordered_map<uint16_t, ShortQueryTable> m_BigramTables;
+
+		// Only set for an attached corpus, the vectors above are empty and m_ImageArrays points into the mapping instead
+		std::shared_ptr<const MappedFile> m_Image;
+		Arrays m_ImageArrays;
+
+		// Writes and attaches images from the arrays
+		friend class CorpusImage;
+	};
+
+} // namespace FuzzySearch
+
+#include "FuzzySearchCorpus.inl"
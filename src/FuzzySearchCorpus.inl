@@ -0,0 +1,881 @@
+#include "FuzzySearchCorpus.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace FuzzySearch
+{
+	// FoldedStringView specialization
+	template<> inline int FuzzySearchStringRef<FoldedStringView>::Length() const { return (int)m_String->m_Original.length(); }
+	template<> inline bool FuzzySearchStringRef<FoldedStringView>::Empty() const { return m_String->m_Original.empty(); }
+
+	template<> inline bool FuzzySearchStringRef<FoldedStringView>::Equals(int start, int length, const char* str) const { return m_String->m_Original.compare(start, length, str) == 0; }
+	template<> inline int FuzzySearchStringRef<FoldedStringView>::FindLastOf(const char* str) const
+	{
+		size_t found = m_String->m_Original.find_last_of(str);
+		if (found == std::string_view::npos)
+		{
+			return -1;
+		}
+		return (int)found;
+	}
+
+	template<> inline bool FuzzySearchStringRef<FoldedStringView>::IsLower(size_t index) const { return (GetCharacterClass(m_String->m_Original[index]) & character_lower) != 0; }
+	template<> inline int FuzzySearchStringRef<FoldedStringView>::ToLower(size_t index) const { return m_String->m_Folded[index]; }
+
+	template<> inline int FuzzySearchStringRef<FoldedStringView>::operator[](size_t index) const { return m_String->m_Original[index]; }
+
+	template<> inline int FuzzySearchStringRef<FoldedStringView>::FindLower(int lower_char, int start_index) const
+	{
+		const int length = Length();
+		if (start_index >= length)
+		{
+			return length;
+		}
+
+		const char* folded = m_String->m_Folded;
+		const void* found = std::memchr(folded + start_index, lower_char, length - start_index);
+		return found != nullptr ? static_cast<int>(static_cast<const char*>(found) - folded) : length;
+	}
+
+	inline bool CompareCorpusResults(const Corpus& corpus, const CorpusSearchResult& lhs, const CorpusSearchResult& rhs) noexcept
+	{
+		if (lhs.m_Score != rhs.m_Score)
+		{
+			return lhs.m_Score > rhs.m_Score;
+		}
+
+		const size_t lhs_length = corpus.Get(lhs.m_Id).length();
+		const size_t rhs_length = corpus.Get(rhs.m_Id).length();
+		if (lhs_length != rhs_length)
+		{
+			return lhs_length < rhs_length;
+		}
+
+		return lhs.m_Id < rhs.m_Id;
+	}
+
+	inline void CorpusSearchResults::Reserve(size_t result_count, size_t match_count)
+	{
+		m_Results.reserve(result_count);
+		m_MatchPositions.reserve(match_count);
+	}
+
+	inline void CorpusSearchResults::Clear()
+	{
+		m_Results.clear();
+		m_MatchPositions.clear();
+	}
+
+	inline void CorpusSearchResults::Append(uint32_t id, const PatternMatch& pattern_match)
+	{
+		m_Results.push_back({ id, pattern_match.m_Score, static_cast<uint32_t>(m_MatchPositions.size()), static_cast<uint16_t>(pattern_match.m_Matches.size()) });
+		m_MatchPositions.insert(m_MatchPositions.end(), pattern_match.m_Matches.begin(), pattern_match.m_Matches.end());
+	}
+
+	inline void CorpusSearchResults::Append(const CorpusSearchResult& search_result, MatchSpan matches)
+	{
+		m_Results.push_back({ search_result.m_Id, search_result.m_Score, static_cast<uint32_t>(m_MatchPositions.size()), static_cast<uint16_t>(matches.size()) });
+		m_MatchPositions.insert(m_MatchPositions.end(), matches.begin(), matches.end());
+	}
+
+	inline void CorpusSearchResults::SetMatch(size_t index, const PatternMatch& pattern_match)
+	{
+		CorpusSearchResult& search_result = m_Results[index];
+		search_result.m_Score = pattern_match.m_Score;
+		search_result.m_MatchOffset = static_cast<uint32_t>(m_MatchPositions.size());
+		search_result.m_MatchCount = static_cast<uint16_t>(pattern_match.m_Matches.size());
+		m_MatchPositions.insert(m_MatchPositions.end(), pattern_match.m_Matches.begin(), pattern_match.m_Matches.end());
+	}
+
+	inline void CorpusSearchResults::Truncate(size_t count)
+	{
+		if (count < m_Results.size())
+		{
+			m_Results.resize(count);
+		}
+	}
+
+	inline void CorpusSearchResults::Compact()
+	{
+		size_t match_count = 0;
+		for (const CorpusSearchResult& search_result : m_Results)
+		{
+			match_count += search_result.m_MatchCount;
+		}
+
+		std::vector<uint16_t> match_positions;
+		match_positions.reserve(match_count);
+		for (CorpusSearchResult& search_result : m_Results)
+		{
+			const uint16_t* matches = m_MatchPositions.data() + search_result.m_MatchOffset;
+			search_result.m_MatchOffset = static_cast<uint32_t>(match_positions.size());
+			match_positions.insert(match_positions.end(), matches, matches + search_result.m_MatchCount);
+		}
+		m_MatchPositions = std::move(match_positions);
+	}
+
+	inline Corpus::Corpus(CorpusConfig config)
+		: m_Config(config)
+	{}
+
+	inline std::string_view Corpus::Get(uint32_t id) const
+	{
+		if (m_Image != nullptr)
+		{
+			return { m_ImageArrays.m_Bytes + m_ImageArrays.m_Offsets[id], m_ImageArrays.m_Lengths[id] };
+		}
+		return { m_Bytes.data() + m_Offsets[id], m_Lengths[id] };
+	}
+
+	inline Corpus::Arrays Corpus::GetArrays() const
+	{
+		if (m_Image != nullptr)
+		{
+			return m_ImageArrays;
+		}
+
+		Arrays arrays;
+		arrays.m_Bytes = m_Bytes.data();
+		arrays.m_FoldedBytes = m_Config.m_KeepFoldedCopy ? m_FoldedBytes.data() : nullptr;
+		arrays.m_Offsets = m_Offsets.data();
+		arrays.m_Lengths = m_Lengths.data();
+		arrays.m_FilenameOffsets = m_FilenameOffsets.data();
+		arrays.m_Removed = m_Removed.data();
+		arrays.m_FreeIds = m_FreeIds.data();
+		arrays.m_BlockBytes = m_BlockBytes.data();
+		arrays.m_BlockOffsets = m_BlockOffsets.data();
+		arrays.m_BlockRows = m_BlockRows.data();
+		arrays.m_CharacterMasks = m_CharacterMasks.data();
+		arrays.m_BlockSummaries = m_BlockSummaries.data();
+		arrays.m_StringCount = m_Offsets.size();
+		arrays.m_ByteCount = m_Bytes.size();
+		arrays.m_FreeIdCount = m_FreeIds.size();
+		arrays.m_BlockByteCount = m_BlockBytes.size();
+		arrays.m_BlockCount = m_BlockOffsets.size();
+		arrays.m_SummaryCount = m_BlockSummaries.size();
+		return arrays;
+	}
+
+	inline void Corpus::Detach()
+	{
+		if (m_Image == nullptr)
+		{
+			return;
+		}
+
+		const Arrays& arrays = m_ImageArrays;
+		const size_t string_count = arrays.m_StringCount;
+		m_Bytes.assign(arrays.m_Bytes, arrays.m_Bytes + arrays.m_ByteCount);
+		if (arrays.m_FoldedBytes != nullptr)
+		{
+			m_FoldedBytes.assign(arrays.m_FoldedBytes, arrays.m_FoldedBytes + arrays.m_ByteCount);
+		}
+		m_Offsets.assign(arrays.m_Offsets, arrays.m_Offsets + string_count);
+		m_Lengths.assign(arrays.m_Lengths, arrays.m_Lengths + string_count);
+		m_FilenameOffsets.assign(arrays.m_FilenameOffsets, arrays.m_FilenameOffsets + string_count);
+		m_Removed.assign(arrays.m_Removed, arrays.m_Removed + string_count);
+		m_FreeIds.assign(arrays.m_FreeIds, arrays.m_FreeIds + arrays.m_FreeIdCount);
+		if (m_Config.m_TransposedBlocks)
+		{
+			m_BlockBytes.assign(arrays.m_BlockBytes, arrays.m_BlockBytes + arrays.m_BlockByteCount);
+			m_BlockOffsets.assign(arrays.m_BlockOffsets, arrays.m_BlockOffsets + arrays.m_BlockCount);
+			m_BlockRows.assign(arrays.m_BlockRows, arrays.m_BlockRows + arrays.m_BlockCount);
+		}
+		if (m_Config.m_BlockSummaries)
+		{
+			m_CharacterMasks.assign(arrays.m_CharacterMasks, arrays.m_CharacterMasks + string_count);
+			m_BlockSummaries.assign(arrays.m_BlockSummaries, arrays.m_BlockSummaries + arrays.m_SummaryCount);
+		}
+
+		m_Image.reset();
+		m_ImageArrays = {};
+	}
+
+	inline void Corpus::Reserve(size_t string_count, size_t byte_count)
+	{
+		Detach();
+		m_Bytes.reserve(byte_count);
+		if (m_Config.m_KeepFoldedCopy)
+		{
+			m_FoldedBytes.reserve(byte_count);
+		}
+		m_Offsets.reserve(string_count);
+		m_Lengths.reserve(string_count);
+		m_FilenameOffsets.reserve(string_count);
+		if (m_Config.m_TransposedBlocks)
+		{
+			m_BlockOffsets.reserve((string_count + block_lanes - 1) / block_lanes);
+			m_BlockRows.reserve((string_count + block_lanes - 1) / block_lanes);
+		}
+		if (m_Config.m_BlockSummaries)
+		{
+			m_CharacterMasks.reserve(string_count);
+			m_BlockSummaries.reserve((string_count + summary_block_size - 1) / summary_block_size);
+		}
+	}
+
+	inline uint32_t Corpus::Add(std::string_view str)
+	{
+		Detach();
+		uint32_t id = 0;
+		if (!m_FreeIds.empty())
+		{
+			id = m_FreeIds.back();
+			m_FreeIds.pop_back();
+			m_Removed[id] = 0;
+			--m_RemovedCount;
+		}
+		else
+		{
+			id = static_cast<uint32_t>(m_Offsets.size());
+			m_Offsets.push_back(0);
+			m_Lengths.push_back(0);
+			m_FilenameOffsets.push_back(0);
+			m_Removed.push_back(0);
+		}
+
+		Store(id, str);
+		return id;
+	}
+
+	inline void Corpus::Rename(uint32_t id, std::string_view str)
+	{
+		Detach();
+		m_DeadBytes += m_Lengths[id];
+		Store(id, str);
+	}
+
+	inline void Corpus::Remove(uint32_t id)
+	{
+		Detach();
+		if (m_Removed[id] != 0)
+		{
+			return;
+		}
+
+		m_DeadBytes += m_Lengths[id];
+		m_Lengths[id] = 0;
+		m_FilenameOffsets[id] = 0;
+		m_Removed[id] = 1;
+		++m_RemovedCount;
+		InvalidateShortQueryTables();
+	}
+
+	inline void Corpus::Compact()
+	{
+		Detach();
+		std::vector<char> bytes;
+		std::vector<char> folded_bytes;
+		bytes.reserve(m_Bytes.size() - m_DeadBytes);
+		folded_bytes.reserve(m_FoldedBytes.empty() ? 0 : m_Bytes.size() - m_DeadBytes);
+		for (uint32_t id = 0; id < static_cast<uint32_t>(Size()); ++id)
+		{
+			const uint32_t offset = m_Offsets[id];
+			m_Offsets[id] = static_cast<uint32_t>(bytes.size());
+			bytes.insert(bytes.end(), m_Bytes.begin() + offset, m_Bytes.begin() + offset + m_Lengths[id]);
+			if (m_Config.m_KeepFoldedCopy)
+			{
+				folded_bytes.insert(folded_bytes.end(), m_FoldedBytes.begin() + offset, m_FoldedBytes.begin() + offset + m_Lengths[id]);
+			}
+		}
+		m_Bytes = std::move(bytes);
+		m_FoldedBytes = std::move(folded_bytes);
+		m_DeadBytes = 0;
+
+		// Summaries only ever grow on rename and remove, rebuilding makes them exact again
+		m_BlockBytes.clear();
+		m_BlockOffsets.clear();
+		m_BlockRows.clear();
+		m_CharacterMasks.clear();
+		m_BlockSummaries.clear();
+		for (uint32_t id = 0; id < static_cast<uint32_t>(Size()); ++id)
+		{
+			StoreIndexes(id, Get(id));
+		}
+
+		m_FreeIds.clear();
+		for (uint32_t id = static_cast<uint32_t>(Size()); id-- > 0;)
+		{
+			if (m_Removed[id] != 0)
+			{
+				m_FreeIds.push_back(id);
+			}
+		}
+	}
+
+	inline void Corpus::Store(uint32_t id, std::string_view str)
+	{
+		str = str.substr(0, max_string_length);
+
+		m_Offsets[id] = static_cast<uint32_t>(m_Bytes.size());
+		m_Lengths[id] = static_cast<uint16_t>(str.length());
+		m_FilenameOffsets[id] = static_cast<uint16_t>(FindFilenameStart(FuzzySearchStringRef<std::string_view>(str), MatchMode::E_FILENAMES));
+		m_Bytes.insert(m_Bytes.end(), str.begin(), str.end());
+
+		if (m_Config.m_KeepFoldedCopy)
+		{
+			// Same folding as FuzzySearchStringRef::ToLower
+			const FuzzySearchStringRef<std::string_view> str_ref(str);
+			for (int index = 0; index < str_ref.Length(); ++index)
+			{
+				m_FoldedBytes.push_back(static_cast<char>(str_ref.ToLower(index)));
+			}
+		}
+
+		StoreIndexes(id, str);
+		InvalidateShortQueryTables();
+	}
+
+	inline void Corpus::StoreIndexes(uint32_t id, std::string_view str)
+	{
+		const FuzzySearchStringRef<std::string_view> str_ref(str);
+
+		if (m_Config.m_TransposedBlocks)
+		{
+			const uint32_t block = id / block_lanes;
+			const int lane = static_cast<int>(id % block_lanes);
+			if (block == m_BlockOffsets.size())
+			{
+				m_BlockOffsets.push_back(static_cast<uint32_t>(m_BlockBytes.size()));
+				m_BlockRows.push_back(0);
+			}
+
+			int row_count = std::min(static_cast<int>(str.length()), max_transposed_rows);
+			if (row_count > m_BlockRows[block])
+			{
+				if (block + 1 == m_BlockOffsets.size())
+				{
+					// Rows are appended at the end of the last block, the existing lanes stay where they are
+					m_BlockBytes.resize(m_BlockBytes.size() + (row_count - m_BlockRows[block]) * block_lanes, 0);
+					m_BlockRows[block] = static_cast<uint8_t>(row_count);
+				}
+				else
+				{
+					// Earlier blocks cannot grow, the string is longer than its block and skips the prefilter
+					row_count = m_BlockRows[block];
+				}
+			}
+
+			uint8_t* rows = m_BlockBytes.data() + m_BlockOffsets[block];
+			for (int row = 0; row < m_BlockRows[block]; ++row)
+			{
+				rows[row * block_lanes + lane] = row < row_count ? static_cast<uint8_t>(str_ref.ToLower(row)) : 0;
+			}
+		}
+
+		if (m_Config.m_BlockSummaries)
+		{
+			uint64_t character_mask = 0;
+			for (int index = 0; index < str_ref.Length(); ++index)
+			{
+				character_mask |= uint64_t(1) << CharacterMaskBit(static_cast<uint8_t>(str_ref.ToLower(index)));
+			}
+
+			if (id == m_CharacterMasks.size())
+			{
+				m_CharacterMasks.push_back(character_mask);
+			}
+			else
+			{
+				m_CharacterMasks[id] = character_mask;
+			}
+
+			if (id / summary_block_size == m_BlockSummaries.size())
+			{
+				m_BlockSummaries.emplace_back();
+			}
+			BlockSummary& summary = m_BlockSummaries[id / summary_block_size];
+			summary.m_CharacterMask |= character_mask;
+			summary.m_MaxLength = std::max(summary.m_MaxLength, static_cast<uint16_t>(str.length()));
+		}
+	}
+
+	inline void Corpus::InvalidateShortQueryTables()
+	{
+		if (m_HasShortQueryTables)
+		{
+			m_HasShortQueryTables = false;
+			m_CharacterTables = {};
+			m_BigramTables.clear();
+		}
+	}
+
+	inline uint16_t Corpus::ShortQueryKey(const char* pattern, size_t length)
+	{
+		// Only letters are folded, other characters can differ in how the pattern treats them (separators etc.)
+		auto normalize = [](char c) -> uint16_t
+		{
+			const unsigned char byte = static_cast<unsigned char>(c);
+			return byte >= 'A' && byte <= 'Z' ? static_cast<uint16_t>(byte | 0x20) : byte;
+		};
+
+		if (length == 1)
+		{
+			return normalize(pattern[0]);
+		}
+
+		return static_cast<uint16_t>(normalize(pattern[0]) << 8 | normalize(pattern[1]));
+	}
+
+	inline void Corpus::BuildShortQueryTables()
+	{
+		m_HasShortQueryTables = false;
+		m_CharacterTables = {};
+		m_BigramTables.clear();
+
+		if (!m_Config.m_PrecomputeShortQueries)
+		{
+			return;
+		}
+
+		std::array<bool, 256> used_characters{};
+		std::unordered_map<uint16_t, size_t> bigram_counts;
+		for (uint32_t id = 0; id < static_cast<uint32_t>(Size()); ++id)
+		{
+			const std::string_view str = Get(id);
+			for (size_t index = 0; index < str.length(); ++index)
+			{
+				used_characters[ShortQueryKey(str.data() + index, 1)] = true;
+				if (index + 1 < str.length())
+				{
+					++bigram_counts[ShortQueryKey(str.data() + index, 2)];
+				}
+			}
+		}
+
+		const size_t result_count = m_Config.m_ShortQueryResultCount;
+		auto build_table = [this, result_count](const std::string& pattern_str, ShortQueryTable& table)
+		{
+			// One extra result tells if the table is complete
+			table.m_Results = Scan(pattern_str, m_Config.m_SearchConfig, result_count + 1);
+			table.m_Complete = table.m_Results.size() <= result_count;
+			table.m_Results.Truncate(result_count);
+		};
+
+		for (size_t character = 0; character < used_characters.size(); ++character)
+		{
+			if (used_characters[character])
+			{
+				build_table(std::string(1, static_cast<char>(character)), m_CharacterTables[character]);
+			}
+		}
+
+		std::vector<std::pair<uint16_t, size_t>> bigrams(bigram_counts.begin(), bigram_counts.end());
+		const size_t bigram_count = std::min<size_t>(bigrams.size(), m_Config.m_BigramTableSize);
+		std::partial_sort(bigrams.begin(), bigrams.begin() + bigram_count, bigrams.end(), [](const auto& lhs, const auto& rhs)
+		{
+			return lhs.second != rhs.second ? lhs.second > rhs.second : lhs.first < rhs.first;
+		});
+
+		for (size_t index = 0; index < bigram_count; ++index)
+		{
+			const uint16_t key = bigrams[index].first;
+			const std::string pattern_str = { static_cast<char>(key >> 8), static_cast<char>(key & 0xFF) };
+			build_table(pattern_str, m_BigramTables[key]);
+		}
+
+		m_HasShortQueryTables = true;
+	}
+
+	inline const CorpusSearchResults* Corpus::FindShortQueryResults(const std::string& pattern_str, SearchConfig search_config, size_t max_results) const
+	{
+		if (!m_HasShortQueryTables || pattern_str.empty() || pattern_str.length() > 2)
+		{
+			return nullptr;
+		}
+
+		const SearchConfig& table_config = m_Config.m_SearchConfig;
+		if (search_config.m_MatchMode != table_config.m_MatchMode
+		    || search_config.m_MaxUnmatchedCharactersFromPattern != table_config.m_MaxUnmatchedCharactersFromPattern
+		    || search_config.m_OptimalRescoreCount != table_config.m_OptimalRescoreCount)
+		{
+			return nullptr;
+		}
+
+		const ShortQueryTable* table = nullptr;
+		if (pattern_str.length() == 1)
+		{
+			table = &m_CharacterTables[ShortQueryKey(pattern_str.data(), 1)];
+		}
+		else
+		{
+			auto found = m_BigramTables.find(ShortQueryKey(pattern_str.data(), 2));
+			table = found != m_BigramTables.end() ? &found->second : nullptr;
+		}
+
+		// Characters that are not in the corpus have no table, a scan returns the same (empty) result
+		if (table == nullptr || table->m_Results.empty())
+		{
+			return nullptr;
+		}
+
+		if (!table->m_Complete && (max_results == 0 || max_results > m_Config.m_ShortQueryResultCount))
+		{
+			return nullptr;
+		}
+
+		return &table->m_Results;
+	}
+
+	inline CorpusSearchResults Corpus::Search(const std::string& pattern_str, SearchConfig search_config, size_t max_results) const
+	{
+		if (const CorpusSearchResults* short_query_results = FindShortQueryResults(pattern_str, search_config, max_results))
+		{
+			const size_t result_count = max_results == 0 ? short_query_results->size() : std::min(max_results, short_query_results->size());
+
+			CorpusSearchResults search_results;
+			search_results.Reserve(result_count, result_count * pattern_str.length());
+			for (size_t index = 0; index < result_count; ++index)
+			{
+				search_results.Append((*short_query_results)[index], short_query_results->Matches(index));
+			}
+			return search_results;
+		}
+
+		return Scan(pattern_str, search_config, max_results);
+	}
+
+	inline CorpusSearchResults Corpus::Scan(const std::string& pattern_str, SearchConfig search_config, size_t max_results) const
+	{
+		const CompiledPattern pattern{ FuzzySearchStringRef<std::string>(pattern_str) };
+		if (pattern.Empty())
+		{
+			return {};
+		}
+
+		MatchScratch scratch;
+		PatternMatch pattern_match;
+		pattern_match.m_Matches.reserve(pattern.Length());
+
+		const Arrays arrays = GetArrays();
+		CorpusSearchResults search_results;
+		Match(pattern, scratch, search_config, 0, static_cast<uint32_t>(Size()), pattern_match, [&search_results](uint32_t id, const PatternMatch& match)
+		{
+			search_results.Append(id, match);
+		});
+
+		const size_t result_count = max_results == 0 ? search_results.size() : std::min(max_results, search_results.size());
+		if (result_count == search_results.size())
+		{
+			// Results are collected in id order so the rank key index breaks ties by id, same as CompareCorpusResults
+			std::vector<RankKey> rank_keys;
+			std::vector<RankKey> rank_buffer;
+			rank_keys.reserve(search_results.size());
+			for (size_t index = 0; index < search_results.size(); ++index)
+			{
+				const CorpusSearchResult& search_result = search_results[index];
+				rank_keys.push_back({ MakeRankKey(search_result.m_Score, arrays.m_Lengths[search_result.m_Id]), static_cast<uint32_t>(index) });
+			}
+			SortRankKeys(rank_keys, rank_buffer);
+
+			CorpusSearchResults ranked_results;
+			ranked_results.Reserve(search_results.size(), search_results.size() * pattern.Length());
+			for (const RankKey& rank_key : rank_keys)
+			{
+				ranked_results.Append(search_results[rank_key.m_Index], search_results.Matches(rank_key.m_Index));
+			}
+			search_results = std::move(ranked_results);
+		}
+		else
+		{
+			auto compare = [this](const CorpusSearchResult& lhs, const CorpusSearchResult& rhs) { return CompareCorpusResults(*this, lhs, rhs); };
+			std::partial_sort(search_results.begin(), search_results.begin() + result_count, search_results.end(), compare);
+			search_results.Truncate(result_count);
+		}
+
+		RescoreHead(pattern, scratch, search_config, search_results, pattern_match);
+
+		// Drops the matches of the cut results and lays the rest out in rank order
+		search_results.Compact();
+
+		return search_results;
+	}
+
+	inline void Corpus::RescoreHead(const CompiledPattern& pattern, MatchScratch& scratch, SearchConfig search_config, CorpusSearchResults& search_results,
+	                                PatternMatch& pattern_match) const
+	{
+		// Same as FuzzySearch::Search, rescore the head of the list with the optimal alignment
+		const size_t rescore_count = std::min<size_t>(search_config.m_OptimalRescoreCount, search_results.size());
+		if (rescore_count == 0)
+		{
+			return;
+		}
+
+		for (size_t index = 0; index < rescore_count; ++index)
+		{
+			const std::string_view str = Get(search_results[index].m_Id);
+			if (OptimalMatch(pattern, scratch, FuzzySearchStringRef<std::string_view>(str), search_config, pattern_match))
+			{
+				search_results.SetMatch(index, pattern_match);
+			}
+		}
+
+		std::sort(search_results.begin(), search_results.begin() + rescore_count,
+		          [this](const CorpusSearchResult& lhs, const CorpusSearchResult& rhs) { return CompareCorpusResults(*this, lhs, rhs); });
+	}
+
+	template<typename OnMatch>
+	void Corpus::Match(const CompiledPattern& pattern, MatchScratch& scratch, SearchConfig search_config, uint32_t begin_id, uint32_t end_id,
+	                   PatternMatch& pattern_match, OnMatch&& on_match) const
+	{
+		const Arrays arrays = GetArrays();
+		if (m_Config.m_KeepFoldedCopy)
+		{
+			MatchStrings<FoldedStringView>(pattern, scratch, search_config, begin_id, end_id, pattern_match, arrays, [&arrays](uint32_t id) -> FoldedStringView
+			{
+				return { { arrays.m_Bytes + arrays.m_Offsets[id], arrays.m_Lengths[id] }, arrays.m_FoldedBytes + arrays.m_Offsets[id] };
+			}, on_match);
+		}
+		else
+		{
+			MatchStrings<std::string_view>(pattern, scratch, search_config, begin_id, end_id, pattern_match, arrays, [&arrays](uint32_t id) -> std::string_view
+			{
+				return { arrays.m_Bytes + arrays.m_Offsets[id], arrays.m_Lengths[id] };
+			}, on_match);
+		}
+	}
+
+	inline bool Corpus::BuildBlockPrefilter(const CompiledPattern& pattern, SearchConfig search_config, BlockPrefilter& prefilter)
+	{
+		// FuzzyMatch counts every pattern position whose character is missing from the string as unmatched,
+		// a string missing more than m_MaxUnmatchedCharactersFromPattern of them can never match
+		constexpr int bucket_count = 8;
+		std::array<int, bucket_count> bucket_weights{};
+		std::array<int, 256> character_buckets;
+		character_buckets.fill(-1);
+
+		int distinct_count = 0;
+		int position_count = 0;
+		for (int pattern_index = 0; pattern_index < pattern.Length(); ++pattern_index)
+		{
+			if (pattern.IsSpace(pattern_index))
+			{
+				continue;
+			}
+
+			const uint8_t folded_char = static_cast<uint8_t>(pattern.ToLower(pattern_index));
+			if (character_buckets[folded_char] < 0)
+			{
+				// Characters past the eighth share buckets, that only makes the filter weaker
+				character_buckets[folded_char] = distinct_count++ % bucket_count;
+				prefilter.m_Buckets.Add(folded_char, character_buckets[folded_char]);
+			}
+			++bucket_weights[character_buckets[folded_char]];
+			++position_count;
+		}
+
+		if (position_count <= search_config.m_MaxUnmatchedCharactersFromPattern)
+		{
+			return false;
+		}
+
+		for (int presence = 0; presence < 256; ++presence)
+		{
+			int absent_count = 0;
+			for (int bucket = 0; bucket < bucket_count; ++bucket)
+			{
+				absent_count += (presence & (1 << bucket)) == 0 ? bucket_weights[bucket] : 0;
+			}
+			prefilter.m_Reject[presence] = absent_count > search_config.m_MaxUnmatchedCharactersFromPattern;
+		}
+		return true;
+	}
+
+	inline int Corpus::CharacterMaskBit(uint8_t folded_char)
+	{
+		// Letters and digits get a bit each, everything else shares the remaining 28
+		if (folded_char >= 'a' && folded_char <= 'z')
+		{
+			return folded_char - 'a';
+		}
+		if (folded_char >= '0' && folded_char <= '9')
+		{
+			return 26 + folded_char - '0';
+		}
+		return 36 + folded_char % 28;
+	}
+
+	inline bool Corpus::MaskPrefilter::Rejects(uint64_t character_mask, int length) const
+	{
+		if (length < m_MinLength)
+		{
+			return true;
+		}
+		if ((character_mask & m_AllBits) == m_AllBits)
+		{
+			return false;
+		}
+
+		int absent_count = 0;
+		for (int index = 0; index < m_BitCount; ++index)
+		{
+			if ((character_mask & (uint64_t(1) << m_Bits[index])) == 0)
+			{
+				absent_count += m_Weights[index];
+				if (absent_count > m_MaxUnmatched)
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	inline bool Corpus::BuildMaskPrefilter(const CompiledPattern& pattern, SearchConfig search_config, MaskPrefilter& prefilter)
+	{
+		// Same rule as BuildBlockPrefilter, every pattern position whose character is missing from the string is unmatched
+		std::array<int, 64> bit_indexes;
+		bit_indexes.fill(-1);
+
+		int position_count = 0;
+		int longest_word = 0;
+		int word_length = 0;
+		for (int pattern_index = 0; pattern_index < pattern.Length(); ++pattern_index)
+		{
+			if (pattern.IsSpace(pattern_index))
+			{
+				word_length = 0;
+				continue;
+			}
+
+			const int bit = CharacterMaskBit(static_cast<uint8_t>(pattern.ToLower(pattern_index)));
+			if (bit_indexes[bit] < 0)
+			{
+				bit_indexes[bit] = prefilter.m_BitCount++;
+				prefilter.m_Bits[bit_indexes[bit]] = static_cast<uint8_t>(bit);
+				prefilter.m_AllBits |= uint64_t(1) << bit;
+			}
+			++prefilter.m_Weights[bit_indexes[bit]];
+			++position_count;
+			longest_word = std::max(longest_word, ++word_length);
+		}
+
+		prefilter.m_MaxUnmatched = search_config.m_MaxUnmatchedCharactersFromPattern;
+		if (position_count <= prefilter.m_MaxUnmatched)
+		{
+			return false;
+		}
+
+		// The runs matched for one word of the pattern never overlap in the string, a string of length L leaves at least
+		// word_length - L positions of every longer word unmatched. Binary search the shortest length that can still match.
+		auto unmatched_at_length = [&pattern](int length)
+		{
+			int unmatched_count = 0;
+			int current_word = 0;
+			for (int pattern_index = 0; pattern_index <= pattern.Length(); ++pattern_index)
+			{
+				if (pattern_index == pattern.Length() || pattern.IsSpace(pattern_index))
+				{
+					unmatched_count += std::max(0, current_word - length);
+					current_word = 0;
+				}
+				else
+				{
+					++current_word;
+				}
+			}
+			return unmatched_count;
+		};
+
+		int low = 0;
+		int high = longest_word;
+		while (low < high)
+		{
+			const int middle = (low + high) / 2;
+			if (unmatched_at_length(middle) > prefilter.m_MaxUnmatched)
+			{
+				low = middle + 1;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+		prefilter.m_MinLength = low;
+		return true;
+	}
+
+	template<typename String, typename GetString, typename OnMatch>
+	void Corpus::MatchStrings(const CompiledPattern& pattern, MatchScratch& scratch, SearchConfig search_config, uint32_t begin_id, uint32_t end_id,
+	                          PatternMatch& pattern_match, const Arrays& arrays, GetString&& get_string, OnMatch&& on_match) const
+	{
+		const bool use_filename = search_config.m_MatchMode != MatchMode::E_STRINGS;
+		const bool has_removed = m_RemovedCount != 0;
+
+		MaskPrefilter mask_prefilter;
+		const bool use_masks = m_Config.m_BlockSummaries && begin_id < end_id && BuildMaskPrefilter(pattern, search_config, mask_prefilter);
+
+		auto match_string = [&](uint32_t id)
+		{
+			if (has_removed && arrays.m_Removed[id] != 0)
+			{
+				return;
+			}
+			if (use_masks && mask_prefilter.Rejects(arrays.m_CharacterMasks[id], arrays.m_Lengths[id]))
+			{
+				return;
+			}
+
+			const String str = get_string(id);
+			const int filename_start_index = use_filename ? arrays.m_FilenameOffsets[id] : 0;
+			if (FuzzyMatch(pattern, scratch, FuzzySearchStringRef<String>(str), filename_start_index, search_config, pattern_match))
+			{
+				on_match(id, static_cast<const PatternMatch&>(pattern_match));
+			}
+		};
+
+		BlockPrefilter prefilter;
+		const bool use_blocks = m_Config.m_TransposedBlocks && begin_id < end_id && BuildBlockPrefilter(pattern, search_config, prefilter);
+
+		auto match_range = [&](uint32_t range_begin, uint32_t range_end)
+		{
+			if (!use_blocks)
+			{
+				for (uint32_t id = range_begin; id < range_end; ++id)
+				{
+					match_string(id);
+				}
+				return;
+			}
+
+			for (uint32_t block = range_begin / block_lanes; block * block_lanes < range_end; ++block)
+			{
+				alignas(16) std::array<uint8_t, block_lanes> presence{};
+				BlockPresence(arrays.m_BlockBytes + arrays.m_BlockOffsets[block], arrays.m_BlockRows[block], prefilter.m_Buckets, presence.data());
+
+				const uint32_t block_begin = block * block_lanes;
+				const uint32_t block_end = std::min<uint32_t>(block_begin + block_lanes, range_end);
+				for (uint32_t id = std::max(range_begin, block_begin); id < block_end; ++id)
+				{
+					if (prefilter.m_Reject[presence[id - block_begin]] && arrays.m_Lengths[id] <= arrays.m_BlockRows[block])
+					{
+						continue;
+					}
+					match_string(id);
+				}
+			}
+		};
+
+		if (!use_masks)
+		{
+			match_range(begin_id, end_id);
+			return;
+		}
+
+		// Blocks whose summary already rules out a match are skipped without touching their strings
+		for (uint32_t block = begin_id / summary_block_size; block * summary_block_size < end_id; ++block)
+		{
+			const BlockSummary& summary = arrays.m_BlockSummaries[block];
+			if (mask_prefilter.Rejects(summary.m_CharacterMask, summary.m_MaxLength))
+			{
+				continue;
+			}
+
+			const uint32_t block_begin = block * summary_block_size;
+			match_range(std::max(begin_id, block_begin), std::min(end_id, block_begin + summary_block_size));
+		}
+	}
+
+} // namespace FuzzySearch
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "FuzzySearchCorpus.h"
+#include "FuzzySearchMappedFile.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace FuzzySearch
+{
+	enum class CorpusImageError : uint8_t
+	{
+		E_NONE,
+		E_OPEN_FAILED,
+		E_WRITE_FAILED,
+		E_BAD_SIGNATURE,
+		E_UNSUPPORTED_VERSION,
+		E_TRUNCATED,
+		E_CORRUPT
+	};
+
+	const char* CorpusImageErrorName(CorpusImageError error);
+
+	/*
+	 * A Corpus laid out as one file that other processes map and search without copying or parsing it.
+	 *
+	 * The file is a header followed by every array of the corpus, the header refers to the arrays by their offset in the
+	 * file so the image works wherever it is mapped. Put it on a tmpfs like /dev/shm to share it as a POSIX shared memory
+	 * segment, or anywhere else to share it through the page cache.
+	 *
+	 * Write replaces the image with a rename, a reader attaching at the same time gets either the old or the new image and
+	 * readers that attached before keep their mapping of the old one. Images are in the byte order and layout of the
+	 * machine that wrote them and are meant to be shared between processes on that machine. Short query tables are not
+	 * part of the image, BuildShortQueryTables on the attached corpus builds them for one process.
+	*/
+	class CorpusImage
+	{
+	public:
+		// Writes the corpus with a version number of the caller's choosing, e.g. VersionedCorpus::Version
+		static CorpusImageError Write(const Corpus& corpus, uint64_t version, const std::string& path);
+
+		// Maps the image and points out_corpus at it, the whole image is validated first
+		static CorpusImageError Attach(const std::string& path, Corpus& out_corpus, uint64_t* out_version = nullptr);
+
+	private:
+		enum Section : uint32_t
+		{
+			E_BYTES,
+			E_FOLDED_BYTES,
+			E_OFFSETS,
+			E_LENGTHS,
+			E_FILENAME_OFFSETS,
+			E_REMOVED,
+			E_FREE_IDS,
+			E_BLOCK_BYTES,
+			E_BLOCK_OFFSETS,
+			E_BLOCK_ROWS,
+			E_CHARACTER_MASKS,
+			E_BLOCK_SUMMARIES,
+			E_SECTION_COUNT
+		};
+
+		struct SectionEntry
+		{
+			uint64_t m_Offset;
+			uint64_t m_Size;
+		};
+
+		struct Header
+		{
+			char m_Signature[8];
+			uint32_t m_FormatVersion;
+			// Catches images written by a build with a different layout
+			uint32_t m_HeaderSize;
+			uint32_t m_ByteOrderMark;
+			uint32_t m_SectionCount;
+
+			uint8_t m_MatchMode;
+			uint8_t m_MaxUnmatchedCharactersFromPattern;
+			uint16_t m_OptimalRescoreCount;
+			uint8_t m_PrecomputeShortQueries;
+			uint8_t m_KeepFoldedCopy;
+			uint8_t m_TransposedBlocks;
+			uint8_t m_BlockSummaries;
+			uint32_t m_ShortQueryResultCount;
+			uint32_t m_BigramTableSize;
+
+			uint64_t m_Version;
+			uint64_t m_StringCount;
+			uint64_t m_ByteCount;
+			uint64_t m_RemovedCount;
+			uint64_t m_DeadBytes;
+			uint64_t m_FreeIdCount;
+			uint64_t m_BlockByteCount;
+			uint64_t m_BlockCount;
+			uint64_t m_SummaryCount;
+
+			SectionEntry m_Sections[E_SECTION_COUNT];
+		};
+
+		static constexpr char signature[8] = { 'F', 'Z', 'S', 'I', 'M', 'A', 'G', 'E' };
+		static constexpr uint32_t format_version = 1;
+		static constexpr uint32_t byte_order_mark = 0x01020304;
+		// Every section starts on its own cache line
+		static constexpr uint64_t section_alignment = 64;
+
+		static CorpusImageError Validate(const Header& header, const Corpus::Arrays& arrays);
+	};
+
+	/*
+	 * Follows an image that a producer keeps replacing, for processes that only search.
+	 *
+	 * Refresh attaches the file again once it was replaced and publishes the new corpus, Acquire pins the current one
+	 * the same way as VersionedCorpus::Acquire. A pinned corpus keeps its mapping after the file was replaced or removed.
+	 * Refresh is called from one thread, Acquire from any.
+	*/
+	class CorpusImageReader
+	{
+	public:
+		using Snapshot = std::shared_ptr<const Corpus>;
+
+		explicit CorpusImageReader(std::string path);
+
+		CorpusImageReader(const CorpusImageReader&) = delete;
+		CorpusImageReader& operator=(const CorpusImageReader&) = delete;
+
+		// Attaches the file when it is not the one attached last, out_changed tells if a new corpus was published.
+		// The current corpus stays published when the file cannot be attached.
+		CorpusImageError Refresh(bool* out_changed = nullptr);
+
+		// Current corpus, empty before the first successful Refresh
+		Snapshot Acquire() const;
+		// Version the image was written with
+		uint64_t Version() const { return m_Version.load(std::memory_order_acquire); }
+
+	private:
+		// Tells files apart, a rename replaces the file with a new one
+		struct FileIdentity
+		{
+			uint64_t m_Device = 0;
+			uint64_t m_Inode = 0;
+			uint64_t m_Size = 0;
+			int64_t m_ModifyTime = 0;
+
+			bool operator==(const FileIdentity& other) const;
+		};
+
+		static bool Identify(const std::string& path, FileIdentity& out_identity);
+
+		std::string m_Path;
+		FileIdentity m_Attached;
+		bool m_HasAttached = false;
+
+		// Only accessed with std::atomic_load and std::atomic_store
+		Snapshot m_Published;
+		std::atomic<uint64_t> m_Version{ 0 };
+	};
+
+} // namespace FuzzySearch
+
+#include "FuzzySearchCorpusImage.inl"
@@ -0,0 +1,389 @@
+#include "FuzzySearchCorpusImage.h"
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#if FUZZY_SEARCH_MMAP
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace FuzzySearch
+{
+	inline const char* CorpusImageErrorName(CorpusImageError error)
+	{
+		switch (error)
+		{
+		case CorpusImageError::E_NONE: return "none";
+		case CorpusImageError::E_OPEN_FAILED: return "open failed";
+		case CorpusImageError::E_WRITE_FAILED: return "write failed";
+		case CorpusImageError::E_BAD_SIGNATURE: return "bad signature";
+		case CorpusImageError::E_UNSUPPORTED_VERSION: return "unsupported version";
+		case CorpusImageError::E_TRUNCATED: return "truncated";
+		case CorpusImageError::E_CORRUPT: return "corrupt";
+		}
+		return "unknown";
+	}
+
+	inline uint64_t AlignImageOffset(uint64_t offset, uint64_t alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	inline CorpusImageError CorpusImage::Write(const Corpus& corpus, uint64_t version, const std::string& path)
+	{
+		const Corpus::Arrays arrays = corpus.GetArrays();
+		const CorpusConfig& config = corpus.Config();
+
+		Header header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.m_Signature, signature, sizeof(signature));
+		header.m_FormatVersion = format_version;
+		header.m_HeaderSize = sizeof(Header);
+		header.m_ByteOrderMark = byte_order_mark;
+		header.m_SectionCount = E_SECTION_COUNT;
+
+		header.m_MatchMode = static_cast<uint8_t>(config.m_SearchConfig.m_MatchMode);
+		header.m_MaxUnmatchedCharactersFromPattern = config.m_SearchConfig.m_MaxUnmatchedCharactersFromPattern;
+		header.m_OptimalRescoreCount = config.m_SearchConfig.m_OptimalRescoreCount;
+		header.m_PrecomputeShortQueries = config.m_PrecomputeShortQueries ? 1 : 0;
+		header.m_KeepFoldedCopy = config.m_KeepFoldedCopy ? 1 : 0;
+		header.m_TransposedBlocks = config.m_TransposedBlocks ? 1 : 0;
+		header.m_BlockSummaries = config.m_BlockSummaries ? 1 : 0;
+		header.m_ShortQueryResultCount = config.m_ShortQueryResultCount;
+		header.m_BigramTableSize = config.m_BigramTableSize;
+
+		header.m_Version = version;
+		header.m_StringCount = arrays.m_StringCount;
+		header.m_ByteCount = arrays.m_ByteCount;
+		header.m_RemovedCount = corpus.RemovedCount();
+		header.m_DeadBytes = corpus.DeadBytes();
+		header.m_FreeIdCount = arrays.m_FreeIdCount;
+		header.m_BlockByteCount = arrays.m_BlockByteCount;
+		header.m_BlockCount = arrays.m_BlockCount;
+		header.m_SummaryCount = arrays.m_SummaryCount;
+
+		const size_t string_count = arrays.m_StringCount;
+		std::array<uint64_t, E_SECTION_COUNT> sizes{};
+		std::array<const void*, E_SECTION_COUNT> data{};
+		auto set_section = [&](Section section, const void* section_data, size_t size)
+		{
+			data[section] = section_data;
+			sizes[section] = size;
+		};
+		set_section(E_BYTES, arrays.m_Bytes, arrays.m_ByteCount);
+		set_section(E_FOLDED_BYTES, arrays.m_FoldedBytes, config.m_KeepFoldedCopy ? arrays.m_ByteCount : 0);
+		set_section(E_OFFSETS, arrays.m_Offsets, string_count * sizeof(uint32_t));
+		set_section(E_LENGTHS, arrays.m_Lengths, string_count * sizeof(uint16_t));
+		set_section(E_FILENAME_OFFSETS, arrays.m_FilenameOffsets, string_count * sizeof(uint16_t));
+		set_section(E_REMOVED, arrays.m_Removed, string_count);
+		set_section(E_FREE_IDS, arrays.m_FreeIds, arrays.m_FreeIdCount * sizeof(uint32_t));
+		set_section(E_BLOCK_BYTES, arrays.m_BlockBytes, arrays.m_BlockByteCount);
+		set_section(E_BLOCK_OFFSETS, arrays.m_BlockOffsets, arrays.m_BlockCount * sizeof(uint32_t));
+		set_section(E_BLOCK_ROWS, arrays.m_BlockRows, arrays.m_BlockCount);
+		set_section(E_CHARACTER_MASKS, arrays.m_CharacterMasks, config.m_BlockSummaries ? string_count * sizeof(uint64_t) : 0);
+		set_section(E_BLOCK_SUMMARIES, arrays.m_BlockSummaries, arrays.m_SummaryCount * sizeof(Corpus::BlockSummary));
+
+		uint64_t offset = AlignImageOffset(sizeof(Header), section_alignment);
+		for (uint32_t section = 0; section < E_SECTION_COUNT; ++section)
+		{
+			header.m_Sections[section] = { offset, sizes[section] };
+			offset = AlignImageOffset(offset + sizes[section], section_alignment);
+		}
+
+		// Written next to the image so the rename stays on one file system and replaces it atomically
+#if FUZZY_SEARCH_MMAP
+		const std::string temporary_path = path + ".tmp" + std::to_string(::getpid());
+#else
+		const std::string temporary_path = path + ".tmp";
+#endif
+		std::FILE* file = std::fopen(temporary_path.c_str(), "wb");
+		if (file == nullptr)
+		{
+			return CorpusImageError::E_WRITE_FAILED;
+		}
+
+		static constexpr std::array<char, section_alignment> padding{};
+		bool written = std::fwrite(&header, sizeof(header), 1, file) == 1;
+		uint64_t position = sizeof(header);
+		for (uint32_t section = 0; written && section < E_SECTION_COUNT; ++section)
+		{
+			const SectionEntry& entry = header.m_Sections[section];
+			const size_t padding_size = static_cast<size_t>(entry.m_Offset - position);
+			written = std::fwrite(padding.data(), 1, padding_size, file) == padding_size
+				&& (entry.m_Size == 0 || std::fwrite(data[section], 1, static_cast<size_t>(entry.m_Size), file) == entry.m_Size);
+			position = entry.m_Offset + entry.m_Size;
+		}
+		written = std::fclose(file) == 0 && written;
+
+		std::error_code error;
+		if (written)
+		{
+			std::filesystem::rename(temporary_path, path, error);
+		}
+		if (!written || error)
+		{
+			std::remove(temporary_path.c_str());
+			return CorpusImageError::E_WRITE_FAILED;
+		}
+		return CorpusImageError::E_NONE;
+	}
+
+	inline CorpusImageError CorpusImage::Attach(const std::string& path, Corpus& out_corpus, uint64_t* out_version)
+	{
+		auto file = std::make_shared<MappedFile>();
+		if (!file->Open(path))
+		{
+			return CorpusImageError::E_OPEN_FAILED;
+		}
+
+		const uint8_t* image = file->Data();
+		const uint64_t image_size = file->Size();
+		if (image_size < sizeof(signature) || std::memcmp(image, signature, sizeof(signature)) != 0)
+		{
+			return CorpusImageError::E_BAD_SIGNATURE;
+		}
+
+		// Format version and header size come right after the signature
+		uint32_t version_and_size[2];
+		if (image_size < sizeof(signature) + sizeof(version_and_size))
+		{
+			return CorpusImageError::E_TRUNCATED;
+		}
+		std::memcpy(version_and_size, image + sizeof(signature), sizeof(version_and_size));
+		if (version_and_size[0] != format_version || version_and_size[1] != sizeof(Header))
+		{
+			return CorpusImageError::E_UNSUPPORTED_VERSION;
+		}
+		if (image_size < sizeof(Header))
+		{
+			return CorpusImageError::E_TRUNCATED;
+		}
+
+		Header header;
+		std::memcpy(&header, image, sizeof(header));
+		if (header.m_ByteOrderMark != byte_order_mark || header.m_SectionCount != E_SECTION_COUNT)
+		{
+			return CorpusImageError::E_UNSUPPORTED_VERSION;
+		}
+
+		// Offsets into the strings and ids are 32 bits
+		if (header.m_StringCount > UINT32_MAX || header.m_ByteCount > UINT32_MAX || header.m_FreeIdCount > UINT32_MAX || header.m_BlockCount > UINT32_MAX
+		    || header.m_SummaryCount > UINT32_MAX || header.m_MatchMode > static_cast<uint8_t>(MatchMode::E_SOURCE_FILES))
+		{
+			return CorpusImageError::E_CORRUPT;
+		}
+
+		const uint64_t string_count = header.m_StringCount;
+		std::array<uint64_t, E_SECTION_COUNT> expected_sizes{};
+		expected_sizes[E_BYTES] = header.m_ByteCount;
+		expected_sizes[E_FOLDED_BYTES] = header.m_KeepFoldedCopy != 0 ? header.m_ByteCount : 0;
+		expected_sizes[E_OFFSETS] = string_count * sizeof(uint32_t);
+		expected_sizes[E_LENGTHS] = string_count * sizeof(uint16_t);
+		expected_sizes[E_FILENAME_OFFSETS] = string_count * sizeof(uint16_t);
+		expected_sizes[E_REMOVED] = string_count;
+		expected_sizes[E_FREE_IDS] = header.m_FreeIdCount * sizeof(uint32_t);
+		expected_sizes[E_BLOCK_BYTES] = header.m_BlockByteCount;
+		expected_sizes[E_BLOCK_OFFSETS] = header.m_BlockCount * sizeof(uint32_t);
+		expected_sizes[E_BLOCK_ROWS] = header.m_BlockCount;
+		expected_sizes[E_CHARACTER_MASKS] = header.m_BlockSummaries != 0 ? string_count * sizeof(uint64_t) : 0;
+		expected_sizes[E_BLOCK_SUMMARIES] = header.m_SummaryCount * sizeof(Corpus::BlockSummary);
+
+		std::array<const uint8_t*, E_SECTION_COUNT> sections{};
+		for (uint32_t section = 0; section < E_SECTION_COUNT; ++section)
+		{
+			const SectionEntry& entry = header.m_Sections[section];
+			if (entry.m_Size != expected_sizes[section] || entry.m_Offset % section_alignment != 0)
+			{
+				return CorpusImageError::E_CORRUPT;
+			}
+			if (entry.m_Offset > image_size || entry.m_Size > image_size - entry.m_Offset)
+			{
+				return CorpusImageError::E_TRUNCATED;
+			}
+			sections[section] = image + entry.m_Offset;
+		}
+
+		Corpus::Arrays arrays;
+		arrays.m_Bytes = reinterpret_cast<const char*>(sections[E_BYTES]);
+		arrays.m_FoldedBytes = header.m_KeepFoldedCopy != 0 ? reinterpret_cast<const char*>(sections[E_FOLDED_BYTES]) : nullptr;
+		arrays.m_Offsets = reinterpret_cast<const uint32_t*>(sections[E_OFFSETS]);
+		arrays.m_Lengths = reinterpret_cast<const uint16_t*>(sections[E_LENGTHS]);
+		arrays.m_FilenameOffsets = reinterpret_cast<const uint16_t*>(sections[E_FILENAME_OFFSETS]);
+		arrays.m_Removed = sections[E_REMOVED];
+		arrays.m_FreeIds = reinterpret_cast<const uint32_t*>(sections[E_FREE_IDS]);
+		arrays.m_BlockBytes = sections[E_BLOCK_BYTES];
+		arrays.m_BlockOffsets = reinterpret_cast<const uint32_t*>(sections[E_BLOCK_OFFSETS]);
+		arrays.m_BlockRows = sections[E_BLOCK_ROWS];
+		arrays.m_CharacterMasks = reinterpret_cast<const uint64_t*>(sections[E_CHARACTER_MASKS]);
+		arrays.m_BlockSummaries = reinterpret_cast<const Corpus::BlockSummary*>(sections[E_BLOCK_SUMMARIES]);
+		arrays.m_StringCount = static_cast<size_t>(string_count);
+		arrays.m_ByteCount = static_cast<size_t>(header.m_ByteCount);
+		arrays.m_FreeIdCount = static_cast<size_t>(header.m_FreeIdCount);
+		arrays.m_BlockByteCount = static_cast<size_t>(header.m_BlockByteCount);
+		arrays.m_BlockCount = static_cast<size_t>(header.m_BlockCount);
+		arrays.m_SummaryCount = static_cast<size_t>(header.m_SummaryCount);
+
+		const CorpusImageError error = Validate(header, arrays);
+		if (error != CorpusImageError::E_NONE)
+		{
+			return error;
+		}
+
+		CorpusConfig config;
+		config.m_SearchConfig.m_MatchMode = static_cast<MatchMode>(header.m_MatchMode);
+		config.m_SearchConfig.m_MaxUnmatchedCharactersFromPattern = header.m_MaxUnmatchedCharactersFromPattern;
+		config.m_SearchConfig.m_OptimalRescoreCount = header.m_OptimalRescoreCount;
+		config.m_PrecomputeShortQueries = header.m_PrecomputeShortQueries != 0;
+		config.m_ShortQueryResultCount = header.m_ShortQueryResultCount;
+		config.m_BigramTableSize = header.m_BigramTableSize;
+		config.m_KeepFoldedCopy = header.m_KeepFoldedCopy != 0;
+		config.m_TransposedBlocks = header.m_TransposedBlocks != 0;
+		config.m_BlockSummaries = header.m_BlockSummaries != 0;
+
+		Corpus corpus(config);
+		corpus.m_Image = std::move(file);
+		corpus.m_ImageArrays = arrays;
+		corpus.m_RemovedCount = static_cast<size_t>(header.m_RemovedCount);
+		corpus.m_DeadBytes = static_cast<size_t>(header.m_DeadBytes);
+		out_corpus = std::move(corpus);
+
+		if (out_version != nullptr)
+		{
+			*out_version = header.m_Version;
+		}
+		return CorpusImageError::E_NONE;
+	}
+
+	inline CorpusImageError CorpusImage::Validate(const Header& header, const Corpus::Arrays& arrays)
+	{
+		// Searches index the arrays without bounds checks, every offset in the image has to stay inside it
+		uint64_t removed_count = 0;
+		for (size_t id = 0; id < arrays.m_StringCount; ++id)
+		{
+			if (uint64_t(arrays.m_Offsets[id]) + arrays.m_Lengths[id] > arrays.m_ByteCount || arrays.m_FilenameOffsets[id] > arrays.m_Lengths[id]
+			    || arrays.m_Removed[id] > 1)
+			{
+				return CorpusImageError::E_CORRUPT;
+			}
+			removed_count += arrays.m_Removed[id];
+		}
+		if (removed_count != header.m_RemovedCount || header.m_DeadBytes > arrays.m_ByteCount)
+		{
+			return CorpusImageError::E_CORRUPT;
+		}
+
+		for (size_t index = 0; index < arrays.m_FreeIdCount; ++index)
+		{
+			const uint32_t id = arrays.m_FreeIds[index];
+			if (id >= arrays.m_StringCount || arrays.m_Removed[id] == 0)
+			{
+				return CorpusImageError::E_CORRUPT;
+			}
+		}
+
+		const size_t block_count = header.m_TransposedBlocks != 0 ? (arrays.m_StringCount + block_lanes - 1) / block_lanes : 0;
+		if (arrays.m_BlockCount != block_count)
+		{
+			return CorpusImageError::E_CORRUPT;
+		}
+		for (size_t block = 0; block < arrays.m_BlockCount; ++block)
+		{
+			if (arrays.m_BlockRows[block] > Corpus::max_transposed_rows
+			    || uint64_t(arrays.m_BlockOffsets[block]) + uint64_t(arrays.m_BlockRows[block]) * block_lanes > arrays.m_BlockByteCount)
+			{
+				return CorpusImageError::E_CORRUPT;
+			}
+		}
+
+		const size_t summary_count = header.m_BlockSummaries != 0 ? (arrays.m_StringCount + Corpus::summary_block_size - 1) / Corpus::summary_block_size : 0;
+		if (arrays.m_SummaryCount != summary_count)
+		{
+			return CorpusImageError::E_CORRUPT;
+		}
+		return CorpusImageError::E_NONE;
+	}
+
+	inline bool CorpusImageReader::FileIdentity::operator==(const FileIdentity& other) const
+	{
+		return m_Device == other.m_Device && m_Inode == other.m_Inode && m_Size == other.m_Size && m_ModifyTime == other.m_ModifyTime;
+	}
+
+	inline CorpusImageReader::CorpusImageReader(std::string path)
+		: m_Path(std::move(path))
+	{}
+
+	inline bool CorpusImageReader::Identify(const std::string& path, FileIdentity& out_identity)
+	{
+#if FUZZY_SEARCH_MMAP
+		struct stat file_stat;
+		if (::stat(path.c_str(), &file_stat) != 0)
+		{
+			return false;
+		}
+		out_identity.m_Device = static_cast<uint64_t>(file_stat.st_dev);
+		out_identity.m_Inode = static_cast<uint64_t>(file_stat.st_ino);
+		out_identity.m_Size = static_cast<uint64_t>(file_stat.st_size);
+		out_identity.m_ModifyTime = static_cast<int64_t>(file_stat.st_mtime);
+#else
+		std::error_code error;
+		out_identity.m_Size = std::filesystem::file_size(path, error);
+		if (error)
+		{
+			return false;
+		}
+		out_identity.m_ModifyTime = static_cast<int64_t>(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+		if (error)
+		{
+			return false;
+		}
+#endif
+		return true;
+	}
+
+	inline CorpusImageError CorpusImageReader::Refresh(bool* out_changed)
+	{
+		if (out_changed != nullptr)
+		{
+			*out_changed = false;
+		}
+
+		// Identified before attaching, a file replaced in between is attached again by the next call instead of missed
+		FileIdentity identity;
+		if (!Identify(m_Path, identity))
+		{
+			return CorpusImageError::E_OPEN_FAILED;
+		}
+		if (m_HasAttached && identity == m_Attached)
+		{
+			return CorpusImageError::E_NONE;
+		}
+
+		auto corpus = std::make_shared<Corpus>();
+		uint64_t version = 0;
+		const CorpusImageError error = CorpusImage::Attach(m_Path, *corpus, &version);
+		if (error != CorpusImageError::E_NONE)
+		{
+			return error;
+		}
+
+		m_Attached = identity;
+		m_HasAttached = true;
+		std::atomic_store(&m_Published, Snapshot(std::move(corpus)));
+		m_Version.store(version, std::memory_order_release);
+		if (out_changed != nullptr)
+		{
+			*out_changed = true;
+		}
+		return CorpusImageError::E_NONE;
+	}
+
+	inline CorpusImageReader::Snapshot CorpusImageReader::Acquire() const
+	{
+		return std::atomic_load(&m_Published);
+	}
+
+} // namespace FuzzySearch
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "FuzzySearchThreadPool.h"
+#include "FuzzySearchVersionedCorpus.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace FuzzySearch
+{
+	struct CrawlerConfig
+	{
+		// Threads walking directories including the calling one, 0 uses std::thread::hardware_concurrency
+		size_t m_ThreadCount { 0 };
+		// Directories more than this many levels below a root are not entered, 0 only lists the roots, -1 is unlimited
+		int m_MaxDepth { -1 };
+		// Glob patterns of entries to skip, ignored directories are not entered. Same rules as a .gitignore without negation:
+		// a trailing / only matches directories, a pattern with a / inside is matched against the path relative to the root,
+		// everything else against the entry name. * and ? never match /.
+		std::vector<std::string> m_IgnorePatterns;
+	};
+
+	struct CrawlStats
+	{
+		size_t m_Files = 0;
+		size_t m_Directories = 0;
+		size_t m_Ignored = 0;
+		// Directories that could not be opened or read
+		size_t m_Errors = 0;
+	};
+
+	// Matches str against a glob pattern with *, ? and [...] classes, \ escapes the next character
+	bool MatchGlob(std::string_view pattern, std::string_view str);
+
+	/*
+	 * Walks directory trees in parallel and adds every file below them to a corpus.
+	 *
+	 * Directories are shared through one stack, every thread opens a directory, reads its entries and pushes the
+	 * subdirectories. On Linux the entries are read with getdents64 in large batches and the entry type comes with them,
+	 * no file is ever stat'ed. Other platforms use std::filesystem.
+	 *
+	 * Paths are joined with / onto the root as given. Ignore rules and the depth limit are applied while walking.
+	 * Files reach the corpus in batches from whichever thread found them, so their order is not deterministic.
+	 * Symbolic links are listed as files and never followed.
+	*/
+	class Crawler
+	{
+	public:
+		// Directory to walk, ignore rules and the depth limit are applied relative to the root it lies below
+		struct CrawlDirectory
+		{
+			std::string m_Path;
+			// Length of the root prefix of m_Path including the separator that follows it
+			size_t m_RootLength = 0;
+			// Levels below the root
+			int m_Depth = 0;
+		};
+
+		static CrawlDirectory Root(std::string path);
+
+		explicit Crawler(CrawlerConfig config = {});
+
+		CrawlStats Crawl(const std::vector<std::string>& roots, Corpus& corpus);
+		// Records the files as adds in the batch, for a VersionedCorpus
+		CrawlStats Crawl(const std::vector<std::string>& roots, CorpusBatch& batch);
+
+		// Calls on_file(path) for every file below the directories, the calls are serialized.
+		template<typename OnFile>
+		CrawlStats ForEachFile(const std::vector<CrawlDirectory>& directories, OnFile&& on_file);
+		// Same, and calls on_directory(directory) for every directory right before its entries are read, serialized with
+		// on_file. Anything that changes in the directory after on_directory returned is not missed by a watch added there.
+		template<typename OnFile, typename OnDirectory>
+		CrawlStats ForEachFile(const std::vector<CrawlDirectory>& directories, OnFile&& on_file, OnDirectory&& on_directory);
+
+		// Whether a walk skips the entry, relative_path is the path below the root
+		bool IsIgnored(std::string_view name, std::string_view relative_path, bool is_directory) const;
+
+	private:
+		using AddFunction = void (*)(void* sink, std::string_view path);
+		using EnterFunction = void (*)(void* sink, const CrawlDirectory& directory);
+
+		struct IgnoreRule
+		{
+			std::string m_Pattern;
+			bool m_DirectoryOnly = false;
+			bool m_MatchPath = false;
+		};
+
+		CrawlStats CrawlInto(const std::vector<CrawlDirectory>& directories, void* sink, AddFunction add_function, EnterFunction enter_function);
+		void WalkDirectories(void* sink, AddFunction add_function, EnterFunction enter_function);
+
+		CrawlerConfig m_Config;
+		std::vector<IgnoreRule> m_IgnoreRules;
+		ThreadPool m_ThreadPool;
+
+		// State of the running crawl, shared by the walking threads
+		std::mutex m_Mutex;
+		std::condition_variable m_WorkCondition;
+		std::vector<CrawlDirectory> m_Pending;
+		size_t m_ActiveThreads = 0;
+		CrawlStats m_Stats;
+		std::mutex m_SinkMutex;
+	};
+
+} // namespace FuzzySearch
+
+#include "FuzzySearchCrawler.inl"
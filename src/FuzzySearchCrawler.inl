@@ -0,0 +1,390 @@
+#include "FuzzySearchCrawler.h"
+
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <filesystem>
+#include <system_error>
+#endif
+
+namespace FuzzySearch
+{
+	// Length of the [...] class at pattern[start], 0 when it is not terminated and the [ is a plain character
+	inline size_t MatchGlobClass(std::string_view pattern, size_t start, char c, bool& out_matched)
+	{
+		size_t index = start + 1;
+		const bool negate = index < pattern.length() && (pattern[index] == '!' || pattern[index] == '^');
+		index += negate ? 1 : 0;
+
+		bool matched = false;
+		// A ] right after the opening bracket is part of the class
+		for (bool first = true; index < pattern.length() && (first || pattern[index] != ']'); first = false)
+		{
+			const char low = pattern[index];
+			if (index + 2 < pattern.length() && pattern[index + 1] == '-' && pattern[index + 2] != ']')
+			{
+				matched = matched || (c >= low && c <= pattern[index + 2]);
+				index += 3;
+			}
+			else
+			{
+				matched = matched || c == low;
+				++index;
+			}
+		}
+
+		if (index >= pattern.length())
+		{
+			return 0;
+		}
+
+		out_matched = matched != negate && c != '/';
+		return index + 1 - start;
+	}
+
+	inline bool MatchGlob(std::string_view pattern, std::string_view str)
+	{
+		size_t pattern_index = 0;
+		size_t str_index = 0;
+		// Where the last * was and how much of str it covers, a mismatch retries with the * covering one more character
+		size_t star_pattern_index = std::string_view::npos;
+		size_t star_str_index = 0;
+
+		while (str_index < str.length())
+		{
+			if (pattern_index < pattern.length())
+			{
+				const char pattern_char = pattern[pattern_index];
+				const char str_char = str[str_index];
+				if (pattern_char == '*')
+				{
+					star_pattern_index = ++pattern_index;
+					star_str_index = str_index;
+					continue;
+				}
+
+				bool matched = false;
+				size_t pattern_step = 1;
+				if (pattern_char == '?')
+				{
+					matched = str_char != '/';
+				}
+				else if (pattern_char == '[')
+				{
+					pattern_step = MatchGlobClass(pattern, pattern_index, str_char, matched);
+					if (pattern_step == 0)
+					{
+						matched = str_char == '[';
+						pattern_step = 1;
+					}
+				}
+				else if (pattern_char == '\\' && pattern_index + 1 < pattern.length())
+				{
+					matched = str_char == pattern[pattern_index + 1];
+					pattern_step = 2;
+				}
+				else
+				{
+					matched = str_char == pattern_char;
+				}
+
+				if (matched)
+				{
+					pattern_index += pattern_step;
+					++str_index;
+					continue;
+				}
+			}
+
+			if (star_pattern_index == std::string_view::npos || str[star_str_index] == '/')
+			{
+				return false;
+			}
+			pattern_index = star_pattern_index;
+			str_index = ++star_str_index;
+		}
+
+		while (pattern_index < pattern.length() && pattern[pattern_index] == '*')
+		{
+			++pattern_index;
+		}
+		return pattern_index == pattern.length();
+	}
+
+	// Calls on_entry(name, is_directory) for every entry of the directory except . and .., false if it cannot be read
+	template<typename OnEntry>
+	bool ReadDirectory(const std::string& path, OnEntry&& on_entry)
+	{
+#if defined(__linux__)
+		const int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			return false;
+		}
+
+		bool success = true;
+		alignas(alignof(dirent64)) char buffer[32 * 1024];
+		for (;;)
+		{
+			const long read_size = ::syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+			if (read_size <= 0)
+			{
+				success = read_size == 0;
+				break;
+			}
+
+			for (long position = 0; position < read_size;)
+			{
+				const dirent64* entry = reinterpret_cast<const dirent64*>(buffer + position);
+				position += entry->d_reclen;
+
+				const char* name = entry->d_name;
+				if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))
+				{
+					continue;
+				}
+
+				bool is_directory = entry->d_type == DT_DIR;
+				if (entry->d_type == DT_UNKNOWN)
+				{
+					// Some file systems do not fill in the type
+					struct stat entry_stat;
+					is_directory = ::fstatat(fd, name, &entry_stat, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(entry_stat.st_mode);
+				}
+				on_entry(std::string_view(name), is_directory);
+			}
+		}
+
+		::close(fd);
+		return success;
+#else
+		std::error_code error;
+		std::filesystem::directory_iterator iterator(path, error);
+		for (; !error && iterator != std::filesystem::directory_iterator(); iterator.increment(error))
+		{
+			const std::string name = iterator->path().filename().string();
+			on_entry(std::string_view(name), iterator->is_directory(error) && !iterator->is_symlink(error));
+		}
+		return !error;
+#endif
+	}
+
+	inline Crawler::CrawlDirectory Crawler::Root(std::string path)
+	{
+		while (path.length() > 1 && path.back() == '/')
+		{
+			path.pop_back();
+		}
+		const size_t root_length = path.length() + (path == "/" ? 0 : 1);
+		return { std::move(path), root_length, 0 };
+	}
+
+	inline Crawler::Crawler(CrawlerConfig config)
+		: m_Config(std::move(config))
+		, m_ThreadPool(m_Config.m_ThreadCount)
+	{
+		for (std::string pattern : m_Config.m_IgnorePatterns)
+		{
+			IgnoreRule rule;
+			if (!pattern.empty() && pattern.back() == '/')
+			{
+				rule.m_DirectoryOnly = true;
+				pattern.pop_back();
+			}
+			if (!pattern.empty() && pattern.front() == '/')
+			{
+				rule.m_MatchPath = true;
+				pattern.erase(0, 1);
+			}
+			rule.m_MatchPath = rule.m_MatchPath || pattern.find('/') != std::string::npos;
+			rule.m_Pattern = std::move(pattern);
+			if (!rule.m_Pattern.empty())
+			{
+				m_IgnoreRules.push_back(std::move(rule));
+			}
+		}
+	}
+
+	inline bool Crawler::IsIgnored(std::string_view name, std::string_view relative_path, bool is_directory) const
+	{
+		for (const IgnoreRule& rule : m_IgnoreRules)
+		{
+			if (rule.m_DirectoryOnly && !is_directory)
+			{
+				continue;
+			}
+			if (MatchGlob(rule.m_Pattern, rule.m_MatchPath ? relative_path : name))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	inline CrawlStats Crawler::Crawl(const std::vector<std::string>& roots, Corpus& corpus)
+	{
+		std::vector<CrawlDirectory> directories;
+		for (const std::string& root : roots)
+		{
+			directories.push_back(Root(root));
+		}
+		return ForEachFile(directories, [&corpus](std::string_view path) { corpus.Add(path); });
+	}
+
+	inline CrawlStats Crawler::Crawl(const std::vector<std::string>& roots, CorpusBatch& batch)
+	{
+		std::vector<CrawlDirectory> directories;
+		for (const std::string& root : roots)
+		{
+			directories.push_back(Root(root));
+		}
+		return ForEachFile(directories, [&batch](std::string_view path) { batch.Add(path); });
+	}
+
+	template<typename OnFile>
+	CrawlStats Crawler::ForEachFile(const std::vector<CrawlDirectory>& directories, OnFile&& on_file)
+	{
+		using OnFileType = std::remove_reference_t<OnFile>;
+		return CrawlInto(directories, &on_file, [](void* sink, std::string_view path) { (*static_cast<OnFileType*>(sink))(path); }, nullptr);
+	}
+
+	template<typename OnFile, typename OnDirectory>
+	CrawlStats Crawler::ForEachFile(const std::vector<CrawlDirectory>& directories, OnFile&& on_file, OnDirectory&& on_directory)
+	{
+		struct Callbacks
+		{
+			std::remove_reference_t<OnFile>* m_OnFile;
+			std::remove_reference_t<OnDirectory>* m_OnDirectory;
+		};
+		Callbacks callbacks = { &on_file, &on_directory };
+		return CrawlInto(directories, &callbacks,
+			[](void* sink, std::string_view path) { (*static_cast<Callbacks*>(sink)->m_OnFile)(path); },
+			[](void* sink, const CrawlDirectory& directory) { (*static_cast<Callbacks*>(sink)->m_OnDirectory)(directory); });
+	}
+
+	inline CrawlStats Crawler::CrawlInto(const std::vector<CrawlDirectory>& directories, void* sink, AddFunction add_function, EnterFunction enter_function)
+	{
+		m_Stats = {};
+		m_Pending = directories;
+		m_ActiveThreads = 0;
+
+		const size_t thread_count = m_ThreadPool.ThreadCount();
+		m_ThreadPool.Run(thread_count, [this, sink, add_function, enter_function](size_t /*task_index*/, size_t /*thread_index*/)
+		{
+			WalkDirectories(sink, add_function, enter_function);
+		});
+
+		return m_Stats;
+	}
+
+	inline void Crawler::WalkDirectories(void* sink, AddFunction add_function, EnterFunction enter_function)
+	{
+		// Paths found by this thread, handed to the sink in batches so the sink lock is rarely taken
+		constexpr size_t flush_bytes = 64 * 1024;
+		std::string file_paths;
+		std::vector<size_t> file_path_ends;
+		auto flush_files = [&]()
+		{
+			std::lock_guard<std::mutex> lock(m_SinkMutex);
+			size_t start = 0;
+			for (size_t end : file_path_ends)
+			{
+				add_function(sink, std::string_view(file_paths.data() + start, end - start));
+				start = end;
+			}
+			file_paths.clear();
+			file_path_ends.clear();
+		};
+
+		CrawlStats stats;
+		std::vector<CrawlDirectory> subdirectories;
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		for (;;)
+		{
+			m_WorkCondition.wait(lock, [this]() { return !m_Pending.empty() || m_ActiveThreads == 0; });
+			if (m_Pending.empty())
+			{
+				break;
+			}
+
+			CrawlDirectory directory = std::move(m_Pending.back());
+			m_Pending.pop_back();
+			++m_ActiveThreads;
+			lock.unlock();
+
+			const bool descend = m_Config.m_MaxDepth < 0 || directory.m_Depth < m_Config.m_MaxDepth;
+			std::string path = directory.m_Path;
+			if (path.empty() || path.back() != '/')
+			{
+				path += '/';
+			}
+			const size_t name_start = path.length();
+
+			if (enter_function != nullptr)
+			{
+				std::lock_guard<std::mutex> sink_lock(m_SinkMutex);
+				enter_function(sink, directory);
+			}
+
+			const bool success = ReadDirectory(directory.m_Path, [&](std::string_view name, bool is_directory)
+			{
+				path.resize(name_start);
+				path.append(name);
+				if (IsIgnored(name, std::string_view(path).substr(directory.m_RootLength), is_directory))
+				{
+					++stats.m_Ignored;
+				}
+				else if (is_directory)
+				{
+					if (descend)
+					{
+						subdirectories.push_back({ path, directory.m_RootLength, directory.m_Depth + 1 });
+					}
+				}
+				else
+				{
+					file_paths.append(path);
+					file_path_ends.push_back(file_paths.length());
+					++stats.m_Files;
+				}
+			});
+			++stats.m_Directories;
+			stats.m_Errors += success ? 0 : 1;
+
+			if (file_paths.length() >= flush_bytes)
+			{
+				flush_files();
+			}
+
+			lock.lock();
+			--m_ActiveThreads;
+			const bool wake = !subdirectories.empty() || m_ActiveThreads == 0;
+			for (CrawlDirectory& subdirectory : subdirectories)
+			{
+				m_Pending.push_back(std::move(subdirectory));
+			}
+			subdirectories.clear();
+			if (wake)
+			{
+				m_WorkCondition.notify_all();
+			}
+		}
+
+		m_Stats.m_Files += stats.m_Files;
+		m_Stats.m_Directories += stats.m_Directories;
+		m_Stats.m_Ignored += stats.m_Ignored;
+		m_Stats.m_Errors += stats.m_Errors;
+		lock.unlock();
+
+		flush_files();
+	}
+
+} // namespace FuzzySearch
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "FuzzySearchMappedFile.h"
+#include "FuzzySearchVersionedCorpus.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace FuzzySearch
+{
+	enum class GitIndexError : uint8_t
+	{
+		E_NONE,
+		E_OPEN_FAILED,
+		E_BAD_SIGNATURE,
+		E_UNSUPPORTED_VERSION,
+		E_TRUNCATED,
+		E_CORRUPT
+	};
+
+	const char* GitIndexErrorName(GitIndexError error);
+
+	struct GitIndexConfig
+	{
+		// Prepended to every path, e.g. the work tree directory with a trailing /
+		std::string m_PathPrefix;
+		// Bytes per object id, 32 for repositories using SHA-256
+		size_t m_HashSize { 20 };
+	};
+
+	/*
+	 * Reads the tracked files of a git repository straight from .git/index, no git binary or directory walk needed.
+	 *
+	 * Index versions 2 to 4 are supported, version 4 strips the common prefix of consecutive paths and is expanded here.
+	 * Paths come out in index order, which is sorted. Merge conflicts list a path once and sparse directory entries are
+	 * skipped. Extensions after the entries and the trailing checksum are not read.
+	*/
+
+	// Calls on_path(path) for every file in an index held in memory
+	template<typename OnPath>
+	GitIndexError ForEachGitIndexPath(const uint8_t* data, size_t size, size_t hash_size, OnPath&& on_path);
+
+	// Maps the index file and adds every file in it
+	GitIndexError ReadGitIndex(const std::string& index_path, const GitIndexConfig& config, Corpus& corpus);
+	GitIndexError ReadGitIndex(const std::string& index_path, const GitIndexConfig& config, CorpusBatch& batch);
+
+} // namespace FuzzySearch
+
+#include "FuzzySearchGitIndex.inl"
@@ -0,0 +1,211 @@
+#include "FuzzySearchGitIndex.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace FuzzySearch
+{
+	inline const char* GitIndexErrorName(GitIndexError error)
+	{
+		switch (error)
+		{
+		case GitIndexError::E_NONE: return "none";
+		case GitIndexError::E_OPEN_FAILED: return "open failed";
+		case GitIndexError::E_BAD_SIGNATURE: return "bad signature";
+		case GitIndexError::E_UNSUPPORTED_VERSION: return "unsupported version";
+		case GitIndexError::E_TRUNCATED: return "truncated";
+		case GitIndexError::E_CORRUPT: return "corrupt";
+		}
+		return "unknown";
+	}
+
+	inline uint32_t ReadBigEndian32(const uint8_t* data)
+	{
+		return static_cast<uint32_t>(data[0]) << 24 | static_cast<uint32_t>(data[1]) << 16 | static_cast<uint32_t>(data[2]) << 8 | data[3];
+	}
+
+	inline uint16_t ReadBigEndian16(const uint8_t* data)
+	{
+		return static_cast<uint16_t>(data[0] << 8 | data[1]);
+	}
+
+	// Git's offset varint, every continuation adds one before shifting so each value has exactly one encoding
+	inline bool ReadGitVarint(const uint8_t* data, size_t size, size_t& position, uint64_t& out_value)
+	{
+		if (position >= size)
+		{
+			return false;
+		}
+
+		uint8_t byte = data[position++];
+		uint64_t value = byte & 0x7F;
+		while ((byte & 0x80) != 0)
+		{
+			if (position >= size || value > (~uint64_t(0) >> 8))
+			{
+				return false;
+			}
+			byte = data[position++];
+			value = ((value + 1) << 7) | (byte & 0x7F);
+		}
+		out_value = value;
+		return true;
+	}
+
+	template<typename OnPath>
+	GitIndexError ForEachGitIndexPath(const uint8_t* data, size_t size, size_t hash_size, OnPath&& on_path)
+	{
+		// Header is the signature, the version and the entry count
+		constexpr size_t header_size = 12;
+		// ctime, mtime, dev, ino, mode, uid, gid and size, then the object id and 16 bits of flags
+		constexpr size_t stat_size = 40;
+		constexpr size_t mode_offset = 24;
+		constexpr uint16_t extended_flag = 0x4000;
+		constexpr uint32_t mode_type_mask = 0170000;
+		constexpr uint32_t mode_directory = 0040000;
+
+		if (size < header_size)
+		{
+			return GitIndexError::E_TRUNCATED;
+		}
+		if (std::memcmp(data, "DIRC", 4) != 0)
+		{
+			return GitIndexError::E_BAD_SIGNATURE;
+		}
+
+		const uint32_t version = ReadBigEndian32(data + 4);
+		if (version < 2 || version > 4)
+		{
+			return GitIndexError::E_UNSUPPORTED_VERSION;
+		}
+
+		const uint32_t entry_count = ReadBigEndian32(data + 8);
+		const size_t fixed_size = stat_size + hash_size + 2;
+
+		std::string path;
+		std::string conflict_path;
+		size_t position = header_size;
+		for (uint32_t entry = 0; entry < entry_count; ++entry)
+		{
+			const size_t entry_start = position;
+			if (size - position < fixed_size)
+			{
+				return GitIndexError::E_TRUNCATED;
+			}
+
+			const uint32_t mode = ReadBigEndian32(data + position + mode_offset);
+			const uint16_t flags = ReadBigEndian16(data + position + stat_size + hash_size);
+			position += fixed_size;
+
+			if ((flags & extended_flag) != 0)
+			{
+				if (version < 3)
+				{
+					return GitIndexError::E_CORRUPT;
+				}
+				if (size - position < 2)
+				{
+					return GitIndexError::E_TRUNCATED;
+				}
+				position += 2;
+			}
+
+			if (version == 4)
+			{
+				// Number of bytes to drop from the end of the previous path, then the rest of this one
+				uint64_t strip_length = 0;
+				if (!ReadGitVarint(data, size, position, strip_length))
+				{
+					return GitIndexError::E_TRUNCATED;
+				}
+				if (strip_length > path.length())
+				{
+					return GitIndexError::E_CORRUPT;
+				}
+				path.resize(path.length() - static_cast<size_t>(strip_length));
+			}
+			else
+			{
+				path.clear();
+			}
+
+			const void* name_end = std::memchr(data + position, 0, size - position);
+			if (name_end == nullptr)
+			{
+				return GitIndexError::E_TRUNCATED;
+			}
+			const size_t name_length = static_cast<const uint8_t*>(name_end) - (data + position);
+			path.append(reinterpret_cast<const char*>(data + position), name_length);
+			position += name_length + 1;
+
+			if (version < 4)
+			{
+				// Entries are padded with 1 to 8 NULs to a multiple of 8 bytes
+				const size_t entry_length = (position - 1 - entry_start + 8) & ~size_t(7);
+				if (entry_length > size - entry_start)
+				{
+					return GitIndexError::E_TRUNCATED;
+				}
+				position = entry_start + entry_length;
+			}
+
+			if ((mode & mode_type_mask) == mode_directory)
+			{
+				continue;
+			}
+
+			// Conflicted paths have one entry per stage next to each other
+			const int stage = (flags >> 12) & 3;
+			if (stage != 0)
+			{
+				if (path == conflict_path)
+				{
+					continue;
+				}
+				conflict_path = path;
+			}
+
+			on_path(std::string_view(path));
+		}
+
+		return GitIndexError::E_NONE;
+	}
+
+	template<typename OnReserve, typename OnPath>
+	GitIndexError ReadGitIndexFile(const std::string& index_path, const GitIndexConfig& config, OnReserve&& on_reserve, OnPath&& on_path)
+	{
+		MappedFile file;
+		if (!file.Open(index_path))
+		{
+			return GitIndexError::E_OPEN_FAILED;
+		}
+
+		// The header knows the entry count, the file size bounds the path bytes unless version 4 compressed them
+		if (file.Size() >= 12)
+		{
+			const size_t entry_count = ReadBigEndian32(file.Data() + 8);
+			on_reserve(std::min<size_t>(entry_count, file.Size() / 8), file.Size() + entry_count * config.m_PathPrefix.length());
+		}
+
+		std::string prefixed_path = config.m_PathPrefix;
+		return ForEachGitIndexPath(file.Data(), file.Size(), config.m_HashSize, [&](std::string_view path)
+		{
+			prefixed_path.resize(config.m_PathPrefix.length());
+			prefixed_path.append(path);
+			on_path(std::string_view(prefixed_path));
+		});
+	}
+
+	inline GitIndexError ReadGitIndex(const std::string& index_path, const GitIndexConfig& config, Corpus& corpus)
+	{
+		return ReadGitIndexFile(index_path, config,
+			[&corpus](size_t string_count, size_t byte_count) { corpus.Reserve(corpus.Size() + string_count, corpus.ByteSize() + byte_count); },
+			[&corpus](std::string_view path) { corpus.Add(path); });
+	}
+
+	inline GitIndexError ReadGitIndex(const std::string& index_path, const GitIndexConfig& config, CorpusBatch& batch)
+	{
+		return ReadGitIndexFile(index_path, config, [](size_t, size_t) {}, [&batch](std::string_view path) { batch.Add(path); });
+	}
+
+} // namespace FuzzySearch
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FUZZY_SEARCH_X86 1
+#else
+#define FUZZY_SEARCH_X86 0
+#endif
+
+namespace FuzzySearch
+{
+	// Instruction sets the matching kernels are built for, later entries need everything before them
+	enum class Isa : uint8_t
+	{
+		E_SCALAR,
+		E_SSE2,
+		E_AVX2,
+		E_AVX512
+	};
+
+	/*
+	 * Kernels are picked at runtime so one generic build runs at full speed on every host.
+	 *
+	 * The best instruction set the CPU supports is detected on first use. Setting the FUZZY_SEARCH_ISA environment
+	 * variable to scalar, sse2, avx2 or avx512 caps it, the tests use that to cover every kernel.
+	*/
+	Isa DetectIsa();
+	Isa ActiveIsa();
+	// Returns false and keeps the current kernels when the CPU does not support isa
+	bool SetIsa(Isa isa);
+
+	const char* IsaName(Isa isa);
+	bool ParseIsa(const char* name, Isa& out_isa);
+
+	// Index of the first character at or after start_index with (str[index] | 0x20) == lower_char, length if there is none.
+	// Same folding as FuzzySearchStringRef::ToLower.
+	int FindLowerByte(const char* str, int length, int start_index, int lower_char);
+
+	// Lanes of a transposed block, row r holds byte r of 16 strings
+	constexpr int block_lanes = 16;
+
+	/*
+	 * Folded pattern characters grouped into 8 buckets for BlockPresence.
+	 *
+	 * m_Buckets has the bucket bits of every byte value. The nibble tables are the same sets split by low and high nibble,
+	 * a byte is in a bucket when both of its nibbles are. That is exact with one character per bucket and a superset
+	 * when characters share a bucket.
+	*/
+	struct CharacterBuckets
+	{
+		std::array<uint8_t, 256> m_Buckets{};
+		std::array<uint8_t, 16> m_LowNibbles{};
+		std::array<uint8_t, 16> m_HighNibbles{};
+
+		void Add(uint8_t folded_char, int bucket);
+	};
+
+	// ORs the buckets of every byte in rows[0, row_count * block_lanes) into out_presence, one byte per lane.
+	// Can report buckets that are not there but never misses one that is.
+	void BlockPresence(const uint8_t* rows, int row_count, const CharacterBuckets& buckets, uint8_t* out_presence);
+
+} // namespace FuzzySearch
+
+#include "FuzzySearchKernels.inl"
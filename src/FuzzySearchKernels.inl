@@ -0,0 +1,343 @@
+#include "FuzzySearchKernels.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if FUZZY_SEARCH_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#endif
+
+#if FUZZY_SEARCH_X86 && !defined(_MSC_VER)
+#define FUZZY_SEARCH_TARGET(isa) __attribute__((target(isa)))
+#else
+// MSVC compiles intrinsics of every instruction set without extra flags
+#define FUZZY_SEARCH_TARGET(isa)
+#endif
+
+namespace FuzzySearch
+{
+	using FindLowerByteFunction = int (*)(const char* str, int length, int start_index, int lower_char);
+	using BlockPresenceFunction = void (*)(const uint8_t* rows, int row_count, const CharacterBuckets& buckets, uint8_t* out_presence);
+
+	struct KernelTable
+	{
+		Isa m_Isa;
+		FindLowerByteFunction m_FindLowerByte;
+		BlockPresenceFunction m_BlockPresence;
+	};
+
+	inline void CharacterBuckets::Add(uint8_t folded_char, int bucket)
+	{
+		const uint8_t bit = static_cast<uint8_t>(1 << bucket);
+		m_Buckets[folded_char] |= bit;
+		m_LowNibbles[folded_char & 0x0F] |= bit;
+		m_HighNibbles[folded_char >> 4] |= bit;
+	}
+
+	inline void BlockPresenceScalar(const uint8_t* rows, int row_count, const CharacterBuckets& buckets, uint8_t* out_presence)
+	{
+		for (int row = 0; row < row_count; ++row)
+		{
+			for (int lane = 0; lane < block_lanes; ++lane)
+			{
+				out_presence[lane] |= buckets.m_Buckets[rows[row * block_lanes + lane]];
+			}
+		}
+	}
+
+	inline int FindLowerByteScalar(const char* str, int length, int start_index, int lower_char)
+	{
+		const char folded_char = static_cast<char>(lower_char);
+		while (start_index < length && (str[start_index] | 0x20) != folded_char)
+		{
+			++start_index;
+		}
+		return start_index;
+	}
+
+#if FUZZY_SEARCH_X86
+	FUZZY_SEARCH_TARGET("sse2")
+	inline int FindLowerByteSse2(const char* str, int length, int start_index, int lower_char)
+	{
+		const __m128i fold = _mm_set1_epi8(0x20);
+		const __m128i needle = _mm_set1_epi8(static_cast<char>(lower_char));
+		for (; start_index + 16 <= length; start_index += 16)
+		{
+			const __m128i bytes = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(str + start_index)), fold);
+			const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, needle));
+			if (mask != 0)
+			{
+#if defined(_MSC_VER)
+				unsigned long bit = 0;
+				_BitScanForward(&bit, static_cast<unsigned long>(mask));
+				return start_index + static_cast<int>(bit);
+#else
+				return start_index + __builtin_ctz(static_cast<unsigned int>(mask));
+#endif
+			}
+		}
+		return FindLowerByteScalar(str, length, start_index, lower_char);
+	}
+
+	FUZZY_SEARCH_TARGET("avx2")
+	inline int FindLowerByteAvx2(const char* str, int length, int start_index, int lower_char)
+	{
+		const __m256i fold = _mm256_set1_epi8(0x20);
+		const __m256i needle = _mm256_set1_epi8(static_cast<char>(lower_char));
+		for (; start_index + 32 <= length; start_index += 32)
+		{
+			const __m256i bytes = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + start_index)), fold);
+			const unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, needle)));
+			if (mask != 0)
+			{
+#if defined(_MSC_VER)
+				unsigned long bit = 0;
+				_BitScanForward(&bit, mask);
+				return start_index + static_cast<int>(bit);
+#else
+				return start_index + __builtin_ctz(mask);
+#endif
+			}
+		}
+		return FindLowerByteSse2(str, length, start_index, lower_char);
+	}
+
+	// SSE2 has no byte shuffle, the SSE2 kernels use BlockPresenceScalar
+	FUZZY_SEARCH_TARGET("avx2")
+	inline void BlockPresenceAvx2(const uint8_t* rows, int row_count, const CharacterBuckets& buckets, uint8_t* out_presence)
+	{
+		const __m128i low_nibbles = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buckets.m_LowNibbles.data()));
+		const __m128i high_nibbles = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buckets.m_HighNibbles.data()));
+		const __m128i nibble_mask = _mm_set1_epi8(0x0F);
+
+		__m128i presence = _mm_loadu_si128(reinterpret_cast<const __m128i*>(out_presence));
+		for (int row = 0; row < row_count; ++row)
+		{
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows + row * block_lanes));
+			const __m128i low = _mm_shuffle_epi8(low_nibbles, _mm_and_si128(bytes, nibble_mask));
+			const __m128i high = _mm_shuffle_epi8(high_nibbles, _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble_mask));
+			presence = _mm_or_si128(presence, _mm_and_si128(low, high));
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out_presence), presence);
+	}
+
+	FUZZY_SEARCH_TARGET("avx512f,avx512bw")
+	inline int FindLowerByteAvx512(const char* str, int length, int start_index, int lower_char)
+	{
+		const __m512i fold = _mm512_set1_epi8(0x20);
+		const __m512i needle = _mm512_set1_epi8(static_cast<char>(lower_char));
+		while (start_index < length)
+		{
+			// Masked loads never touch bytes past the end, so the tail needs no scalar loop
+			const int remaining = length - start_index;
+			const __mmask64 load_mask = remaining >= 64 ? ~__mmask64(0) : (__mmask64(1) << remaining) - 1;
+			const __m512i bytes = _mm512_or_si512(_mm512_maskz_loadu_epi8(load_mask, str + start_index), fold);
+			const uint64_t mask = _mm512_mask_cmpeq_epi8_mask(load_mask, bytes, needle);
+			if (mask != 0)
+			{
+#if defined(_MSC_VER)
+				unsigned long bit = 0;
+				_BitScanForward64(&bit, mask);
+				return start_index + static_cast<int>(bit);
+#else
+				return start_index + __builtin_ctzll(mask);
+#endif
+			}
+			start_index += 64;
+		}
+		return length;
+	}
+
+	FUZZY_SEARCH_TARGET("avx512f,avx512bw")
+	inline void BlockPresenceAvx512(const uint8_t* rows, int row_count, const CharacterBuckets& buckets, uint8_t* out_presence)
+	{
+		// Four rows per vector, the lanes of the four quarters are folded together at the end
+		alignas(64) uint8_t tables[2][4 * block_lanes];
+		for (int quarter = 0; quarter < 4; ++quarter)
+		{
+			std::memcpy(tables[0] + quarter * block_lanes, buckets.m_LowNibbles.data(), block_lanes);
+			std::memcpy(tables[1] + quarter * block_lanes, buckets.m_HighNibbles.data(), block_lanes);
+		}
+		const __m512i low_nibbles = _mm512_load_si512(tables[0]);
+		const __m512i high_nibbles = _mm512_load_si512(tables[1]);
+		const __m512i nibble_mask = _mm512_set1_epi8(0x0F);
+
+		__m512i presence = _mm512_setzero_si512();
+		int row = 0;
+		for (; row + 4 <= row_count; row += 4)
+		{
+			const __m512i bytes = _mm512_loadu_si512(rows + row * block_lanes);
+			const __m512i low = _mm512_shuffle_epi8(low_nibbles, _mm512_and_si512(bytes, nibble_mask));
+			const __m512i high = _mm512_shuffle_epi8(high_nibbles, _mm512_and_si512(_mm512_srli_epi16(bytes, 4), nibble_mask));
+			presence = _mm512_or_si512(presence, _mm512_and_si512(low, high));
+		}
+
+		alignas(64) uint8_t quarters[4 * block_lanes];
+		_mm512_store_si512(quarters, presence);
+		for (int quarter = 0; quarter < 4; ++quarter)
+		{
+			for (int lane = 0; lane < block_lanes; ++lane)
+			{
+				out_presence[lane] |= quarters[quarter * block_lanes + lane];
+			}
+		}
+
+		BlockPresenceAvx2(rows + row * block_lanes, row_count - row, buckets, out_presence);
+	}
+#endif
+
+	inline const KernelTable& GetKernelTable(Isa isa)
+	{
+		static const KernelTable scalar_kernels = { Isa::E_SCALAR, &FindLowerByteScalar, &BlockPresenceScalar };
+#if FUZZY_SEARCH_X86
+		static const KernelTable sse2_kernels = { Isa::E_SSE2, &FindLowerByteSse2, &BlockPresenceScalar };
+		static const KernelTable avx2_kernels = { Isa::E_AVX2, &FindLowerByteAvx2, &BlockPresenceAvx2 };
+		static const KernelTable avx512_kernels = { Isa::E_AVX512, &FindLowerByteAvx512, &BlockPresenceAvx512 };
+
+		switch (isa)
+		{
+			case Isa::E_SCALAR: return scalar_kernels;
+			case Isa::E_SSE2: return sse2_kernels;
+			case Isa::E_AVX2: return avx2_kernels;
+			case Isa::E_AVX512: return avx512_kernels;
+		}
+#else
+		(void)isa;
+#endif
+		return scalar_kernels;
+	}
+
+	inline Isa DetectIsa()
+	{
+#if FUZZY_SEARCH_X86 && defined(_MSC_VER)
+		int registers[4] = {};
+		__cpuid(registers, 0);
+		const int max_leaf = registers[0];
+
+		__cpuid(registers, 1);
+		const bool sse2 = (registers[3] & (1 << 26)) != 0;
+		const bool osxsave = (registers[2] & (1 << 27)) != 0;
+		const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+		const bool os_avx = (xcr0 & 0x6) == 0x6;
+		const bool os_avx512 = (xcr0 & 0xE6) == 0xE6;
+
+		bool avx2 = false;
+		bool avx512 = false;
+		if (max_leaf >= 7)
+		{
+			__cpuidex(registers, 7, 0);
+			avx2 = os_avx && (registers[1] & (1 << 5)) != 0;
+			avx512 = os_avx512 && (registers[1] & (1 << 16)) != 0 && (registers[1] & (1 << 30)) != 0;
+		}
+#elif FUZZY_SEARCH_X86
+		__builtin_cpu_init();
+		const bool sse2 = __builtin_cpu_supports("sse2");
+		const bool avx2 = __builtin_cpu_supports("avx2");
+		const bool avx512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#else
+		const bool sse2 = false;
+		const bool avx2 = false;
+		const bool avx512 = false;
+#endif
+
+		if (avx512)
+		{
+			return Isa::E_AVX512;
+		}
+		if (avx2)
+		{
+			return Isa::E_AVX2;
+		}
+		return sse2 ? Isa::E_SSE2 : Isa::E_SCALAR;
+	}
+
+	inline const char* IsaName(Isa isa)
+	{
+		switch (isa)
+		{
+			case Isa::E_SCALAR: return "scalar";
+			case Isa::E_SSE2: return "sse2";
+			case Isa::E_AVX2: return "avx2";
+			case Isa::E_AVX512: return "avx512";
+		}
+		return "unknown";
+	}
+
+	inline bool ParseIsa(const char* name, Isa& out_isa)
+	{
+		for (Isa isa : { Isa::E_SCALAR, Isa::E_SSE2, Isa::E_AVX2, Isa::E_AVX512 })
+		{
+			if (std::strcmp(name, IsaName(isa)) == 0)
+			{
+				out_isa = isa;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	inline Isa InitialIsa()
+	{
+		Isa isa = DetectIsa();
+
+#if defined(_MSC_VER)
+		char* value = nullptr;
+		size_t value_length = 0;
+		std::string forced_isa;
+		if (_dupenv_s(&value, &value_length, "FUZZY_SEARCH_ISA") == 0 && value != nullptr)
+		{
+			forced_isa = value;
+			std::free(value);
+		}
+#else
+		const char* value = std::getenv("FUZZY_SEARCH_ISA");
+		const std::string forced_isa = value != nullptr ? value : "";
+#endif
+
+		// Only ever lowers the instruction set, an override can not enable kernels the CPU would fault on
+		Isa parsed_isa = Isa::E_SCALAR;
+		if (ParseIsa(forced_isa.c_str(), parsed_isa) && parsed_isa < isa)
+		{
+			isa = parsed_isa;
+		}
+		return isa;
+	}
+
+	inline std::atomic<const KernelTable*>& ActiveKernelTable()
+	{
+		static std::atomic<const KernelTable*> kernel_table{ &GetKernelTable(InitialIsa()) };
+		return kernel_table;
+	}
+
+	inline Isa ActiveIsa()
+	{
+		return ActiveKernelTable().load(std::memory_order_relaxed)->m_Isa;
+	}
+
+	inline bool SetIsa(Isa isa)
+	{
+		if (isa > DetectIsa())
+		{
+			return false;
+		}
+
+		ActiveKernelTable().store(&GetKernelTable(isa), std::memory_order_relaxed);
+		return true;
+	}
+
+	inline int FindLowerByte(const char* str, int length, int start_index, int lower_char)
+	{
+		return ActiveKernelTable().load(std::memory_order_relaxed)->m_FindLowerByte(str, length, start_index, lower_char);
+	}
+
+	inline void BlockPresence(const uint8_t* rows, int row_count, const CharacterBuckets& buckets, uint8_t* out_presence)
+	{
+		ActiveKernelTable().load(std::memory_order_relaxed)->m_BlockPresence(rows, row_count, buckets, out_presence);
+	}
+
+} // namespace FuzzySearch
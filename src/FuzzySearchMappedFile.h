@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace FuzzySearch
+{
+	/*
+	 * Read only view of a whole file.
+	 *
+	 * POSIX systems map the file, elsewhere it is read into memory. The view stays valid until the object is closed or
+	 * destroyed, even when the file is replaced on disk meanwhile.
+	*/
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool Open(const std::string& path);
+		void Close();
+
+		const uint8_t* Data() const { return m_Data; }
+		size_t Size() const { return m_Size; }
+		bool IsOpen() const { return m_Open; }
+
+	private:
+		const uint8_t* m_Data = nullptr;
+		size_t m_Size = 0;
+		bool m_Open = false;
+		bool m_Mapped = false;
+		std::vector<uint8_t> m_Buffer;
+	};
+
+} // namespace FuzzySearch
+
+#include "FuzzySearchMappedFile.inl"
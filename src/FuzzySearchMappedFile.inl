@@ -0,0 +1,85 @@
+#include "FuzzySearchMappedFile.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FUZZY_SEARCH_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define FUZZY_SEARCH_MMAP 0
+#include <fstream>
+#include <iterator>
+#endif
+
+namespace FuzzySearch
+{
+	inline MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+	inline bool MappedFile::Open(const std::string& path)
+	{
+		Close();
+
+#if FUZZY_SEARCH_MMAP
+		const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			return false;
+		}
+
+		struct stat file_stat;
+		if (::fstat(fd, &file_stat) != 0)
+		{
+			::close(fd);
+			return false;
+		}
+
+		m_Size = static_cast<size_t>(file_stat.st_size);
+		if (m_Size > 0)
+		{
+			// The mapping keeps the file alive, the descriptor is not needed anymore
+			void* data = ::mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data == MAP_FAILED)
+			{
+				::close(fd);
+				m_Size = 0;
+				return false;
+			}
+			m_Data = static_cast<const uint8_t*>(data);
+			m_Mapped = true;
+		}
+		::close(fd);
+#else
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+		{
+			return false;
+		}
+		m_Buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		m_Data = m_Buffer.empty() ? nullptr : m_Buffer.data();
+		m_Size = m_Buffer.size();
+#endif
+
+		m_Open = true;
+		return true;
+	}
+
+	inline void MappedFile::Close()
+	{
+#if FUZZY_SEARCH_MMAP
+		if (m_Mapped)
+		{
+			::munmap(const_cast<uint8_t*>(m_Data), m_Size);
+		}
+#endif
+		m_Buffer.clear();
+		m_Data = nullptr;
+		m_Size = 0;
+		m_Open = false;
+		m_Mapped = false;
+	}
+
+} // namespace FuzzySearch
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "FuzzySearchCorpus.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace FuzzySearch
+{
+	/*
+	 * Binary protocol between a search server and its clients.
+	 *
+	 * Every message is one frame, a little endian uint32 payload size followed by the payload. Frames carry a request id
+	 * chosen by the client, so a client can write any number of requests without waiting and match the responses up.
+	 * Every request is answered exactly once, not necessarily in request order.
+	 *
+	 * Search request payload:
+	 *   u8 type (E_SEARCH), u32 request id, u8 match mode, u8 max unmatched characters, u16 rescore count,
+	 *   u32 max results, u8 flags, u16 pattern length, pattern bytes
+	 *
+	 * Search response payload:
+	 *   u8 type (E_RESULTS), u32 request id, u8 status, u8 flags, u64 corpus version, u32 result count, then per
+	 *   result u32 id, i32 score, u16 match count, u16 matched indexes[match count] and with E_INCLUDE_STRINGS in the
+	 *   flags u16 string length, string bytes
+	*/
+
+	enum class MessageType : uint8_t
+	{
+		E_SEARCH = 1,
+		E_RESULTS = 2
+	};
+
+	enum class ResponseStatus : uint8_t
+	{
+		E_OK,
+		E_BAD_REQUEST,
+		// A later E_LATEST_WINS request of the same connection replaced the request before it finished
+		E_SUPERSEDED
+	};
+
+	enum class DecodeResult : uint8_t
+	{
+		// A whole frame was read
+		E_OK,
+		// More bytes are needed
+		E_INCOMPLETE,
+		// The frame is complete but its payload is invalid, it can be skipped
+		E_MALFORMED,
+		// The frame header is invalid, the stream cannot be resynchronized
+		E_INVALID_FRAME
+	};
+
+	namespace RequestFlags
+	{
+		// Send the corpus string of every result along with its id
+		constexpr uint8_t E_INCLUDE_STRINGS = 1 << 0;
+		// Cancel every earlier request of the connection that is not answered yet, for queries sent while typing
+		constexpr uint8_t E_LATEST_WINS = 1 << 1;
+	}
+
+	struct SearchRequest
+	{
+		uint32_t m_RequestId = 0;
+		SearchConfig m_SearchConfig;
+		// 0 requests all results, servers may return fewer
+		uint32_t m_MaxResults = 0;
+		uint8_t m_Flags = 0;
+		std::string m_Pattern;
+	};
+
+	struct SearchResponse
+	{
+		uint32_t m_RequestId = 0;
+		ResponseStatus m_Status = ResponseStatus::E_OK;
+		// The results include every VersionedCorpus commit up to this version
+		uint64_t m_Version = 0;
+		CorpusSearchResults m_Results;
+		// Strings of the results in result order, empty unless E_INCLUDE_STRINGS was requested
+		std::vector<std::string> m_Strings;
+	};
+
+	struct Protocol
+	{
+		static constexpr size_t frame_header_size = 4;
+		// Position of the request id in a response frame
+		static constexpr size_t response_request_id_offset = frame_header_size + 1;
+		// Larger frames are treated as a corrupt stream
+		static constexpr size_t max_request_size = 64 * 1024;
+		static constexpr size_t max_response_size = 256 * 1024 * 1024;
+		// Payload of a search request before its pattern
+		static constexpr size_t request_fields_size = 16;
+		// Longest pattern a request frame can carry
+		static constexpr size_t max_pattern_length = max_request_size - request_fields_size;
+	};
+
+	// Encoders append one whole frame to out.
+	// A request with a pattern longer than Protocol::max_pattern_length is not encoded, out is left as it was.
+	bool EncodeSearchRequest(const SearchRequest& request, std::vector<uint8_t>& out);
+	void EncodeSearchResponse(uint32_t request_id, ResponseStatus status, uint64_t version, const Corpus* corpus, const CorpusSearchResults& results, bool include_strings, std::vector<uint8_t>& out);
+
+	// Rewrites the request id of an encoded response frame, one search can answer several identical requests
+	void SetResponseRequestId(uint8_t* frame, uint32_t request_id);
+
+	// Decoders read the frame at the start of data, out_frame_size is set to its size when it is complete.
+	// A malformed request still has its request id set when the payload is long enough to hold it.
+	DecodeResult DecodeSearchRequest(const uint8_t* data, size_t size, size_t& out_frame_size, SearchRequest& out_request);
+	DecodeResult DecodeSearchResponse(const uint8_t* data, size_t size, size_t& out_frame_size, SearchResponse& out_response);
+
+} // namespace FuzzySearch
+
+#include "FuzzySearchProtocol.inl"
@@ -0,0 +1,265 @@
+#include "FuzzySearchProtocol.h"
+
+#include <algorithm>
+#include <type_traits>
+
+namespace FuzzySearch
+{
+	template<typename T>
+	void AppendLittleEndian(std::vector<uint8_t>& out, T value)
+	{
+		using Unsigned = std::make_unsigned_t<T>;
+		const Unsigned bits = static_cast<Unsigned>(value);
+		for (size_t byte = 0; byte < sizeof(T); ++byte)
+		{
+			out.push_back(static_cast<uint8_t>(bits >> (byte * 8)));
+		}
+	}
+
+	// Bounds checked cursor over one payload, every read fails once the payload is exhausted
+	class PayloadReader
+	{
+	public:
+		PayloadReader(const uint8_t* data, size_t size)
+			: m_Data(data)
+			, m_Size(size)
+		{}
+
+		template<typename T>
+		bool Read(T& out_value)
+		{
+			using Unsigned = std::make_unsigned_t<T>;
+			if (m_Size - m_Position < sizeof(T))
+			{
+				return false;
+			}
+			Unsigned bits = 0;
+			for (size_t byte = 0; byte < sizeof(T); ++byte)
+			{
+				bits |= static_cast<Unsigned>(static_cast<Unsigned>(m_Data[m_Position + byte]) << (byte * 8));
+			}
+			m_Position += sizeof(T);
+			out_value = static_cast<T>(bits);
+			return true;
+		}
+
+		bool ReadBytes(size_t length, const uint8_t*& out_bytes)
+		{
+			if (m_Size - m_Position < length)
+			{
+				return false;
+			}
+			out_bytes = m_Data + m_Position;
+			m_Position += length;
+			return true;
+		}
+
+		bool AtEnd() const { return m_Position == m_Size; }
+
+	private:
+		const uint8_t* m_Data = nullptr;
+		size_t m_Size = 0;
+		size_t m_Position = 0;
+	};
+
+	// Reserves the frame header, FinishFrame fills in the payload size once the payload is written
+	inline size_t BeginFrame(std::vector<uint8_t>& out)
+	{
+		const size_t frame_start = out.size();
+		out.resize(frame_start + Protocol::frame_header_size);
+		return frame_start;
+	}
+
+	inline void FinishFrame(std::vector<uint8_t>& out, size_t frame_start)
+	{
+		const uint32_t payload_size = static_cast<uint32_t>(out.size() - frame_start - Protocol::frame_header_size);
+		for (size_t byte = 0; byte < Protocol::frame_header_size; ++byte)
+		{
+			out[frame_start + byte] = static_cast<uint8_t>(payload_size >> (byte * 8));
+		}
+	}
+
+	// Finds the payload of the frame at the start of data
+	inline DecodeResult ReadFrame(const uint8_t* data, size_t size, size_t max_payload_size, size_t& out_frame_size, PayloadReader& out_payload)
+	{
+		uint32_t payload_size = 0;
+		PayloadReader header(data, size);
+		if (!header.Read(payload_size))
+		{
+			return DecodeResult::E_INCOMPLETE;
+		}
+		if (payload_size > max_payload_size)
+		{
+			return DecodeResult::E_INVALID_FRAME;
+		}
+		if (size - Protocol::frame_header_size < payload_size)
+		{
+			return DecodeResult::E_INCOMPLETE;
+		}
+
+		out_frame_size = Protocol::frame_header_size + payload_size;
+		out_payload = PayloadReader(data + Protocol::frame_header_size, payload_size);
+		return DecodeResult::E_OK;
+	}
+
+	inline bool EncodeSearchRequest(const SearchRequest& request, std::vector<uint8_t>& out)
+	{
+		if (request.m_Pattern.length() > Protocol::max_pattern_length)
+		{
+			return false;
+		}
+
+		const size_t frame_start = BeginFrame(out);
+		const uint16_t pattern_length = static_cast<uint16_t>(request.m_Pattern.length());
+		out.push_back(static_cast<uint8_t>(MessageType::E_SEARCH));
+		AppendLittleEndian(out, request.m_RequestId);
+		out.push_back(static_cast<uint8_t>(request.m_SearchConfig.m_MatchMode));
+		out.push_back(request.m_SearchConfig.m_MaxUnmatchedCharactersFromPattern);
+		AppendLittleEndian(out, request.m_SearchConfig.m_OptimalRescoreCount);
+		AppendLittleEndian(out, request.m_MaxResults);
+		out.push_back(request.m_Flags);
+		AppendLittleEndian(out, pattern_length);
+		out.insert(out.end(), request.m_Pattern.begin(), request.m_Pattern.end());
+		FinishFrame(out, frame_start);
+		return true;
+	}
+
+	inline void EncodeSearchResponse(uint32_t request_id, ResponseStatus status, uint64_t version, const Corpus* corpus, const CorpusSearchResults& results, bool include_strings, std::vector<uint8_t>& out)
+	{
+		include_strings = include_strings && corpus != nullptr;
+
+		const size_t frame_start = BeginFrame(out);
+		out.push_back(static_cast<uint8_t>(MessageType::E_RESULTS));
+		AppendLittleEndian(out, request_id);
+		out.push_back(static_cast<uint8_t>(status));
+		out.push_back(include_strings ? RequestFlags::E_INCLUDE_STRINGS : 0);
+		AppendLittleEndian(out, version);
+		AppendLittleEndian(out, static_cast<uint32_t>(results.size()));
+		for (const CorpusSearchResult& result : results)
+		{
+			AppendLittleEndian(out, result.m_Id);
+			AppendLittleEndian(out, static_cast<int32_t>(result.m_Score));
+			AppendLittleEndian(out, result.m_MatchCount);
+			for (uint16_t index : results.Matches(result))
+			{
+				AppendLittleEndian(out, index);
+			}
+			if (include_strings)
+			{
+				// Corpus strings are at most Corpus::max_string_length long
+				const std::string_view str = corpus->Get(result.m_Id);
+				AppendLittleEndian(out, static_cast<uint16_t>(str.length()));
+				out.insert(out.end(), str.begin(), str.end());
+			}
+		}
+		FinishFrame(out, frame_start);
+	}
+
+	inline void SetResponseRequestId(uint8_t* frame, uint32_t request_id)
+	{
+		for (size_t byte = 0; byte < sizeof(request_id); ++byte)
+		{
+			frame[Protocol::response_request_id_offset + byte] = static_cast<uint8_t>(request_id >> (byte * 8));
+		}
+	}
+
+	inline DecodeResult DecodeSearchRequest(const uint8_t* data, size_t size, size_t& out_frame_size, SearchRequest& out_request)
+	{
+		PayloadReader payload(nullptr, 0);
+		const DecodeResult frame_result = ReadFrame(data, size, Protocol::max_request_size, out_frame_size, payload);
+		if (frame_result != DecodeResult::E_OK)
+		{
+			return frame_result;
+		}
+
+		uint8_t type = 0;
+		uint8_t match_mode = 0;
+		uint16_t pattern_length = 0;
+		const uint8_t* pattern = nullptr;
+		out_request.m_RequestId = 0;
+		if (!payload.Read(type) || type != static_cast<uint8_t>(MessageType::E_SEARCH) || !payload.Read(out_request.m_RequestId))
+		{
+			return DecodeResult::E_MALFORMED;
+		}
+		if (!payload.Read(match_mode) || match_mode > static_cast<uint8_t>(MatchMode::E_SOURCE_FILES)
+			|| !payload.Read(out_request.m_SearchConfig.m_MaxUnmatchedCharactersFromPattern)
+			|| !payload.Read(out_request.m_SearchConfig.m_OptimalRescoreCount)
+			|| !payload.Read(out_request.m_MaxResults)
+			|| !payload.Read(out_request.m_Flags)
+			|| !payload.Read(pattern_length)
+			|| !payload.ReadBytes(pattern_length, pattern)
+			|| !payload.AtEnd())
+		{
+			return DecodeResult::E_MALFORMED;
+		}
+
+		out_request.m_SearchConfig.m_MatchMode = static_cast<MatchMode>(match_mode);
+		out_request.m_Pattern.assign(reinterpret_cast<const char*>(pattern), pattern_length);
+		return DecodeResult::E_OK;
+	}
+
+	inline DecodeResult DecodeSearchResponse(const uint8_t* data, size_t size, size_t& out_frame_size, SearchResponse& out_response)
+	{
+		PayloadReader payload(nullptr, 0);
+		const DecodeResult frame_result = ReadFrame(data, size, Protocol::max_response_size, out_frame_size, payload);
+		if (frame_result != DecodeResult::E_OK)
+		{
+			return frame_result;
+		}
+
+		out_response.m_Results.Clear();
+		out_response.m_Strings.clear();
+
+		uint8_t type = 0;
+		uint8_t status = 0;
+		uint8_t flags = 0;
+		uint32_t result_count = 0;
+		if (!payload.Read(type) || type != static_cast<uint8_t>(MessageType::E_RESULTS)
+			|| !payload.Read(out_response.m_RequestId)
+			|| !payload.Read(status)
+			|| !payload.Read(flags)
+			|| !payload.Read(out_response.m_Version)
+			|| !payload.Read(result_count))
+		{
+			return DecodeResult::E_MALFORMED;
+		}
+		out_response.m_Status = static_cast<ResponseStatus>(status);
+
+		const bool with_strings = (flags & RequestFlags::E_INCLUDE_STRINGS) != 0;
+		std::vector<uint16_t> matches;
+		for (uint32_t index = 0; index < result_count; ++index)
+		{
+			CorpusSearchResult result;
+			int32_t score = 0;
+			if (!payload.Read(result.m_Id) || !payload.Read(score) || !payload.Read(result.m_MatchCount))
+			{
+				return DecodeResult::E_MALFORMED;
+			}
+			result.m_Score = score;
+
+			matches.resize(result.m_MatchCount);
+			for (uint16_t& match : matches)
+			{
+				if (!payload.Read(match))
+				{
+					return DecodeResult::E_MALFORMED;
+				}
+			}
+			out_response.m_Results.Append(result, MatchSpan(matches.data(), matches.size()));
+
+			if (with_strings)
+			{
+				uint16_t length = 0;
+				const uint8_t* bytes = nullptr;
+				if (!payload.Read(length) || !payload.ReadBytes(length, bytes))
+				{
+					return DecodeResult::E_MALFORMED;
+				}
+				out_response.m_Strings.emplace_back(reinterpret_cast<const char*>(bytes), length);
+			}
+		}
+
+		return payload.AtEnd() ? DecodeResult::E_OK : DecodeResult::E_MALFORMED;
+	}
+
+} // namespace FuzzySearch
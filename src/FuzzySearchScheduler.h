@@ -0,0 +1,136 @@
+#pragma once
+
+#include "FuzzySearchProtocol.h"
+#include "FuzzySearchSearcher.h"
+#include "FuzzySearchVersionedCorpus.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace FuzzySearch
+{
+	struct SchedulerConfig
+	{
+		SearcherConfig m_SearcherConfig;
+		// Caps the results of one request, also applies to requests for all results
+		uint32_t m_MaxResults { 1000 };
+	};
+
+	/*
+	 * Runs the search requests of many sessions, e.g. server connections, one at a time on a search thread.
+	 *
+	 * A request with RequestFlags::E_LATEST_WINS supersedes every earlier request of its session: queued ones are
+	 * answered E_SUPERSEDED right away and a running one is cancelled mid-scan. A session typing a query therefore has
+	 * at most one search running and one waiting, and fast typing costs no more CPU than the slowest single query.
+	 *
+	 * Identical requests, same pattern, config, result limit and flags, share one search no matter which sessions they
+	 * come from. A request joins a waiting or running search, the search is only cancelled once every request it
+	 * answers has been superseded.
+	 *
+	 * Responses are encoded frames collected with TakeResponses, the on_ready callback passed to Start tells when a search
+	 * added some. Submit adds the E_SUPERSEDED answers itself. Submit, CloseSession and TakeResponses are called from
+	 * one thread.
+	*/
+	class QueryScheduler
+	{
+	public:
+		using SessionId = uint64_t;
+
+		explicit QueryScheduler(VersionedCorpus& corpus, SchedulerConfig config = {});
+		~QueryScheduler();
+
+		QueryScheduler(const QueryScheduler&) = delete;
+		QueryScheduler& operator=(const QueryScheduler&) = delete;
+
+		// Starts the search thread, requests submitted before are kept until then.
+		// on_ready is called on the search thread whenever responses were added.
+		void Start(std::function<void()> on_ready = {});
+		void Stop();
+
+		void Submit(SessionId session, const SearchRequest& request);
+		// Drops the unanswered requests of the session without answering them
+		void CloseSession(SessionId session);
+		// Requests of the session that are not answered yet
+		size_t PendingCount(SessionId session) const;
+
+		// Calls on_response(session, frame, frame_size) for every response ready so far, returns their number
+		template<typename OnResponse>
+		size_t TakeResponses(OnResponse&& on_response);
+
+		// Searches that ran to the end or were cancelled, requests answered by a search another request started,
+		// and requests answered E_SUPERSEDED
+		uint64_t SearchCount() const;
+		uint64_t CancelledCount() const;
+		uint64_t SharedCount() const;
+		uint64_t SupersededCount() const;
+
+	private:
+		struct Waiter
+		{
+			SessionId m_Session = 0;
+			uint32_t m_RequestId = 0;
+		};
+
+		// One search and every request it answers
+		struct Query
+		{
+			SearchRequest m_Request;
+			std::vector<Waiter> m_Waiters;
+			CancellationToken m_Cancellation;
+		};
+
+		struct ReadyResponse
+		{
+			SessionId m_Session = 0;
+			// Slice of m_ReadyBytes
+			size_t m_Offset = 0;
+			size_t m_Size = 0;
+		};
+
+		static bool SameQuery(const SearchRequest& lhs, const SearchRequest& rhs);
+
+		void SearchLoop();
+		// Removes the session's waiters from every query, queries left without one are dropped or cancelled.
+		// Called with m_Mutex held.
+		void RemoveWaiters(SessionId session, bool answer);
+		// Queues a copy of the response frame with the request id of the waiter. Called with m_Mutex held.
+		void AddResponse(const Waiter& waiter, const std::vector<uint8_t>& frame);
+
+		VersionedCorpus& m_Corpus;
+		SchedulerConfig m_Config;
+
+		mutable std::mutex m_Mutex;
+		std::condition_variable m_QueryAvailable;
+		std::deque<std::unique_ptr<Query>> m_Queue;
+		std::unique_ptr<Query> m_Running;
+		std::unordered_map<SessionId, size_t> m_PendingCounts;
+		std::vector<uint8_t> m_ReadyBytes;
+		std::vector<ReadyResponse> m_ReadyResponses;
+		std::vector<uint8_t> m_SupersededFrame;
+		bool m_Stop = false;
+
+		uint64_t m_SearchCount = 0;
+		uint64_t m_CancelledCount = 0;
+		uint64_t m_SharedCount = 0;
+		uint64_t m_SupersededCount = 0;
+
+		// Only used on the search thread
+		Searcher m_Searcher;
+		std::vector<uint8_t> m_Frame;
+		// Swapped with the ready lists by TakeResponses so both keep their capacity
+		std::vector<uint8_t> m_TakenBytes;
+		std::vector<ReadyResponse> m_TakenResponses;
+
+		std::function<void()> m_OnReady;
+		std::thread m_Thread;
+	};
+
+} // namespace FuzzySearch
+
+#include "FuzzySearchScheduler.inl"
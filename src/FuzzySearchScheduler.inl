@@ -0,0 +1,249 @@
+#include "FuzzySearchScheduler.h"
+
+#include <algorithm>
+
+namespace FuzzySearch
+{
+	inline QueryScheduler::QueryScheduler(VersionedCorpus& corpus, SchedulerConfig config)
+		: m_Corpus(corpus)
+		, m_Config(config)
+		, m_Searcher(config.m_SearcherConfig)
+	{}
+
+	inline QueryScheduler::~QueryScheduler()
+	{
+		Stop();
+	}
+
+	inline void QueryScheduler::Start(std::function<void()> on_ready)
+	{
+		if (m_Thread.joinable())
+		{
+			return;
+		}
+		m_OnReady = std::move(on_ready);
+		m_Stop = false;
+		m_Thread = std::thread([this]() { SearchLoop(); });
+	}
+
+	inline void QueryScheduler::Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stop = true;
+			if (m_Running)
+			{
+				m_Running->m_Cancellation.Cancel();
+			}
+		}
+		m_QueryAvailable.notify_all();
+		if (m_Thread.joinable())
+		{
+			m_Thread.join();
+		}
+	}
+
+	inline void QueryScheduler::Submit(SessionId session, const SearchRequest& request)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if ((request.m_Flags & RequestFlags::E_LATEST_WINS) != 0)
+		{
+			RemoveWaiters(session, true);
+		}
+		++m_PendingCounts[session];
+
+		const Waiter waiter = { session, request.m_RequestId };
+		const uint32_t max_results = request.m_MaxResults == 0 ? m_Config.m_MaxResults : std::min(request.m_MaxResults, m_Config.m_MaxResults);
+		auto joins = [&](const Query& query)
+		{
+			return query.m_Request.m_MaxResults == max_results && SameQuery(query.m_Request, request) && !query.m_Cancellation.IsCancelled();
+		};
+
+		Query* shared_query = m_Running && joins(*m_Running) ? m_Running.get() : nullptr;
+		for (auto query = m_Queue.begin(); query != m_Queue.end() && shared_query == nullptr; ++query)
+		{
+			if (joins(**query))
+			{
+				shared_query = query->get();
+			}
+		}
+		if (shared_query != nullptr)
+		{
+			shared_query->m_Waiters.push_back(waiter);
+			++m_SharedCount;
+			return;
+		}
+
+		auto query = std::make_unique<Query>();
+		query->m_Request = request;
+		query->m_Request.m_MaxResults = max_results;
+		query->m_Waiters.push_back(waiter);
+		m_Queue.push_back(std::move(query));
+		m_QueryAvailable.notify_one();
+	}
+
+	inline void QueryScheduler::CloseSession(SessionId session)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		RemoveWaiters(session, false);
+		m_PendingCounts.erase(session);
+	}
+
+	inline size_t QueryScheduler::PendingCount(SessionId session) const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto found = m_PendingCounts.find(session);
+		return found != m_PendingCounts.end() ? found->second : 0;
+	}
+
+	template<typename OnResponse>
+	size_t QueryScheduler::TakeResponses(OnResponse&& on_response)
+	{
+		m_TakenBytes.clear();
+		m_TakenResponses.clear();
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_TakenBytes.swap(m_ReadyBytes);
+			m_TakenResponses.swap(m_ReadyResponses);
+		}
+
+		for (const ReadyResponse& response : m_TakenResponses)
+		{
+			on_response(response.m_Session, m_TakenBytes.data() + response.m_Offset, response.m_Size);
+		}
+		return m_TakenResponses.size();
+	}
+
+	inline uint64_t QueryScheduler::SearchCount() const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_SearchCount;
+	}
+
+	inline uint64_t QueryScheduler::CancelledCount() const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_CancelledCount;
+	}
+
+	inline uint64_t QueryScheduler::SharedCount() const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_SharedCount;
+	}
+
+	inline uint64_t QueryScheduler::SupersededCount() const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_SupersededCount;
+	}
+
+	inline bool QueryScheduler::SameQuery(const SearchRequest& lhs, const SearchRequest& rhs)
+	{
+		return lhs.m_Pattern == rhs.m_Pattern
+			&& lhs.m_SearchConfig.m_MatchMode == rhs.m_SearchConfig.m_MatchMode
+			&& lhs.m_SearchConfig.m_MaxUnmatchedCharactersFromPattern == rhs.m_SearchConfig.m_MaxUnmatchedCharactersFromPattern
+			&& lhs.m_SearchConfig.m_OptimalRescoreCount == rhs.m_SearchConfig.m_OptimalRescoreCount
+			&& (lhs.m_Flags & RequestFlags::E_INCLUDE_STRINGS) == (rhs.m_Flags & RequestFlags::E_INCLUDE_STRINGS);
+	}
+
+	inline void QueryScheduler::SearchLoop()
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		for (;;)
+		{
+			m_QueryAvailable.wait(lock, [this]() { return m_Stop || !m_Queue.empty(); });
+			if (m_Stop)
+			{
+				return;
+			}
+
+			m_Running = std::move(m_Queue.front());
+			m_Queue.pop_front();
+			Query& query = *m_Running;
+			lock.unlock();
+
+			// Only the waiters of a running query change, and only under the lock
+			const SearchRequest& request = query.m_Request;
+			const uint64_t version = m_Corpus.Version();
+			const VersionedCorpus::Snapshot snapshot = m_Corpus.Acquire();
+			m_Searcher.SetCorpus(snapshot.get());
+			const CorpusSearchResults& results = m_Searcher.Search(request.m_Pattern, request.m_SearchConfig, request.m_MaxResults, &query.m_Cancellation);
+			m_Frame.clear();
+			if (!query.m_Cancellation.IsCancelled())
+			{
+				const bool include_strings = (request.m_Flags & RequestFlags::E_INCLUDE_STRINGS) != 0;
+				EncodeSearchResponse(0, ResponseStatus::E_OK, version, snapshot.get(), results, include_strings, m_Frame);
+			}
+			m_Searcher.SetCorpus(nullptr);
+
+			lock.lock();
+			++m_SearchCount;
+			// A query is only cancelled once it has no waiters left, and none join it afterwards
+			const bool answered = !query.m_Cancellation.IsCancelled();
+			if (answered)
+			{
+				for (const Waiter& waiter : query.m_Waiters)
+				{
+					AddResponse(waiter, m_Frame);
+				}
+			}
+			else
+			{
+				++m_CancelledCount;
+			}
+			m_Running.reset();
+
+			if (answered && m_OnReady)
+			{
+				lock.unlock();
+				m_OnReady();
+				lock.lock();
+			}
+		}
+	}
+
+	inline void QueryScheduler::RemoveWaiters(SessionId session, bool answer)
+	{
+		auto remove = [&](Query& query)
+		{
+			auto removed = std::stable_partition(query.m_Waiters.begin(), query.m_Waiters.end(), [session](const Waiter& waiter) { return waiter.m_Session != session; });
+			if (answer)
+			{
+				for (auto waiter = removed; waiter != query.m_Waiters.end(); ++waiter)
+				{
+					m_SupersededFrame.clear();
+					EncodeSearchResponse(waiter->m_RequestId, ResponseStatus::E_SUPERSEDED, m_Corpus.Version(), nullptr, CorpusSearchResults(), false, m_SupersededFrame);
+					AddResponse(*waiter, m_SupersededFrame);
+					++m_SupersededCount;
+				}
+			}
+			query.m_Waiters.erase(removed, query.m_Waiters.end());
+			return query.m_Waiters.empty();
+		};
+
+		m_Queue.erase(std::remove_if(m_Queue.begin(), m_Queue.end(), [&remove](const std::unique_ptr<Query>& query) { return remove(*query); }), m_Queue.end());
+		if (m_Running && !m_Running->m_Waiters.empty() && remove(*m_Running))
+		{
+			m_Running->m_Cancellation.Cancel();
+		}
+	}
+
+	inline void QueryScheduler::AddResponse(const Waiter& waiter, const std::vector<uint8_t>& frame)
+	{
+		ReadyResponse response;
+		response.m_Session = waiter.m_Session;
+		response.m_Offset = m_ReadyBytes.size();
+		response.m_Size = frame.size();
+		m_ReadyBytes.insert(m_ReadyBytes.end(), frame.begin(), frame.end());
+		SetResponseRequestId(m_ReadyBytes.data() + response.m_Offset, waiter.m_RequestId);
+		m_ReadyResponses.push_back(response);
+
+		auto pending = m_PendingCounts.find(waiter.m_Session);
+		if (pending != m_PendingCounts.end() && --pending->second == 0)
+		{
+			m_PendingCounts.erase(pending);
+		}
+	}
+
+} // namespace FuzzySearch
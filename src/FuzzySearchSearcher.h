@@ -0,0 +1,127 @@
+#pragma once
+
+#include "FuzzySearchCorpus.h"
+#include "FuzzySearchThreadPool.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace FuzzySearch
+{
+	struct SearcherConfig
+	{
+		// Threads used for a search including the calling thread, 0 uses std::thread::hardware_concurrency
+		uint32_t m_ThreadCount { 0 };
+		// The corpus is split into tasks of at least this many strings, small corpora are scanned by fewer threads
+		uint32_t m_MinStringsPerTask { 4096 };
+		// Tasks per thread, more tasks balance uneven match costs better
+		uint32_t m_TasksPerThread { 4 };
+		// When all results are requested every task sorts its own results and the sorted runs are merged in parallel,
+		// the output is split into parts of at least this many results
+		uint32_t m_MinResultsPerMergePart { 16384 };
+	};
+
+	// Stops a search from another thread, see Searcher::Search
+	class CancellationToken
+	{
+	public:
+		void Cancel() { m_Cancelled.store(true, std::memory_order_relaxed); }
+		void Reset() { m_Cancelled.store(false, std::memory_order_relaxed); }
+		bool IsCancelled() const { return m_Cancelled.load(std::memory_order_relaxed); }
+
+	private:
+		std::atomic<bool> m_Cancelled{ false };
+	};
+
+	/*
+	 * Long lived search object for repeated queries against one corpus.
+	 *
+	 * Owns a thread pool, the match scratch of every thread and the result sets. All of it is reused between
+	 * queries, once the buffers have grown to fit the queries a search does not create threads or allocate.
+	 *
+	 * Results are the same as Corpus::Search. A Searcher runs one query at a time, use one Searcher per querying thread.
+	*/
+	class Searcher
+	{
+	public:
+		explicit Searcher(SearcherConfig config = {});
+
+		// The corpus has to outlive the searcher or the next SetCorpus call and must not change during a search
+		void SetCorpus(const Corpus* corpus);
+		const Corpus* GetCorpus() const { return m_Corpus; }
+
+		size_t ThreadCount() const { return m_ThreadPool.ThreadCount(); }
+
+		// Strings scanned between two looks at the cancellation token, a multiple of the corpus block sizes
+		static constexpr uint32_t cancellation_check_interval = 4096;
+
+		// Returns the best max_results results, all results when max_results is 0.
+		// The results are owned by the searcher and stay valid until the next Search or SetCorpus call.
+		// Once the cancellation token is cancelled every thread stops scanning within cancellation_check_interval
+		// strings and the search returns no results.
+		const CorpusSearchResults& Search(const std::string& pattern_str, SearchConfig search_config, size_t max_results = 0, const CancellationToken* cancellation = nullptr);
+
+	private:
+		// Task result and rank key as one value, ordered like CompareCorpusResults because tasks cover the corpus in id order
+		struct MergeKey
+		{
+			uint64_t m_Key = 0;
+			uint32_t m_Task = 0;
+			uint32_t m_Index = 0;
+		};
+
+		struct MergeCursor
+		{
+			MergeKey m_Head;
+			size_t m_Position = 0;
+			size_t m_End = 0;
+		};
+
+		// Everything one thread touches during a scan, aligned so threads do not share cache lines
+		struct alignas(64) ThreadState
+		{
+			MatchScratch m_Scratch;
+			PatternMatch m_PatternMatch;
+			std::vector<MergeCursor> m_MergeHeap;
+		};
+
+		// Matches of one part of the corpus. Buffers belong to tasks and not threads, the same query splits into
+		// the same tasks no matter which thread picks them up.
+		struct alignas(64) TaskResults
+		{
+			CorpusSearchResults m_Results;
+			// Rank keys of m_Results in result order, only filled when all results are requested
+			std::vector<RankKey> m_RankKeys;
+			std::vector<RankKey> m_RankBuffer;
+		};
+
+		struct RankedResult
+		{
+			const CorpusSearchResult* m_Result;
+			const CorpusSearchResults* m_Owner;
+		};
+
+		static bool CompareMergeKeys(const MergeKey& lhs, const MergeKey& rhs) noexcept;
+
+		void RankBest(size_t task_count, size_t max_results);
+		void RankAll(size_t task_count);
+		void MergePart(size_t task_count, size_t part_index, ThreadState& thread_state);
+
+		SearcherConfig m_Config;
+		ThreadPool m_ThreadPool;
+		const Corpus* m_Corpus = nullptr;
+
+		CompiledPattern m_Pattern;
+		std::vector<ThreadState> m_ThreadStates;
+		std::vector<TaskResults> m_TaskResults;
+		std::vector<RankedResult> m_RankedResults;
+		std::vector<MergeKey> m_MergeSamples;
+		// Per merge part boundary the position in every task's sorted keys, part_count + 1 rows of task_count entries
+		std::vector<size_t> m_MergeBounds;
+		CorpusSearchResults m_Results;
+	};
+
+} // namespace FuzzySearch
+
+#include "FuzzySearchSearcher.inl"
@@ -0,0 +1,283 @@
+#include "FuzzySearchSearcher.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace FuzzySearch
+{
+	inline Searcher::Searcher(SearcherConfig config)
+		: m_Config(config)
+		, m_ThreadPool(config.m_ThreadCount)
+		, m_ThreadStates(m_ThreadPool.ThreadCount())
+	{
+		m_Config.m_MinStringsPerTask = std::max<uint32_t>(m_Config.m_MinStringsPerTask, 1);
+		m_Config.m_TasksPerThread = std::max<uint32_t>(m_Config.m_TasksPerThread, 1);
+		m_Config.m_MinResultsPerMergePart = std::max<uint32_t>(m_Config.m_MinResultsPerMergePart, 1);
+	}
+
+	inline void Searcher::SetCorpus(const Corpus* corpus)
+	{
+		m_Corpus = corpus;
+		m_Results.Clear();
+	}
+
+	inline const CorpusSearchResults& Searcher::Search(const std::string& pattern_str, SearchConfig search_config, size_t max_results, const CancellationToken* cancellation)
+	{
+		m_Results.Clear();
+		if (m_Corpus == nullptr || (cancellation != nullptr && cancellation->IsCancelled()))
+		{
+			return m_Results;
+		}
+
+		const Corpus& corpus = *m_Corpus;
+		if (const CorpusSearchResults* short_query_results = corpus.FindShortQueryResults(pattern_str, search_config, max_results))
+		{
+			const size_t result_count = max_results == 0 ? short_query_results->size() : std::min(max_results, short_query_results->size());
+			for (size_t index = 0; index < result_count; ++index)
+			{
+				m_Results.Append((*short_query_results)[index], short_query_results->Matches(index));
+			}
+			return m_Results;
+		}
+
+		m_Pattern.Compile(FuzzySearchStringRef<std::string>(pattern_str));
+		if (m_Pattern.Empty())
+		{
+			return m_Results;
+		}
+
+		for (ThreadState& thread_state : m_ThreadStates)
+		{
+			// A thread can pick up work for the first time on any query, grow its buffers up front
+			thread_state.m_Scratch.Prepare(m_Pattern.Length());
+			thread_state.m_PatternMatch.m_Matches.reserve(m_Pattern.Length());
+		}
+
+		const size_t string_count = corpus.Size();
+		const size_t max_task_count = m_ThreadStates.size() * m_Config.m_TasksPerThread;
+		const size_t task_count = std::max<size_t>(std::min(max_task_count, string_count / m_Config.m_MinStringsPerTask), 1);
+		const size_t task_size = (string_count + task_count - 1) / task_count;
+		if (m_TaskResults.size() < task_count)
+		{
+			m_TaskResults.resize(task_count);
+		}
+		for (ThreadState& thread_state : m_ThreadStates)
+		{
+			thread_state.m_MergeHeap.reserve(task_count);
+		}
+
+		auto compare = [&corpus](const CorpusSearchResult& lhs, const CorpusSearchResult& rhs) { return CompareCorpusResults(corpus, lhs, rhs); };
+
+		m_ThreadPool.Run(task_count, [&](size_t task_index, size_t thread_index)
+		{
+			ThreadState& thread_state = m_ThreadStates[thread_index];
+			TaskResults& task = m_TaskResults[task_index];
+			CorpusSearchResults& task_results = task.m_Results;
+			task_results.Clear();
+
+			const uint32_t begin_id = static_cast<uint32_t>(std::min(task_index * task_size, string_count));
+			const uint32_t end_id = static_cast<uint32_t>(std::min(begin_id + task_size, string_count));
+
+			auto on_match = [&task_results](uint32_t id, const PatternMatch& pattern_match)
+			{
+				task_results.Append(id, pattern_match);
+			};
+			if (cancellation == nullptr)
+			{
+				corpus.Match(m_Pattern, thread_state.m_Scratch, search_config, begin_id, end_id, thread_state.m_PatternMatch, on_match);
+			}
+			else
+			{
+				for (uint32_t chunk_begin = begin_id; chunk_begin < end_id && !cancellation->IsCancelled(); chunk_begin += cancellation_check_interval)
+				{
+					const uint32_t chunk_end = std::min(chunk_begin + cancellation_check_interval, end_id);
+					corpus.Match(m_Pattern, thread_state.m_Scratch, search_config, chunk_begin, chunk_end, thread_state.m_PatternMatch, on_match);
+				}
+				if (cancellation->IsCancelled())
+				{
+					task_results.Clear();
+					return;
+				}
+			}
+
+			if (max_results == 0)
+			{
+				// Sorted runs for RankAll, results are in id order so the key index breaks ties by id
+				task.m_RankKeys.clear();
+				for (size_t index = 0; index < task_results.size(); ++index)
+				{
+					const CorpusSearchResult& search_result = task_results[index];
+					task.m_RankKeys.push_back({ MakeRankKey(search_result.m_Score, corpus.Get(search_result.m_Id).length()), static_cast<uint32_t>(index) });
+				}
+				SortRankKeys(task.m_RankKeys, task.m_RankBuffer);
+			}
+			else if (task_results.size() > max_results)
+			{
+				// Only the best max_results of every task can make it into the final results
+				std::nth_element(task_results.begin(), task_results.begin() + max_results, task_results.end(), compare);
+				task_results.Truncate(max_results);
+			}
+		});
+
+		if (cancellation != nullptr && cancellation->IsCancelled())
+		{
+			return m_Results;
+		}
+
+		if (max_results == 0)
+		{
+			RankAll(task_count);
+		}
+		else
+		{
+			RankBest(task_count, max_results);
+		}
+
+		// Copy only the kept results, the task buffers stay where they are for the next search
+		for (const RankedResult& ranked_result : m_RankedResults)
+		{
+			m_Results.Append(*ranked_result.m_Result, ranked_result.m_Owner->Matches(*ranked_result.m_Result));
+		}
+
+		ThreadState& thread_state = m_ThreadStates[0];
+		corpus.RescoreHead(m_Pattern, thread_state.m_Scratch, search_config, m_Results, thread_state.m_PatternMatch);
+
+		return m_Results;
+	}
+
+	inline bool Searcher::CompareMergeKeys(const MergeKey& lhs, const MergeKey& rhs) noexcept
+	{
+		if (lhs.m_Key != rhs.m_Key)
+		{
+			return lhs.m_Key < rhs.m_Key;
+		}
+		return lhs.m_Task != rhs.m_Task ? lhs.m_Task < rhs.m_Task : lhs.m_Index < rhs.m_Index;
+	}
+
+	inline void Searcher::RankBest(size_t task_count, size_t max_results)
+	{
+		m_RankedResults.clear();
+		for (size_t task_index = 0; task_index < task_count; ++task_index)
+		{
+			const CorpusSearchResults& task_results = m_TaskResults[task_index].m_Results;
+			for (const CorpusSearchResult& search_result : task_results)
+			{
+				m_RankedResults.push_back({ &search_result, &task_results });
+			}
+		}
+
+		const Corpus& corpus = *m_Corpus;
+		const size_t result_count = std::min(max_results, m_RankedResults.size());
+		std::partial_sort(m_RankedResults.begin(), m_RankedResults.begin() + result_count, m_RankedResults.end(),
+		                  [&corpus](const RankedResult& lhs, const RankedResult& rhs) { return CompareCorpusResults(corpus, *lhs.m_Result, *rhs.m_Result); });
+		m_RankedResults.resize(result_count);
+	}
+
+	inline void Searcher::RankAll(size_t task_count)
+	{
+		size_t result_count = 0;
+		for (size_t task_index = 0; task_index < task_count; ++task_index)
+		{
+			result_count += m_TaskResults[task_index].m_RankKeys.size();
+		}
+
+		m_RankedResults.resize(result_count);
+		if (result_count == 0)
+		{
+			return;
+		}
+
+		const size_t part_count = std::max<size_t>(std::min(m_ThreadStates.size(), result_count / m_Config.m_MinResultsPerMergePart), 1);
+
+		// Splitters are picked from evenly spaced samples of every sorted run, oversampling keeps the parts close in size
+		constexpr size_t samples_per_part = 4;
+		m_MergeSamples.clear();
+		if (part_count > 1)
+		{
+			const size_t samples_per_task = part_count * samples_per_part;
+			for (size_t task_index = 0; task_index < task_count; ++task_index)
+			{
+				const std::vector<RankKey>& rank_keys = m_TaskResults[task_index].m_RankKeys;
+				for (size_t sample = 1; sample <= samples_per_task && !rank_keys.empty(); ++sample)
+				{
+					const RankKey& rank_key = rank_keys[sample * rank_keys.size() / (samples_per_task + 1)];
+					m_MergeSamples.push_back({ rank_key.m_Key, static_cast<uint32_t>(task_index), rank_key.m_Index });
+				}
+			}
+			std::sort(m_MergeSamples.begin(), m_MergeSamples.end(), &CompareMergeKeys);
+		}
+
+		m_MergeBounds.assign((part_count + 1) * task_count, 0);
+		for (size_t task_index = 0; task_index < task_count; ++task_index)
+		{
+			m_MergeBounds[part_count * task_count + task_index] = m_TaskResults[task_index].m_RankKeys.size();
+		}
+
+		for (size_t part_index = 1; part_index < part_count; ++part_index)
+		{
+			const MergeKey& splitter = m_MergeSamples[part_index * m_MergeSamples.size() / part_count];
+			for (size_t task_index = 0; task_index < task_count; ++task_index)
+			{
+				const std::vector<RankKey>& rank_keys = m_TaskResults[task_index].m_RankKeys;
+				auto bound = std::partition_point(rank_keys.begin(), rank_keys.end(), [&splitter, task_index](const RankKey& rank_key)
+				{
+					return CompareMergeKeys({ rank_key.m_Key, static_cast<uint32_t>(task_index), rank_key.m_Index }, splitter);
+				});
+				m_MergeBounds[part_index * task_count + task_index] = static_cast<size_t>(bound - rank_keys.begin());
+			}
+		}
+
+		m_ThreadPool.Run(part_count, [this, task_count](size_t part_index, size_t thread_index)
+		{
+			MergePart(task_count, part_index, m_ThreadStates[thread_index]);
+		});
+	}
+
+	inline void Searcher::MergePart(size_t task_count, size_t part_index, ThreadState& thread_state)
+	{
+		const size_t* part_begin = m_MergeBounds.data() + part_index * task_count;
+		const size_t* part_end = part_begin + task_count;
+
+		// Everything before the part in every run comes before it in the output
+		size_t output_index = 0;
+		for (size_t task_index = 0; task_index < task_count; ++task_index)
+		{
+			output_index += part_begin[task_index];
+		}
+
+		// Min heap of the run heads
+		auto heap_compare = [](const MergeCursor& lhs, const MergeCursor& rhs) { return CompareMergeKeys(rhs.m_Head, lhs.m_Head); };
+		std::vector<MergeCursor>& heap = thread_state.m_MergeHeap;
+		heap.clear();
+		for (size_t task_index = 0; task_index < task_count; ++task_index)
+		{
+			if (part_begin[task_index] < part_end[task_index])
+			{
+				const RankKey& rank_key = m_TaskResults[task_index].m_RankKeys[part_begin[task_index]];
+				heap.push_back({ { rank_key.m_Key, static_cast<uint32_t>(task_index), rank_key.m_Index }, part_begin[task_index], part_end[task_index] });
+			}
+		}
+		std::make_heap(heap.begin(), heap.end(), heap_compare);
+
+		while (!heap.empty())
+		{
+			std::pop_heap(heap.begin(), heap.end(), heap_compare);
+			MergeCursor& cursor = heap.back();
+
+			const CorpusSearchResults& task_results = m_TaskResults[cursor.m_Head.m_Task].m_Results;
+			m_RankedResults[output_index++] = { &task_results[cursor.m_Head.m_Index], &task_results };
+
+			if (++cursor.m_Position == cursor.m_End)
+			{
+				heap.pop_back();
+				continue;
+			}
+
+			const RankKey& rank_key = m_TaskResults[cursor.m_Head.m_Task].m_RankKeys[cursor.m_Position];
+			cursor.m_Head.m_Key = rank_key.m_Key;
+			cursor.m_Head.m_Index = rank_key.m_Index;
+			std::push_heap(heap.begin(), heap.end(), heap_compare);
+		}
+	}
+
+} // namespace FuzzySearch
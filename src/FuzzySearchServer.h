@@ -0,0 +1,126 @@
+#pragma once
+
+#include "FuzzySearchProtocol.h"
+#include "FuzzySearchScheduler.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace FuzzySearch
+{
+	struct ServerConfig
+	{
+		SchedulerConfig m_SchedulerConfig;
+		// A connection is not read from while more response bytes than this wait to be written
+		size_t m_MaxPendingOutput { 4 * 1024 * 1024 };
+		// Requests of a connection read ahead of their answers, further requests stay in the socket meanwhile
+		size_t m_MaxPendingRequests { 64 };
+	};
+
+	/*
+	 * Serves searches on a VersionedCorpus over a Unix domain socket, see FuzzySearchProtocol.h for the messages.
+	 *
+	 * One thread runs the event loop over all connections and hands the requests to a QueryScheduler, which searches on
+	 * its own thread and applies E_LATEST_WINS per connection. Every search uses the latest published version of the
+	 * corpus, so the corpus can be updated by a Watcher meanwhile.
+	 *
+	 * Clients may pipeline, all complete requests in a read are submitted at once and responses are written as they
+	 * become ready. Only available on POSIX systems, Listen returns false elsewhere.
+	*/
+	class Server
+	{
+	public:
+		explicit Server(VersionedCorpus& corpus, ServerConfig config = {});
+		~Server();
+
+		Server(const Server&) = delete;
+		Server& operator=(const Server&) = delete;
+
+		// Binds the socket, a stale socket file left behind at the path is replaced
+		bool Listen(const std::string& socket_path);
+
+		// Waits up to timeout for connections and requests and handles them, returns false once stopped
+		bool Poll(std::chrono::milliseconds timeout);
+		// Polls until Stop
+		void Run();
+		// Wakes up Poll and makes Run return, can be called from any thread
+		void Stop();
+
+		size_t ConnectionCount() const { return m_Connections.size(); }
+		uint64_t RequestCount() const { return m_RequestCount; }
+		const QueryScheduler& Scheduler() const { return m_Scheduler; }
+
+	private:
+		struct Connection
+		{
+			int m_Fd = -1;
+			// Received bytes, requests are decoded from m_InputStart
+			std::vector<uint8_t> m_Input;
+			size_t m_InputStart = 0;
+			// Encoded responses, written from m_OutputStart
+			std::vector<uint8_t> m_Output;
+			size_t m_OutputStart = 0;
+			// The client shut down its side, the connection is closed once the responses are written
+			bool m_ReadClosed = false;
+		};
+
+		using ConnectionMap = std::map<QueryScheduler::SessionId, Connection>;
+
+		void Accept();
+		// All three return false when the connection has to be closed
+		bool ReadRequests(Connection& connection);
+		bool HandleRequests(QueryScheduler::SessionId session, Connection& connection);
+		bool WriteResponses(Connection& connection);
+		ConnectionMap::iterator CloseConnection(ConnectionMap::iterator connection);
+		void Wake();
+
+		VersionedCorpus& m_Corpus;
+		ServerConfig m_Config;
+		QueryScheduler m_Scheduler;
+		SearchRequest m_Request;
+
+		std::string m_SocketPath;
+		int m_ListenFd = -1;
+		// Stop writes to the pipe to wake up a poll in progress
+		int m_WakeFds[2] = { -1, -1 };
+		std::atomic<bool> m_Stop{ false };
+
+		// Keyed by the scheduler session of the connection
+		ConnectionMap m_Connections;
+		QueryScheduler::SessionId m_NextSession = 1;
+		uint64_t m_RequestCount = 0;
+	};
+
+	// Blocking client of a Server
+	class Client
+	{
+	public:
+		Client() = default;
+		~Client();
+
+		Client(const Client&) = delete;
+		Client& operator=(const Client&) = delete;
+
+		bool Connect(const std::string& socket_path);
+		void Close();
+		bool IsConnected() const { return m_Fd >= 0; }
+
+		// Queues a request, Flush writes all queued requests at once. Fails for patterns longer than Protocol::max_pattern_length.
+		bool Send(const SearchRequest& request);
+		bool Flush();
+		// Waits for the next response
+		bool Receive(SearchResponse& out_response);
+
+	private:
+		int m_Fd = -1;
+		std::vector<uint8_t> m_Output;
+		std::vector<uint8_t> m_Input;
+		size_t m_InputStart = 0;
+	};
+
+} // namespace FuzzySearch
+
+#include "FuzzySearchServer.inl"
@@ -0,0 +1,498 @@
+#include "FuzzySearchServer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FUZZY_SEARCH_SOCKETS 1
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#else
+#define FUZZY_SEARCH_SOCKETS 0
+#endif
+
+namespace FuzzySearch
+{
+#if FUZZY_SEARCH_SOCKETS
+	// Writing to a closed connection reports EPIPE instead of raising SIGPIPE
+#if defined(MSG_NOSIGNAL)
+	constexpr int socket_send_flags = MSG_NOSIGNAL;
+#else
+	constexpr int socket_send_flags = 0;
+#endif
+
+	inline bool SetNonBlocking(int fd)
+	{
+		const int flags = ::fcntl(fd, F_GETFL, 0);
+		return flags >= 0 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+	}
+
+	inline void SetCloseOnExec(int fd)
+	{
+		::fcntl(fd, F_SETFD, FD_CLOEXEC);
+#if defined(SO_NOSIGPIPE)
+		const int enable = 1;
+		::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+#endif
+	}
+
+	inline bool MakeSocketAddress(const std::string& socket_path, sockaddr_un& out_address)
+	{
+		std::memset(&out_address, 0, sizeof(out_address));
+		out_address.sun_family = AF_UNIX;
+		if (socket_path.empty() || socket_path.length() >= sizeof(out_address.sun_path))
+		{
+			return false;
+		}
+		std::memcpy(out_address.sun_path, socket_path.c_str(), socket_path.length() + 1);
+		return true;
+	}
+#endif
+
+	// Drops the consumed front of a stream buffer once it is more than half of it
+	inline void CompactBuffer(std::vector<uint8_t>& buffer, size_t& start)
+	{
+		if (start == buffer.size())
+		{
+			buffer.clear();
+			start = 0;
+		}
+		else if (start > buffer.size() / 2)
+		{
+			buffer.erase(buffer.begin(), buffer.begin() + static_cast<ptrdiff_t>(start));
+			start = 0;
+		}
+	}
+
+	inline Server::Server(VersionedCorpus& corpus, ServerConfig config)
+		: m_Corpus(corpus)
+		, m_Config(config)
+		, m_Scheduler(corpus, config.m_SchedulerConfig)
+	{}
+
+	inline Server::~Server()
+	{
+		m_Scheduler.Stop();
+#if FUZZY_SEARCH_SOCKETS
+		for (auto connection = m_Connections.begin(); connection != m_Connections.end();)
+		{
+			connection = CloseConnection(connection);
+		}
+		if (m_ListenFd >= 0)
+		{
+			::close(m_ListenFd);
+			::unlink(m_SocketPath.c_str());
+		}
+		for (int fd : m_WakeFds)
+		{
+			if (fd >= 0)
+			{
+				::close(fd);
+			}
+		}
+#endif
+	}
+
+	inline bool Server::Listen(const std::string& socket_path)
+	{
+#if FUZZY_SEARCH_SOCKETS
+		sockaddr_un address;
+		if (m_ListenFd >= 0 || !MakeSocketAddress(socket_path, address))
+		{
+			return false;
+		}
+
+		if (::pipe(m_WakeFds) != 0)
+		{
+			return false;
+		}
+		for (int fd : m_WakeFds)
+		{
+			SetNonBlocking(fd);
+			SetCloseOnExec(fd);
+		}
+
+		m_ListenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (m_ListenFd < 0)
+		{
+			return false;
+		}
+		SetCloseOnExec(m_ListenFd);
+
+		::unlink(socket_path.c_str());
+		if (::bind(m_ListenFd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+			|| ::listen(m_ListenFd, SOMAXCONN) != 0
+			|| !SetNonBlocking(m_ListenFd))
+		{
+			::close(m_ListenFd);
+			m_ListenFd = -1;
+			return false;
+		}
+
+		m_SocketPath = socket_path;
+		m_Scheduler.Start([this]() { Wake(); });
+		return true;
+#else
+		(void)socket_path;
+		return false;
+#endif
+	}
+
+	inline bool Server::Poll(std::chrono::milliseconds timeout)
+	{
+#if FUZZY_SEARCH_SOCKETS
+		if (m_Stop || m_ListenFd < 0)
+		{
+			return false;
+		}
+
+		// Wake pipe, listening socket, then one entry per connection in map order
+		std::vector<pollfd> poll_fds;
+		poll_fds.reserve(m_Connections.size() + 2);
+		poll_fds.push_back({ m_WakeFds[0], POLLIN, 0 });
+		poll_fds.push_back({ m_ListenFd, POLLIN, 0 });
+		for (const auto& [session, connection] : m_Connections)
+		{
+			const size_t pending_output = connection.m_Output.size() - connection.m_OutputStart;
+			short events = 0;
+			const bool can_take_requests = pending_output < m_Config.m_MaxPendingOutput && m_Scheduler.PendingCount(session) < m_Config.m_MaxPendingRequests;
+			if (!connection.m_ReadClosed && can_take_requests)
+			{
+				events |= POLLIN;
+			}
+			if (pending_output > 0)
+			{
+				events |= POLLOUT;
+			}
+			poll_fds.push_back({ connection.m_Fd, events, 0 });
+		}
+
+		if (::poll(poll_fds.data(), static_cast<nfds_t>(poll_fds.size()), static_cast<int>(timeout.count())) < 0)
+		{
+			return errno == EINTR;
+		}
+
+		if ((poll_fds[0].revents & POLLIN) != 0)
+		{
+			uint8_t buffer[64];
+			while (::read(m_WakeFds[0], buffer, sizeof(buffer)) > 0)
+			{
+			}
+		}
+		if (m_Stop)
+		{
+			return false;
+		}
+
+		// Read and submit first, so E_SUPERSEDED answers go out with the same write
+		size_t poll_index = 2;
+		for (auto entry = m_Connections.begin(); entry != m_Connections.end(); ++poll_index)
+		{
+			Connection& connection = entry->second;
+			const short revents = poll_fds[poll_index].revents;
+
+			bool keep_open = (revents & POLLNVAL) == 0;
+			if (keep_open && (revents & (POLLIN | POLLHUP | POLLERR)) != 0 && !connection.m_ReadClosed)
+			{
+				keep_open = ReadRequests(connection);
+			}
+			if (keep_open)
+			{
+				// Requests held back by the limits in an earlier poll are picked up here as well
+				keep_open = HandleRequests(entry->first, connection);
+			}
+			entry = keep_open ? std::next(entry) : CloseConnection(entry);
+		}
+
+		m_Scheduler.TakeResponses([this](QueryScheduler::SessionId session, const uint8_t* frame, size_t frame_size)
+		{
+			auto found = m_Connections.find(session);
+			if (found != m_Connections.end())
+			{
+				found->second.m_Output.insert(found->second.m_Output.end(), frame, frame + frame_size);
+			}
+		});
+
+		for (auto entry = m_Connections.begin(); entry != m_Connections.end();)
+		{
+			Connection& connection = entry->second;
+			const bool keep_open = WriteResponses(connection);
+			const bool done = connection.m_ReadClosed && connection.m_OutputStart == connection.m_Output.size() && m_Scheduler.PendingCount(entry->first) == 0;
+			entry = keep_open && !done ? std::next(entry) : CloseConnection(entry);
+		}
+
+		if ((poll_fds[1].revents & POLLIN) != 0)
+		{
+			Accept();
+		}
+		return true;
+#else
+		(void)timeout;
+		return false;
+#endif
+	}
+
+	inline void Server::Run()
+	{
+		while (Poll(std::chrono::milliseconds(-1)))
+		{
+		}
+	}
+
+	inline void Server::Stop()
+	{
+		m_Stop = true;
+		Wake();
+	}
+
+	inline void Server::Wake()
+	{
+#if FUZZY_SEARCH_SOCKETS
+		if (m_WakeFds[1] >= 0)
+		{
+			const uint8_t wake = 1;
+			(void)!::write(m_WakeFds[1], &wake, 1);
+		}
+#endif
+	}
+
+	inline void Server::Accept()
+	{
+#if FUZZY_SEARCH_SOCKETS
+		for (;;)
+		{
+			const int fd = ::accept(m_ListenFd, nullptr, nullptr);
+			if (fd < 0)
+			{
+				return;
+			}
+			SetCloseOnExec(fd);
+			if (!SetNonBlocking(fd))
+			{
+				::close(fd);
+				continue;
+			}
+
+			m_Connections[m_NextSession++].m_Fd = fd;
+		}
+#endif
+	}
+
+	inline bool Server::ReadRequests(Connection& connection)
+	{
+#if FUZZY_SEARCH_SOCKETS
+		constexpr size_t read_size = 64 * 1024;
+		for (;;)
+		{
+			const size_t used = connection.m_Input.size();
+			connection.m_Input.resize(used + read_size);
+			const ssize_t received = ::recv(connection.m_Fd, connection.m_Input.data() + used, read_size, 0);
+			connection.m_Input.resize(used + static_cast<size_t>(std::max<ssize_t>(received, 0)));
+
+			if (received == 0)
+			{
+				// The client is done sending, whatever it sent is still answered
+				connection.m_ReadClosed = true;
+				return true;
+			}
+			if (received < 0)
+			{
+				return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+			}
+			if (static_cast<size_t>(received) < read_size)
+			{
+				return true;
+			}
+		}
+#else
+		(void)connection;
+		return false;
+#endif
+	}
+
+	inline bool Server::HandleRequests(QueryScheduler::SessionId session, Connection& connection)
+	{
+		while (connection.m_Output.size() - connection.m_OutputStart < m_Config.m_MaxPendingOutput
+			&& m_Scheduler.PendingCount(session) < m_Config.m_MaxPendingRequests)
+		{
+			size_t frame_size = 0;
+			const uint8_t* input = connection.m_Input.data() + connection.m_InputStart;
+			const DecodeResult result = DecodeSearchRequest(input, connection.m_Input.size() - connection.m_InputStart, frame_size, m_Request);
+			if (result == DecodeResult::E_INCOMPLETE)
+			{
+				break;
+			}
+			if (result == DecodeResult::E_INVALID_FRAME)
+			{
+				return false;
+			}
+			connection.m_InputStart += frame_size;
+			++m_RequestCount;
+
+			if (result == DecodeResult::E_MALFORMED)
+			{
+				EncodeSearchResponse(m_Request.m_RequestId, ResponseStatus::E_BAD_REQUEST, m_Corpus.Version(), nullptr, CorpusSearchResults(), false, connection.m_Output);
+				continue;
+			}
+			m_Scheduler.Submit(session, m_Request);
+		}
+
+		CompactBuffer(connection.m_Input, connection.m_InputStart);
+		return true;
+	}
+
+	inline bool Server::WriteResponses(Connection& connection)
+	{
+#if FUZZY_SEARCH_SOCKETS
+		while (connection.m_OutputStart < connection.m_Output.size())
+		{
+			const ssize_t sent = ::send(connection.m_Fd, connection.m_Output.data() + connection.m_OutputStart, connection.m_Output.size() - connection.m_OutputStart, socket_send_flags);
+			if (sent < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				return errno == EAGAIN || errno == EWOULDBLOCK;
+			}
+			connection.m_OutputStart += static_cast<size_t>(sent);
+		}
+		CompactBuffer(connection.m_Output, connection.m_OutputStart);
+		return true;
+#else
+		(void)connection;
+		return false;
+#endif
+	}
+
+	inline Server::ConnectionMap::iterator Server::CloseConnection(ConnectionMap::iterator connection)
+	{
+		m_Scheduler.CloseSession(connection->first);
+#if FUZZY_SEARCH_SOCKETS
+		::close(connection->second.m_Fd);
+#endif
+		return m_Connections.erase(connection);
+	}
+
+	inline Client::~Client()
+	{
+		Close();
+	}
+
+	inline bool Client::Connect(const std::string& socket_path)
+	{
+#if FUZZY_SEARCH_SOCKETS
+		Close();
+
+		sockaddr_un address;
+		if (!MakeSocketAddress(socket_path, address))
+		{
+			return false;
+		}
+
+		m_Fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (m_Fd < 0)
+		{
+			return false;
+		}
+		SetCloseOnExec(m_Fd);
+
+		if (::connect(m_Fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+		{
+			Close();
+			return false;
+		}
+		return true;
+#else
+		(void)socket_path;
+		return false;
+#endif
+	}
+
+	inline void Client::Close()
+	{
+#if FUZZY_SEARCH_SOCKETS
+		if (m_Fd >= 0)
+		{
+			::close(m_Fd);
+		}
+#endif
+		m_Fd = -1;
+		m_Output.clear();
+		m_Input.clear();
+		m_InputStart = 0;
+	}
+
+	inline bool Client::Send(const SearchRequest& request)
+	{
+		return EncodeSearchRequest(request, m_Output);
+	}
+
+	inline bool Client::Flush()
+	{
+#if FUZZY_SEARCH_SOCKETS
+		size_t written = 0;
+		while (written < m_Output.size())
+		{
+			const ssize_t sent = ::send(m_Fd, m_Output.data() + written, m_Output.size() - written, socket_send_flags);
+			if (sent < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				return false;
+			}
+			written += static_cast<size_t>(sent);
+		}
+		m_Output.clear();
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	inline bool Client::Receive(SearchResponse& out_response)
+	{
+#if FUZZY_SEARCH_SOCKETS
+		if (m_Fd < 0)
+		{
+			return false;
+		}
+
+		constexpr size_t read_size = 64 * 1024;
+		for (;;)
+		{
+			size_t frame_size = 0;
+			const DecodeResult result = DecodeSearchResponse(m_Input.data() + m_InputStart, m_Input.size() - m_InputStart, frame_size, out_response);
+			if (result == DecodeResult::E_OK)
+			{
+				m_InputStart += frame_size;
+				CompactBuffer(m_Input, m_InputStart);
+				return true;
+			}
+			if (result != DecodeResult::E_INCOMPLETE)
+			{
+				return false;
+			}
+
+			const size_t used = m_Input.size();
+			m_Input.resize(used + read_size);
+			const ssize_t received = ::recv(m_Fd, m_Input.data() + used, read_size, 0);
+			m_Input.resize(used + static_cast<size_t>(std::max<ssize_t>(received, 0)));
+			if (received == 0 || (received < 0 && errno != EINTR))
+			{
+				return false;
+			}
+		}
+#else
+		(void)out_response;
+		return false;
+#endif
+	}
+
+} // namespace FuzzySearch
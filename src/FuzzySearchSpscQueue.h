@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace FuzzySearch
+{
+	enum class QueueResult : uint8_t
+	{
+		E_ITEM,
+		E_TIMEOUT,
+		// The producer closed the queue and every item was taken
+		E_CLOSED
+	};
+
+	/*
+	 * Bounded queue between one producer thread and one consumer thread.
+	 *
+	 * A ring of slots with a head owned by the consumer and a tail owned by the producer, pushing and popping are a
+	 * few atomic operations without locks. Only a side that has to wait, the producer on a full queue or the consumer
+	 * on an empty one, sleeps on a condition variable and is woken by the other side.
+	*/
+	template<typename T>
+	class SpscQueue
+	{
+	public:
+		// The capacity is rounded up to a power of two
+		explicit SpscQueue(size_t capacity);
+
+		SpscQueue(const SpscQueue&) = delete;
+		SpscQueue& operator=(const SpscQueue&) = delete;
+
+		size_t Capacity() const { return m_Slots.size(); }
+
+		// Producer side. Push waits while the queue is full.
+		bool TryPush(T&& value);
+		void Push(T&& value);
+		// No more items will be pushed, the consumer drains the queue and then sees E_CLOSED
+		void Close();
+
+		// Consumer side. Pop waits until an item arrives, the queue is closed or the timeout passed.
+		bool TryPop(T& out_value);
+		QueueResult Pop(T& out_value, std::chrono::milliseconds timeout = std::chrono::milliseconds::max());
+
+	private:
+		void WakeWaiter(std::atomic<bool>& waiting);
+
+		std::vector<T> m_Slots;
+		size_t m_Mask = 0;
+
+		// Next slot to pop, written by the consumer
+		alignas(64) std::atomic<size_t> m_Head{ 0 };
+		// Next slot to push, written by the producer
+		alignas(64) std::atomic<size_t> m_Tail{ 0 };
+
+		alignas(64) std::atomic<bool> m_Closed{ false };
+		std::atomic<bool> m_ProducerWaiting{ false };
+		std::atomic<bool> m_ConsumerWaiting{ false };
+		std::mutex m_WaitMutex;
+		std::condition_variable m_WaitCondition;
+	};
+
+} // namespace FuzzySearch
+
+#include "FuzzySearchSpscQueue.inl"
@@ -0,0 +1,114 @@
+#include "FuzzySearchSpscQueue.h"
+
+namespace FuzzySearch
+{
+	template<typename T>
+	SpscQueue<T>::SpscQueue(size_t capacity)
+	{
+		size_t slot_count = 1;
+		while (slot_count < capacity)
+		{
+			slot_count *= 2;
+		}
+		m_Slots.resize(slot_count);
+		m_Mask = slot_count - 1;
+	}
+
+	template<typename T>
+	bool SpscQueue<T>::TryPush(T&& value)
+	{
+		const size_t tail = m_Tail.load(std::memory_order_relaxed);
+		if (tail - m_Head.load(std::memory_order_acquire) == m_Slots.size())
+		{
+			return false;
+		}
+
+		m_Slots[tail & m_Mask] = std::move(value);
+		// Sequentially consistent so the store cannot pass the load of m_ConsumerWaiting in WakeWaiter
+		m_Tail.store(tail + 1, std::memory_order_seq_cst);
+		WakeWaiter(m_ConsumerWaiting);
+		return true;
+	}
+
+	template<typename T>
+	void SpscQueue<T>::Push(T&& value)
+	{
+		while (!TryPush(std::move(value)))
+		{
+			std::unique_lock<std::mutex> lock(m_WaitMutex);
+			m_ProducerWaiting.store(true, std::memory_order_seq_cst);
+			m_WaitCondition.wait(lock, [this]() { return m_Tail.load(std::memory_order_relaxed) - m_Head.load(std::memory_order_seq_cst) < m_Slots.size(); });
+			m_ProducerWaiting.store(false, std::memory_order_relaxed);
+		}
+	}
+
+	template<typename T>
+	void SpscQueue<T>::Close()
+	{
+		m_Closed.store(true, std::memory_order_seq_cst);
+		WakeWaiter(m_ConsumerWaiting);
+	}
+
+	template<typename T>
+	bool SpscQueue<T>::TryPop(T& out_value)
+	{
+		const size_t head = m_Head.load(std::memory_order_relaxed);
+		if (head == m_Tail.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+
+		out_value = std::move(m_Slots[head & m_Mask]);
+		m_Head.store(head + 1, std::memory_order_seq_cst);
+		WakeWaiter(m_ProducerWaiting);
+		return true;
+	}
+
+	template<typename T>
+	QueueResult SpscQueue<T>::Pop(T& out_value, std::chrono::milliseconds timeout)
+	{
+		using Clock = std::chrono::steady_clock;
+		const bool has_deadline = timeout != std::chrono::milliseconds::max();
+		const Clock::time_point deadline = has_deadline ? Clock::now() + timeout : Clock::time_point::max();
+
+		for (;;)
+		{
+			// Closed is read before trying, an item pushed before Close is never missed
+			const bool closed = m_Closed.load(std::memory_order_seq_cst);
+			if (TryPop(out_value))
+			{
+				return QueueResult::E_ITEM;
+			}
+			if (closed)
+			{
+				return QueueResult::E_CLOSED;
+			}
+
+			std::unique_lock<std::mutex> lock(m_WaitMutex);
+			m_ConsumerWaiting.store(true, std::memory_order_seq_cst);
+			auto ready = [this]()
+			{
+				return m_Closed.load(std::memory_order_seq_cst) || m_Head.load(std::memory_order_relaxed) != m_Tail.load(std::memory_order_seq_cst);
+			};
+			const bool woken = has_deadline ? m_WaitCondition.wait_until(lock, deadline, ready) : (m_WaitCondition.wait(lock, ready), true);
+			m_ConsumerWaiting.store(false, std::memory_order_relaxed);
+			if (!woken)
+			{
+				return QueueResult::E_TIMEOUT;
+			}
+		}
+	}
+
+	template<typename T>
+	void SpscQueue<T>::WakeWaiter(std::atomic<bool>& waiting)
+	{
+		// The waiter sets its flag before checking the queue under the mutex, taking the mutex here means the waiter
+		// either saw the change or is already waiting for the notification
+		if (waiting.load(std::memory_order_seq_cst))
+		{
+			std::lock_guard<std::mutex> lock(m_WaitMutex);
+			m_WaitCondition.notify_all();
+		}
+	}
+
+} // namespace FuzzySearch
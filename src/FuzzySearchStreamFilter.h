@@ -0,0 +1,116 @@
+#pragma once
+
+#include "FuzzySearchCorpus.h"
+#include "FuzzySearchSpscQueue.h"
+#include "FuzzySearchThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace FuzzySearch
+{
+	struct StreamFilterConfig
+	{
+		SearchConfig m_SearchConfig;
+		// Number of best lines kept and reported
+		size_t m_MaxResults { 50 };
+		// Threads of the match stage, 0 uses std::thread::hardware_concurrency
+		size_t m_MatchThreadCount { 0 };
+		// Bytes read at once, every read becomes one batch of lines
+		size_t m_ReadSize { 64 * 1024 };
+		// Batches buffered between two stages, a full queue makes the stage before it wait
+		size_t m_QueueCapacity { 16 };
+		// Minimum time between two progress updates
+		std::chrono::milliseconds m_UpdateInterval { 100 };
+	};
+
+	struct StreamMatch
+	{
+		// Position of the line in the input
+		uint64_t m_Index = 0;
+		int m_Score = 0;
+		std::string m_Line;
+		std::vector<uint16_t> m_Matches;
+	};
+
+	struct StreamStats
+	{
+		uint64_t m_Lines = 0;
+		uint64_t m_Bytes = 0;
+		uint64_t m_Matches = 0;
+		uint64_t m_Updates = 0;
+	};
+
+	/*
+	 * Filters a stream of lines while it is still being read, like fzf --filter but with results before the input ends.
+	 *
+	 * Three stages on their own threads, connected by bounded SpscQueues:
+	 *   read   the caller's read function fills batches and splits them into lines
+	 *   match  every batch is matched on a thread pool, lines that cannot make it into the best results are dropped
+	 *   rank   the calling thread merges the matches into the best m_MaxResults lines and reports them
+	 *
+	 * The rank stage publishes its current cut off, so the match stage only copies lines that would enter the results.
+	 * Results are ordered like Corpus::Search with the input position as id.
+	*/
+	class StreamFilter
+	{
+	public:
+		explicit StreamFilter(const std::string& pattern, StreamFilterConfig config = {});
+
+		// read(buffer, size) returns the number of bytes read into buffer, 0 at the end of the input.
+		// on_update(results, is_final) gets the best lines so far whenever they changed, at most once per update interval,
+		// and once more with is_final set after the input ended.
+		template<typename Read, typename OnUpdate>
+		StreamStats Run(Read&& read, OnUpdate&& on_update);
+
+	private:
+		struct LineBatch
+		{
+			uint64_t m_FirstIndex = 0;
+			std::vector<char> m_Bytes;
+			// End offset of every line in m_Bytes, line breaks are not part of the lines
+			std::vector<size_t> m_LineEnds;
+		};
+
+		struct MatchBatch
+		{
+			std::vector<StreamMatch> m_Matches;
+		};
+
+		// Everything one match thread touches, aligned so threads do not share cache lines
+		struct alignas(64) MatchState
+		{
+			MatchScratch m_Scratch;
+			PatternMatch m_PatternMatch;
+			std::vector<StreamMatch> m_Matches;
+		};
+
+		template<typename Read>
+		void ReadStage(Read& read);
+		void MatchStage();
+		void MatchBatchLines(const LineBatch& batch, MatchBatch& out_batch);
+
+		static uint64_t RankKeyOf(const StreamMatch& match) { return MakeRankKey(match.m_Score, match.m_Line.length()); }
+		static bool CompareMatches(const StreamMatch& lhs, const StreamMatch& rhs);
+
+		StreamFilterConfig m_Config;
+		CompiledPattern m_Pattern;
+		ThreadPool m_ThreadPool;
+		std::vector<MatchState> m_MatchStates;
+
+		SpscQueue<std::unique_ptr<LineBatch>> m_Lines;
+		SpscQueue<std::unique_ptr<MatchBatch>> m_Matched;
+
+		// Rank key of the worst kept line once m_MaxResults lines are kept, lines ranking at or below it are dropped
+		std::atomic<uint64_t> m_CutOffKey{ ~uint64_t(0) };
+		std::atomic<uint64_t> m_LineCount{ 0 };
+		std::atomic<uint64_t> m_ByteCount{ 0 };
+		std::atomic<uint64_t> m_MatchCount{ 0 };
+	};
+
+} // namespace FuzzySearch
+
+#include "FuzzySearchStreamFilter.inl"
@@ -0,0 +1,250 @@
+#include "FuzzySearchStreamFilter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace FuzzySearch
+{
+	inline StreamFilter::StreamFilter(const std::string& pattern, StreamFilterConfig config)
+		: m_Config(config)
+		, m_ThreadPool(config.m_MatchThreadCount)
+		, m_MatchStates(m_ThreadPool.ThreadCount())
+		, m_Lines(config.m_QueueCapacity)
+		, m_Matched(config.m_QueueCapacity)
+	{
+		m_Config.m_MaxResults = std::max<size_t>(m_Config.m_MaxResults, 1);
+		m_Config.m_ReadSize = std::max<size_t>(m_Config.m_ReadSize, 1);
+
+		m_Pattern.Compile(FuzzySearchStringRef<std::string>(pattern));
+		for (MatchState& match_state : m_MatchStates)
+		{
+			match_state.m_Scratch.Prepare(m_Pattern.Length());
+			match_state.m_PatternMatch.m_Matches.reserve(m_Pattern.Length());
+		}
+	}
+
+	template<typename Read, typename OnUpdate>
+	StreamStats StreamFilter::Run(Read&& read, OnUpdate&& on_update)
+	{
+		using Clock = std::chrono::steady_clock;
+
+		std::thread read_thread([this, &read]() { ReadStage(read); });
+		std::thread match_thread([this]() { MatchStage(); });
+
+		StreamStats stats;
+		std::vector<StreamMatch> best;
+		best.reserve(m_Config.m_MaxResults + 1);
+
+		bool changed = false;
+		Clock::time_point last_update = Clock::now() - m_Config.m_UpdateInterval;
+		std::unique_ptr<MatchBatch> batch;
+		for (;;)
+		{
+			// Wait for matches, but not past the time a pending change is due
+			std::chrono::milliseconds timeout = std::chrono::milliseconds::max();
+			if (changed)
+			{
+				const auto since_update = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - last_update);
+				timeout = std::max(m_Config.m_UpdateInterval - since_update, std::chrono::milliseconds(0));
+			}
+
+			const QueueResult result = m_Matched.Pop(batch, timeout);
+			if (result == QueueResult::E_CLOSED)
+			{
+				break;
+			}
+
+			if (result == QueueResult::E_ITEM)
+			{
+				for (StreamMatch& match : batch->m_Matches)
+				{
+					if (best.size() == m_Config.m_MaxResults && !CompareMatches(match, best.back()))
+					{
+						continue;
+					}
+					best.insert(std::upper_bound(best.begin(), best.end(), match, CompareMatches), std::move(match));
+					if (best.size() > m_Config.m_MaxResults)
+					{
+						best.pop_back();
+					}
+					changed = true;
+				}
+
+				// Later lines have higher indexes and lose ties, only strictly better keys can still get in
+				if (best.size() == m_Config.m_MaxResults)
+				{
+					m_CutOffKey.store(RankKeyOf(best.back()), std::memory_order_relaxed);
+				}
+			}
+
+			const Clock::time_point now = Clock::now();
+			if (changed && now - last_update >= m_Config.m_UpdateInterval)
+			{
+				on_update(static_cast<const std::vector<StreamMatch>&>(best), false);
+				++stats.m_Updates;
+				changed = false;
+				last_update = now;
+			}
+		}
+
+		read_thread.join();
+		match_thread.join();
+
+		on_update(static_cast<const std::vector<StreamMatch>&>(best), true);
+		++stats.m_Updates;
+
+		stats.m_Lines = m_LineCount.load();
+		stats.m_Bytes = m_ByteCount.load();
+		stats.m_Matches = m_MatchCount.load();
+		return stats;
+	}
+
+	template<typename Read>
+	void StreamFilter::ReadStage(Read& read)
+	{
+		uint64_t next_index = 0;
+		auto batch = std::make_unique<LineBatch>();
+		for (;;)
+		{
+			// The bytes after the last line break of the previous read are still in the batch
+			const size_t used = batch->m_Bytes.size();
+			batch->m_Bytes.resize(used + m_Config.m_ReadSize);
+			const size_t read_size = read(batch->m_Bytes.data() + used, m_Config.m_ReadSize);
+			batch->m_Bytes.resize(used + read_size);
+			m_ByteCount.fetch_add(read_size, std::memory_order_relaxed);
+
+			const bool end_of_input = read_size == 0;
+			const char* bytes = batch->m_Bytes.data();
+			for (size_t position = used; position < batch->m_Bytes.size();)
+			{
+				const void* line_break = std::memchr(bytes + position, '\n', batch->m_Bytes.size() - position);
+				if (line_break == nullptr)
+				{
+					break;
+				}
+				const size_t line_end = static_cast<const char*>(line_break) - bytes;
+				batch->m_LineEnds.push_back(line_end);
+				position = line_end + 1;
+			}
+
+			const size_t complete_end = batch->m_LineEnds.empty() ? 0 : batch->m_LineEnds.back() + 1;
+			if (end_of_input && complete_end < batch->m_Bytes.size())
+			{
+				// Last line without a line break
+				batch->m_LineEnds.push_back(batch->m_Bytes.size());
+			}
+
+			if (batch->m_LineEnds.empty())
+			{
+				if (end_of_input)
+				{
+					break;
+				}
+				continue;
+			}
+
+			auto next_batch = std::make_unique<LineBatch>();
+			if (complete_end < batch->m_Bytes.size() && !end_of_input)
+			{
+				next_batch->m_Bytes.assign(batch->m_Bytes.begin() + static_cast<ptrdiff_t>(complete_end), batch->m_Bytes.end());
+				batch->m_Bytes.resize(complete_end);
+			}
+
+			batch->m_FirstIndex = next_index;
+			next_index += batch->m_LineEnds.size();
+			m_LineCount.store(next_index, std::memory_order_relaxed);
+			m_Lines.Push(std::move(batch));
+			batch = std::move(next_batch);
+
+			if (end_of_input)
+			{
+				break;
+			}
+		}
+		m_Lines.Close();
+	}
+
+	inline void StreamFilter::MatchStage()
+	{
+		std::unique_ptr<LineBatch> lines;
+		while (m_Lines.Pop(lines) == QueueResult::E_ITEM)
+		{
+			auto matched = std::make_unique<MatchBatch>();
+			MatchBatchLines(*lines, *matched);
+			if (!matched->m_Matches.empty())
+			{
+				m_Matched.Push(std::move(matched));
+			}
+		}
+		m_Matched.Close();
+	}
+
+	inline void StreamFilter::MatchBatchLines(const LineBatch& batch, MatchBatch& out_batch)
+	{
+		constexpr size_t min_lines_per_task = 256;
+		const size_t line_count = batch.m_LineEnds.size();
+		const size_t task_count = std::max<size_t>(std::min(m_MatchStates.size() * 4, line_count / min_lines_per_task), 1);
+		const size_t task_size = (line_count + task_count - 1) / task_count;
+		const uint64_t cut_off_key = m_CutOffKey.load(std::memory_order_relaxed);
+		const SearchConfig search_config = m_Config.m_SearchConfig;
+
+		std::atomic<uint64_t> match_count{ 0 };
+		m_ThreadPool.Run(task_count, [&](size_t task_index, size_t thread_index)
+		{
+			MatchState& match_state = m_MatchStates[thread_index];
+			const size_t begin = std::min(task_index * task_size, line_count);
+			const size_t end = std::min(begin + task_size, line_count);
+
+			uint64_t task_match_count = 0;
+			for (size_t line_index = begin; line_index < end; ++line_index)
+			{
+				const size_t line_start = line_index == 0 ? 0 : batch.m_LineEnds[line_index - 1] + 1;
+				std::string_view line(batch.m_Bytes.data() + line_start, batch.m_LineEnds[line_index] - line_start);
+				if (!line.empty() && line.back() == '\r')
+				{
+					line.remove_suffix(1);
+				}
+				// Same limit as corpus strings, the matched indexes have to fit in 16 bits
+				line = line.substr(0, Corpus::max_string_length);
+
+				const FuzzySearchStringRef<std::string_view> line_ref(line);
+				PatternMatch& pattern_match = match_state.m_PatternMatch;
+				if (!FuzzyMatch(m_Pattern, match_state.m_Scratch, line_ref, FindFilenameStart(line_ref, search_config.m_MatchMode), search_config, pattern_match))
+				{
+					continue;
+				}
+
+				++task_match_count;
+				if (MakeRankKey(pattern_match.m_Score, line.length()) >= cut_off_key)
+				{
+					continue;
+				}
+
+				StreamMatch match;
+				match.m_Index = batch.m_FirstIndex + line_index;
+				match.m_Score = pattern_match.m_Score;
+				match.m_Line.assign(line);
+				match.m_Matches.assign(pattern_match.m_Matches.begin(), pattern_match.m_Matches.end());
+				match_state.m_Matches.push_back(std::move(match));
+			}
+			match_count.fetch_add(task_match_count, std::memory_order_relaxed);
+		});
+		m_MatchCount.fetch_add(match_count.load(), std::memory_order_relaxed);
+
+		// Order within a batch does not matter, the rank stage breaks ties by index
+		for (MatchState& match_state : m_MatchStates)
+		{
+			std::move(match_state.m_Matches.begin(), match_state.m_Matches.end(), std::back_inserter(out_batch.m_Matches));
+			match_state.m_Matches.clear();
+		}
+	}
+
+	inline bool StreamFilter::CompareMatches(const StreamMatch& lhs, const StreamMatch& rhs)
+	{
+		const uint64_t lhs_key = RankKeyOf(lhs);
+		const uint64_t rhs_key = RankKeyOf(rhs);
+		return lhs_key != rhs_key ? lhs_key < rhs_key : lhs.m_Index < rhs.m_Index;
+	}
+
+} // namespace FuzzySearch
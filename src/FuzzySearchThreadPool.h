@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace FuzzySearch
+{
+	/*
+	 * Fixed set of worker threads that run batches of tasks.
+	 *
+	 * The threads are created once and sleep between batches, running a batch does not create threads or allocate.
+	 * The calling thread takes part in every batch as thread 0, so a pool of N threads starts N - 1 workers.
+	*/
+	class ThreadPool
+	{
+	public:
+		// thread_count includes the calling thread, 0 uses std::thread::hardware_concurrency
+		explicit ThreadPool(size_t thread_count = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		size_t ThreadCount() const { return m_Threads.size() + 1; }
+
+		// Calls task(task_index, thread_index) for every task_index in [0, task_count) and returns when all of them finished.
+		// Tasks are handed out in order to whichever thread is free, thread_index is in [0, ThreadCount()).
+		// Only one batch runs at a time, Run is not reentrant.
+		template<typename Task>
+		void Run(size_t task_count, Task&& task);
+
+	private:
+		using TaskFunction = void (*)(void* context, size_t task_index, size_t thread_index);
+
+		void RunBatch(size_t task_count, void* context, TaskFunction function);
+		void RunTasks(size_t thread_index);
+		void WorkerLoop(size_t thread_index);
+
+		std::vector<std::thread> m_Threads;
+
+		std::mutex m_Mutex;
+		std::condition_variable m_WakeCondition;
+		std::condition_variable m_DoneCondition;
+		uint64_t m_Generation = 0;
+		size_t m_ActiveWorkers = 0;
+		bool m_Stop = false;
+
+		void* m_TaskContext = nullptr;
+		TaskFunction m_TaskFunction = nullptr;
+		size_t m_TaskCount = 0;
+		std::atomic<size_t> m_NextTask{ 0 };
+	};
+
+} // namespace FuzzySearch
+
+#include "FuzzySearchThreadPool.inl"
@@ -0,0 +1,115 @@
+#include "FuzzySearchThreadPool.h"
+
+#include <algorithm>
+#include <type_traits>
+
+namespace FuzzySearch
+{
+	inline ThreadPool::ThreadPool(size_t thread_count)
+	{
+		if (thread_count == 0)
+		{
+			thread_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+		}
+
+		m_Threads.reserve(thread_count - 1);
+		for (size_t thread_index = 1; thread_index < thread_count; ++thread_index)
+		{
+			m_Threads.emplace_back([this, thread_index]() { WorkerLoop(thread_index); });
+		}
+	}
+
+	inline ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stop = true;
+		}
+		m_WakeCondition.notify_all();
+
+		for (std::thread& thread : m_Threads)
+		{
+			thread.join();
+		}
+	}
+
+	template<typename Task>
+	void ThreadPool::Run(size_t task_count, Task&& task)
+	{
+		using TaskType = std::remove_reference_t<Task>;
+
+		TaskFunction function = [](void* context, size_t task_index, size_t thread_index)
+		{
+			(*static_cast<TaskType*>(context))(task_index, thread_index);
+		};
+		RunBatch(task_count, const_cast<void*>(static_cast<const void*>(&task)), function);
+	}
+
+	inline void ThreadPool::RunBatch(size_t task_count, void* context, TaskFunction function)
+	{
+		if (task_count == 0)
+		{
+			return;
+		}
+
+		// Nothing to share, skip waking the workers
+		if (task_count == 1 || m_Threads.empty())
+		{
+			for (size_t task_index = 0; task_index < task_count; ++task_index)
+			{
+				function(context, task_index, 0);
+			}
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_TaskContext = context;
+			m_TaskFunction = function;
+			m_TaskCount = task_count;
+			m_NextTask.store(0, std::memory_order_relaxed);
+			m_ActiveWorkers = m_Threads.size();
+			++m_Generation;
+		}
+		m_WakeCondition.notify_all();
+
+		RunTasks(0);
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_DoneCondition.wait(lock, [this]() { return m_ActiveWorkers == 0; });
+	}
+
+	inline void ThreadPool::RunTasks(size_t thread_index)
+	{
+		for (size_t task_index = m_NextTask.fetch_add(1, std::memory_order_relaxed); task_index < m_TaskCount;
+		     task_index = m_NextTask.fetch_add(1, std::memory_order_relaxed))
+		{
+			m_TaskFunction(m_TaskContext, task_index, thread_index);
+		}
+	}
+
+	inline void ThreadPool::WorkerLoop(size_t thread_index)
+	{
+		uint64_t seen_generation = 0;
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		while (true)
+		{
+			m_WakeCondition.wait(lock, [this, seen_generation]() { return m_Stop || m_Generation != seen_generation; });
+			if (m_Stop)
+			{
+				return;
+			}
+			seen_generation = m_Generation;
+
+			lock.unlock();
+			RunTasks(thread_index);
+			lock.lock();
+
+			if (--m_ActiveWorkers == 0)
+			{
+				m_DoneCondition.notify_one();
+			}
+		}
+	}
+
+} // namespace FuzzySearch
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "FuzzySearchCorpus.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace FuzzySearch
+{
+	// Corpus updates recorded to be applied together, see VersionedCorpus::Commit
+	class CorpusBatch
+	{
+	public:
+		void Add(std::string_view str);
+		void Rename(uint32_t id, std::string_view str);
+		void Remove(uint32_t id);
+		void Compact();
+
+		bool Empty() const { return m_Operations.empty(); }
+		size_t Size() const { return m_Operations.size(); }
+		void Clear();
+
+		// Applies the operations in order and appends the ids of the added strings to out_added_ids.
+		// Corpus updates are deterministic, the same batch on the same corpus always assigns the same ids.
+		void ApplyTo(Corpus& corpus, std::vector<uint32_t>* out_added_ids = nullptr) const;
+
+	private:
+		enum class OperationType : uint8_t
+		{
+			E_ADD,
+			E_RENAME,
+			E_REMOVE,
+			E_COMPACT
+		};
+
+		struct Operation
+		{
+			OperationType m_Type = OperationType::E_ADD;
+			uint32_t m_Id = 0;
+			// Slice of m_Bytes with the string of E_ADD and E_RENAME
+			size_t m_Offset = 0;
+			size_t m_Length = 0;
+		};
+
+		void AddOperation(OperationType type, uint32_t id, std::string_view str);
+
+		std::vector<Operation> m_Operations;
+		std::vector<char> m_Bytes;
+	};
+
+	/*
+	 * Corpus that is searched while it is updated.
+	 *
+	 * Every version is an immutable Corpus behind a shared_ptr. A search pins the current version with Acquire and keeps
+	 * using it however many versions are committed meanwhile, a version is freed when its last reader drops it.
+	 *
+	 * Commit applies a batch to a corpus no reader can see and publishes it with one atomic pointer store, readers never
+	 * wait for writers and writers never wait for readers. Writers are serialized by a mutex.
+	 *
+	 * The previous version is kept as a second copy. Once no reader holds it anymore the next commit replays the last
+	 * batch on it and reuses it, so a commit costs the batch twice instead of a copy of the corpus. Only a commit that
+	 * finds the previous version still pinned copies the latest one.
+	*/
+	class VersionedCorpus
+	{
+	public:
+		using Snapshot = std::shared_ptr<const Corpus>;
+
+		explicit VersionedCorpus(CorpusConfig config = {});
+
+		VersionedCorpus(const VersionedCorpus&) = delete;
+		VersionedCorpus& operator=(const VersionedCorpus&) = delete;
+
+		// Current version, stays valid and unchanged as long as the snapshot is held
+		Snapshot Acquire() const;
+		// Number of commits published so far
+		uint64_t Version() const { return m_Version.load(std::memory_order_acquire); }
+
+		// Applies the batch on top of the latest version and publishes the result, returns its version number
+		uint64_t Commit(const CorpusBatch& batch, std::vector<uint32_t>* out_added_ids = nullptr);
+
+		// Commits that had to copy the corpus because a reader still held the previous version
+		size_t CopyCount() const;
+
+	private:
+		mutable std::mutex m_WriteMutex;
+
+		// Only accessed with std::atomic_load and std::atomic_store
+		Snapshot m_Published;
+		// Writer side of the published version and the version before it, which is behind by m_PreviousBatch
+		std::shared_ptr<Corpus> m_Latest;
+		std::shared_ptr<Corpus> m_Previous;
+		CorpusBatch m_PreviousBatch;
+
+		std::atomic<uint64_t> m_Version{ 0 };
+		size_t m_CopyCount = 0;
+	};
+
+} // namespace FuzzySearch
+
+#include "FuzzySearchVersionedCorpus.inl"
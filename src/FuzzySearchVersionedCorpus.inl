@@ -0,0 +1,113 @@
+#include "FuzzySearchVersionedCorpus.h"
+
+namespace FuzzySearch
+{
+	inline void CorpusBatch::Add(std::string_view str)
+	{
+		AddOperation(OperationType::E_ADD, 0, str);
+	}
+
+	inline void CorpusBatch::Rename(uint32_t id, std::string_view str)
+	{
+		AddOperation(OperationType::E_RENAME, id, str);
+	}
+
+	inline void CorpusBatch::Remove(uint32_t id)
+	{
+		AddOperation(OperationType::E_REMOVE, id, {});
+	}
+
+	inline void CorpusBatch::Compact()
+	{
+		AddOperation(OperationType::E_COMPACT, 0, {});
+	}
+
+	inline void CorpusBatch::Clear()
+	{
+		m_Operations.clear();
+		m_Bytes.clear();
+	}
+
+	inline void CorpusBatch::AddOperation(OperationType type, uint32_t id, std::string_view str)
+	{
+		m_Operations.push_back({ type, id, m_Bytes.size(), str.length() });
+		m_Bytes.insert(m_Bytes.end(), str.begin(), str.end());
+	}
+
+	inline void CorpusBatch::ApplyTo(Corpus& corpus, std::vector<uint32_t>* out_added_ids) const
+	{
+		for (const Operation& operation : m_Operations)
+		{
+			const std::string_view str(m_Bytes.data() + operation.m_Offset, operation.m_Length);
+			switch (operation.m_Type)
+			{
+			case OperationType::E_ADD:
+			{
+				const uint32_t id = corpus.Add(str);
+				if (out_added_ids != nullptr)
+				{
+					out_added_ids->push_back(id);
+				}
+				break;
+			}
+			case OperationType::E_RENAME:
+				corpus.Rename(operation.m_Id, str);
+				break;
+			case OperationType::E_REMOVE:
+				corpus.Remove(operation.m_Id);
+				break;
+			case OperationType::E_COMPACT:
+				corpus.Compact();
+				break;
+			}
+		}
+	}
+
+	inline VersionedCorpus::VersionedCorpus(CorpusConfig config)
+		: m_Latest(std::make_shared<Corpus>(config))
+		, m_Previous(std::make_shared<Corpus>(config))
+	{
+		m_Published = m_Latest;
+	}
+
+	inline VersionedCorpus::Snapshot VersionedCorpus::Acquire() const
+	{
+		return std::atomic_load(&m_Published);
+	}
+
+	inline uint64_t VersionedCorpus::Commit(const CorpusBatch& batch, std::vector<uint32_t>* out_added_ids)
+	{
+		std::lock_guard<std::mutex> lock(m_WriteMutex);
+
+		// Readers only ever get the published version, once the previous one is down to our reference nobody can pin it again
+		std::shared_ptr<Corpus> next;
+		if (m_Previous != nullptr && m_Previous.use_count() == 1)
+		{
+			std::atomic_thread_fence(std::memory_order_acquire);
+			next = std::move(m_Previous);
+			m_PreviousBatch.ApplyTo(*next);
+		}
+		else
+		{
+			next = std::make_shared<Corpus>(*m_Latest);
+			m_Previous.reset();
+			++m_CopyCount;
+		}
+
+		batch.ApplyTo(*next, out_added_ids);
+		std::atomic_store(&m_Published, Snapshot(next));
+
+		m_Previous = std::move(m_Latest);
+		m_Latest = std::move(next);
+		m_PreviousBatch = batch;
+
+		return m_Version.fetch_add(1, std::memory_order_acq_rel) + 1;
+	}
+
+	inline size_t VersionedCorpus::CopyCount() const
+	{
+		std::lock_guard<std::mutex> lock(m_WriteMutex);
+		return m_CopyCount;
+	}
+
+} // namespace FuzzySearch
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "FuzzySearchCrawler.h"
+#include "FuzzySearchVersionedCorpus.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace FuzzySearch
+{
+	struct WatcherConfig
+	{
+		// Ignore rules, depth limit and threads for the initial crawl and for directories that show up later
+		CrawlerConfig m_CrawlerConfig;
+		// A burst of events is committed once no event arrived for the quiet period, or the max delay after its first event
+		std::chrono::milliseconds m_QuietPeriod { 50 };
+		std::chrono::milliseconds m_MaxDelay { 500 };
+		// A commit also compacts the corpus when more than this fraction of its string bytes belong to removed strings
+		float m_CompactDeadFraction { 0.25f };
+	};
+
+	/*
+	 * Keeps a VersionedCorpus in sync with directory trees through inotify.
+	 *
+	 * Start crawls the roots, commits them as one version and watches every directory it read. Events are read in
+	 * bursts and coalesced per path, only the last state of a path counts, so a checkout touching 50k files is one
+	 * commit. New directories are crawled and watched, removed directories drop everything below them. When the kernel
+	 * event queue overflows the roots are crawled again and diffed against the corpus.
+	 *
+	 * The watcher has to be the only writer of the corpus, it tracks the id of every path. Only available on Linux,
+	 * Start returns false elsewhere.
+	*/
+	class Watcher
+	{
+	public:
+		explicit Watcher(VersionedCorpus& corpus, WatcherConfig config = {});
+		~Watcher();
+
+		Watcher(const Watcher&) = delete;
+		Watcher& operator=(const Watcher&) = delete;
+
+		bool Start(const std::vector<std::string>& roots);
+
+		// Waits up to timeout for events, reads the whole burst and commits it. Returns the number of corpus changes.
+		size_t Poll(std::chrono::milliseconds timeout);
+
+		// Polls on a background thread until Stop, nothing else may be called on the watcher meanwhile
+		void RunInBackground();
+		void Stop();
+
+		// Id of an indexed path
+		bool FindId(const std::string& path, uint32_t& out_id) const;
+		size_t WatchCount() const { return m_Watches.size(); }
+
+	private:
+		using CrawlDirectory = Crawler::CrawlDirectory;
+
+		enum class ChangeType : uint8_t
+		{
+			E_FILE_ADDED,
+			E_FILE_REMOVED,
+			E_DIRECTORY_ADDED,
+			E_DIRECTORY_REMOVED
+		};
+
+		struct PendingChange
+		{
+			ChangeType m_Type = ChangeType::E_FILE_ADDED;
+			// Where an added directory sits below its root
+			CrawlDirectory m_Directory;
+		};
+
+		static constexpr uint32_t pending_id = ~uint32_t(0);
+
+		void ReadEvents();
+		void RecordChange(const std::string& path, PendingChange change);
+		size_t CommitChanges();
+		size_t Rescan();
+		size_t Commit(CorpusBatch& batch, size_t removed_bytes, const std::vector<std::map<std::string, uint32_t>::iterator>& added);
+
+		void Watch(const CrawlDirectory& directory);
+		// Stops watching the directory and everything below it
+		void Unwatch(const std::string& path);
+
+		VersionedCorpus& m_Corpus;
+		WatcherConfig m_Config;
+		Crawler m_Crawler;
+		std::vector<CrawlDirectory> m_Roots;
+
+		int m_InotifyFd = -1;
+		std::unordered_map<int, CrawlDirectory> m_Watches;
+		std::map<std::string, int> m_WatchedPaths;
+
+		// Ordered so everything below a directory is one range
+		std::map<std::string, uint32_t> m_Ids;
+		std::map<std::string, PendingChange> m_PendingChanges;
+		bool m_NeedsRescan = false;
+
+		std::thread m_Thread;
+		std::atomic<bool> m_Stop{ false };
+	};
+
+} // namespace FuzzySearch
+
+#include "FuzzySearchWatcher.inl"
@@ -0,0 +1,407 @@
+#include "FuzzySearchWatcher.h"
+
+#include <algorithm>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace FuzzySearch
+{
+	// Bytes a path takes up in the corpus, which clips long strings
+	inline size_t StoredLength(const std::string& path)
+	{
+		return std::min<size_t>(path.length(), Corpus::max_string_length);
+	}
+
+	// Entries of a path keyed map below directory, / sorts right before 0
+	template<typename Map>
+	auto EntriesBelow(Map& map, const std::string& directory)
+	{
+		return std::make_pair(map.lower_bound(directory + '/'), map.lower_bound(directory + '0'));
+	}
+
+	inline Watcher::Watcher(VersionedCorpus& corpus, WatcherConfig config)
+		: m_Corpus(corpus)
+		, m_Config(std::move(config))
+		, m_Crawler(m_Config.m_CrawlerConfig)
+	{}
+
+	inline Watcher::~Watcher()
+	{
+		Stop();
+#if defined(__linux__)
+		if (m_InotifyFd >= 0)
+		{
+			::close(m_InotifyFd);
+		}
+#endif
+	}
+
+	inline bool Watcher::Start(const std::vector<std::string>& roots)
+	{
+#if defined(__linux__)
+		m_InotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (m_InotifyFd < 0)
+		{
+			return false;
+		}
+
+		for (const std::string& root : roots)
+		{
+			m_Roots.push_back(Crawler::Root(root));
+		}
+		Rescan();
+		return true;
+#else
+		(void)roots;
+		return false;
+#endif
+	}
+
+	inline size_t Watcher::Poll(std::chrono::milliseconds timeout)
+	{
+#if defined(__linux__)
+		using Clock = std::chrono::steady_clock;
+
+		auto wait_for_events = [this](std::chrono::milliseconds wait_time)
+		{
+			pollfd poll_fd = { m_InotifyFd, POLLIN, 0 };
+			return ::poll(&poll_fd, 1, static_cast<int>(wait_time.count())) > 0;
+		};
+
+		if (m_InotifyFd < 0 || !wait_for_events(timeout))
+		{
+			return 0;
+		}
+
+		// Keep reading while the burst goes on
+		const Clock::time_point deadline = Clock::now() + m_Config.m_MaxDelay;
+		for (;;)
+		{
+			ReadEvents();
+			const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+			if (remaining.count() <= 0 || !wait_for_events(std::min(remaining, m_Config.m_QuietPeriod)))
+			{
+				break;
+			}
+		}
+
+		return CommitChanges();
+#else
+		(void)timeout;
+		return 0;
+#endif
+	}
+
+	inline void Watcher::RunInBackground()
+	{
+		m_Stop = false;
+		m_Thread = std::thread([this]()
+		{
+			while (!m_Stop)
+			{
+				Poll(std::chrono::milliseconds(100));
+			}
+		});
+	}
+
+	inline void Watcher::Stop()
+	{
+		m_Stop = true;
+		if (m_Thread.joinable())
+		{
+			m_Thread.join();
+		}
+	}
+
+	inline bool Watcher::FindId(const std::string& path, uint32_t& out_id) const
+	{
+		auto found = m_Ids.find(path);
+		if (found == m_Ids.end() || found->second == pending_id)
+		{
+			return false;
+		}
+		out_id = found->second;
+		return true;
+	}
+
+	inline void Watcher::ReadEvents()
+	{
+#if defined(__linux__)
+		alignas(alignof(inotify_event)) char buffer[64 * 1024];
+		for (;;)
+		{
+			const ssize_t read_size = ::read(m_InotifyFd, buffer, sizeof(buffer));
+			if (read_size <= 0)
+			{
+				return;
+			}
+
+			for (ssize_t position = 0; position < read_size;)
+			{
+				const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + position);
+				position += sizeof(inotify_event) + event->len;
+
+				if ((event->mask & IN_Q_OVERFLOW) != 0)
+				{
+					m_NeedsRescan = true;
+					continue;
+				}
+
+				auto found = m_Watches.find(event->wd);
+				if (found == m_Watches.end())
+				{
+					continue;
+				}
+
+				if ((event->mask & IN_IGNORED) != 0)
+				{
+					// The directory is gone or was unwatched, its path can be watched again under a new descriptor
+					auto watched = m_WatchedPaths.find(found->second.m_Path);
+					if (watched != m_WatchedPaths.end() && watched->second == event->wd)
+					{
+						m_WatchedPaths.erase(watched);
+					}
+					m_Watches.erase(found);
+					continue;
+				}
+
+				// Events about the watched directory itself are covered by the events of its parent
+				if (event->len == 0)
+				{
+					continue;
+				}
+
+				const CrawlDirectory& parent = found->second;
+				const std::string_view name(event->name);
+				const std::string path = parent.m_Path + (parent.m_Path.back() == '/' ? "" : "/") + std::string(name);
+				const bool is_directory = (event->mask & IN_ISDIR) != 0;
+				if (m_Crawler.IsIgnored(name, std::string_view(path).substr(parent.m_RootLength), is_directory))
+				{
+					continue;
+				}
+
+				PendingChange change;
+				if ((event->mask & (IN_CREATE | IN_MOVED_TO)) != 0)
+				{
+					const int max_depth = m_Config.m_CrawlerConfig.m_MaxDepth;
+					if (is_directory && max_depth >= 0 && parent.m_Depth >= max_depth)
+					{
+						continue;
+					}
+					change.m_Type = is_directory ? ChangeType::E_DIRECTORY_ADDED : ChangeType::E_FILE_ADDED;
+					change.m_Directory = { path, parent.m_RootLength, parent.m_Depth + 1 };
+				}
+				else if ((event->mask & (IN_DELETE | IN_MOVED_FROM)) != 0)
+				{
+					change.m_Type = is_directory ? ChangeType::E_DIRECTORY_REMOVED : ChangeType::E_FILE_REMOVED;
+				}
+				else
+				{
+					continue;
+				}
+				RecordChange(path, std::move(change));
+			}
+		}
+#endif
+	}
+
+	inline void Watcher::RecordChange(const std::string& path, PendingChange change)
+	{
+		if (change.m_Type == ChangeType::E_DIRECTORY_ADDED || change.m_Type == ChangeType::E_DIRECTORY_REMOVED)
+		{
+			// The crawl of an added directory sees its current contents, a removed one takes everything below it along
+			const auto below = EntriesBelow(m_PendingChanges, path);
+			m_PendingChanges.erase(below.first, below.second);
+		}
+		m_PendingChanges[path] = std::move(change);
+	}
+
+	inline size_t Watcher::CommitChanges()
+	{
+		if (m_NeedsRescan)
+		{
+			m_NeedsRescan = false;
+			m_PendingChanges.clear();
+			return Rescan();
+		}
+
+		CorpusBatch batch;
+		size_t removed_bytes = 0;
+		auto remove_id = [&](std::map<std::string, uint32_t>::iterator found)
+		{
+			if (found->second != pending_id)
+			{
+				batch.Remove(found->second);
+				removed_bytes += StoredLength(found->first);
+			}
+			return m_Ids.erase(found);
+		};
+
+		// Removals first, a path can only be added again once its old entry is gone
+		std::vector<CrawlDirectory> added_directories;
+		for (auto& [path, change] : m_PendingChanges)
+		{
+			if (change.m_Type == ChangeType::E_FILE_REMOVED)
+			{
+				auto found = m_Ids.find(path);
+				if (found != m_Ids.end())
+				{
+					remove_id(found);
+				}
+			}
+			else if (change.m_Type == ChangeType::E_DIRECTORY_REMOVED || change.m_Type == ChangeType::E_DIRECTORY_ADDED)
+			{
+				auto below = EntriesBelow(m_Ids, path);
+				for (auto entry = below.first; entry != below.second;)
+				{
+					entry = remove_id(entry);
+				}
+				Unwatch(path);
+
+				if (change.m_Type == ChangeType::E_DIRECTORY_ADDED)
+				{
+					added_directories.push_back(std::move(change.m_Directory));
+				}
+			}
+		}
+
+		std::vector<std::map<std::string, uint32_t>::iterator> added;
+		auto add_path = [&](std::string_view path)
+		{
+			auto [entry, inserted] = m_Ids.emplace(std::string(path), pending_id);
+			if (inserted)
+			{
+				batch.Add(path);
+				added.push_back(entry);
+			}
+		};
+
+		if (!added_directories.empty())
+		{
+			// Each directory is watched before it is listed, files created while the crawl runs show up as events
+			m_Crawler.ForEachFile(added_directories, add_path, [this](const CrawlDirectory& directory) { Watch(directory); });
+		}
+
+		for (const auto& [path, change] : m_PendingChanges)
+		{
+			if (change.m_Type == ChangeType::E_FILE_ADDED)
+			{
+				add_path(path);
+			}
+		}
+		m_PendingChanges.clear();
+
+		return Commit(batch, removed_bytes, added);
+	}
+
+	inline size_t Watcher::Rescan()
+	{
+		std::vector<std::string> paths;
+		m_Crawler.ForEachFile(m_Roots, [&paths](std::string_view path) { paths.emplace_back(path); },
+		                      [this](const CrawlDirectory& directory) { Watch(directory); });
+		std::sort(paths.begin(), paths.end());
+		paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+		// Both sides are sorted, one merge finds what was added and removed
+		CorpusBatch batch;
+		size_t removed_bytes = 0;
+		std::vector<std::map<std::string, uint32_t>::iterator> added;
+		auto entry = m_Ids.begin();
+		for (const std::string& path : paths)
+		{
+			while (entry != m_Ids.end() && entry->first < path)
+			{
+				batch.Remove(entry->second);
+				removed_bytes += StoredLength(entry->first);
+				entry = m_Ids.erase(entry);
+			}
+
+			if (entry != m_Ids.end() && entry->first == path)
+			{
+				++entry;
+				continue;
+			}
+
+			batch.Add(path);
+			added.push_back(m_Ids.emplace_hint(entry, path, pending_id));
+		}
+		while (entry != m_Ids.end())
+		{
+			batch.Remove(entry->second);
+			removed_bytes += StoredLength(entry->first);
+			entry = m_Ids.erase(entry);
+		}
+
+		return Commit(batch, removed_bytes, added);
+	}
+
+	inline size_t Watcher::Commit(CorpusBatch& batch, size_t removed_bytes, const std::vector<std::map<std::string, uint32_t>::iterator>& added)
+	{
+		if (batch.Empty())
+		{
+			return 0;
+		}
+
+		const size_t change_count = batch.Size();
+		const VersionedCorpus::Snapshot snapshot = m_Corpus.Acquire();
+		// Compact leaves the tombstones in place but drops their bytes, so dead bytes tell when compacting pays off again
+		if (static_cast<float>(snapshot->DeadBytes() + removed_bytes) > m_Config.m_CompactDeadFraction * static_cast<float>(snapshot->ByteSize()))
+		{
+			batch.Compact();
+		}
+
+		std::vector<uint32_t> added_ids;
+		added_ids.reserve(added.size());
+		m_Corpus.Commit(batch, &added_ids);
+		for (size_t index = 0; index < added.size(); ++index)
+		{
+			added[index]->second = added_ids[index];
+		}
+		return change_count;
+	}
+
+	inline void Watcher::Watch(const CrawlDirectory& directory)
+	{
+#if defined(__linux__)
+		constexpr uint32_t watch_mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+		const int wd = ::inotify_add_watch(m_InotifyFd, directory.m_Path.c_str(), watch_mask);
+		if (wd >= 0)
+		{
+			m_Watches[wd] = directory;
+			m_WatchedPaths[directory.m_Path] = wd;
+		}
+#else
+		(void)directory;
+#endif
+	}
+
+	inline void Watcher::Unwatch(const std::string& path)
+	{
+		auto remove_watch = [this](std::map<std::string, int>::iterator watched)
+		{
+#if defined(__linux__)
+			// Fails harmlessly when the kernel already dropped the watch of a deleted directory
+			::inotify_rm_watch(m_InotifyFd, watched->second);
+#endif
+			m_Watches.erase(watched->second);
+			return m_WatchedPaths.erase(watched);
+		};
+
+		auto watched = m_WatchedPaths.find(path);
+		if (watched != m_WatchedPaths.end())
+		{
+			remove_watch(watched);
+		}
+
+		auto below = EntriesBelow(m_WatchedPaths, path);
+		for (auto entry = below.first; entry != below.second;)
+		{
+			entry = remove_watch(entry);
+		}
+	}
+
+} // namespace FuzzySearch
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Directory tree in the temp directory that is removed again at the end of the test
+class TemporaryTree
+{
+public:
+	explicit TemporaryTree(const std::vector<std::string>& files)
+		: m_Root((std::filesystem::temp_directory_path() / ("fuzzy_search_test_" + std::to_string(std::random_device{}()))).string())
+	{
+		std::filesystem::create_directories(m_Root);
+		for (const std::string& file : files)
+		{
+			AddFile(file);
+		}
+	}
+
+	~TemporaryTree()
+	{
+		std::error_code error;
+		std::filesystem::remove_all(m_Root, error);
+	}
+
+	const std::string& Root() const { return m_Root; }
+	std::string Path(const std::string& file) const { return m_Root + "/" + file; }
+
+	void AddFile(const std::string& file) const
+	{
+		const std::filesystem::path path = std::filesystem::path(m_Root) / file;
+		std::filesystem::create_directories(path.parent_path());
+		std::ofstream(path.string()) << file;
+	}
+
+private:
+	std::string m_Root;
+};
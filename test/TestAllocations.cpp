@@ -0,0 +1,198 @@
+#include <catch2/catch_all.hpp>
+
+#include <Files.h>
+#include <FuzzySearch.h>
+#include <FuzzySearchSearcher.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// Counting global allocator, every allocation made by this executable goes through here
+static std::atomic<size_t> g_Allocations{ 0 };
+
+static void* CountedAlloc(std::size_t size)
+{
+	++g_Allocations;
+	if (void* ptr = std::malloc(size == 0 ? 1 : size))
+	{
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+static void* CountedAlignedAlloc(std::size_t size, std::align_val_t alignment)
+{
+	++g_Allocations;
+	const std::size_t align = static_cast<std::size_t>(alignment);
+	const std::size_t aligned_size = (size + align - 1) / align * align;
+#if defined(_MSC_VER)
+	void* ptr = _aligned_malloc(aligned_size == 0 ? align : aligned_size, align);
+#else
+	void* ptr = std::aligned_alloc(align, aligned_size == 0 ? align : aligned_size);
+#endif
+	if (ptr != nullptr)
+	{
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+static void CountedAlignedFree(void* ptr)
+{
+#if defined(_MSC_VER)
+	_aligned_free(ptr);
+#else
+	std::free(ptr);
+#endif
+}
+
+void* operator new(std::size_t size) { return CountedAlloc(size); }
+void* operator new[](std::size_t size) { return CountedAlloc(size); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return CountedAlignedAlloc(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return CountedAlignedAlloc(size, alignment); }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { CountedAlignedFree(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { CountedAlignedFree(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { CountedAlignedFree(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { CountedAlignedFree(ptr); }
+
+class AllocationCounter
+{
+public:
+	AllocationCounter()
+		: m_Start(g_Allocations.load())
+	{}
+
+	size_t Count() const { return g_Allocations.load() - m_Start; }
+
+private:
+	size_t m_Start;
+};
+
+static const char* GetStringFunc(const char* string)
+{
+	return string;
+}
+
+using namespace FuzzySearch;
+
+TEST_CASE("FuzzyMatchDoesNotAllocate")
+{
+	SearchConfig config;
+	config.m_MatchMode = MatchMode::E_SOURCE_FILES;
+	config.m_MaxUnmatchedCharactersFromPattern = 2;
+
+	for (const char* pattern_str : { "TABLE", "qt base view list", "q" })
+	{
+		InputPattern<const char*> input_pattern(pattern_str);
+		PatternMatch pattern_match;
+		pattern_match.m_Matches.reserve(input_pattern.m_Pattern.Length());
+
+		size_t matched = 0;
+		AllocationCounter counter;
+		for (const char* file : FuzzySearchBenchmark::FILES)
+		{
+			matched += FuzzyMatch(input_pattern, FuzzySearchStringRef<const char*>(file), config, pattern_match) ? 1 : 0;
+		}
+		const size_t allocations = counter.Count();
+
+		INFO("pattern = " << pattern_str);
+		REQUIRE(matched > 0);
+		REQUIRE(allocations == 0);
+	}
+}
+
+TEST_CASE("SearchAllocations")
+{
+	SearchConfig config;
+	config.m_MatchMode = MatchMode::E_SOURCE_FILES;
+	config.m_MaxUnmatchedCharactersFromPattern = 2;
+
+	for (const char* pattern_str : { "TABLE", "qt base view list" })
+	{
+		AllocationCounter counter;
+		std::vector<SearchResult<const char*>> results =
+		    Search<const char*>(pattern_str, std::begin(FuzzySearchBenchmark::FILES), std::end(FuzzySearchBenchmark::FILES), &GetStringFunc, config);
+		const size_t allocations = counter.Count();
+
+		WARN("pattern = \"" << pattern_str << "\" allocations per Search = " << allocations << " for " << results.size() << " results");
+
+		// One buffer per kept result for its matches, two for the rank keys, the rest is the fixed per query setup
+		const size_t per_query_budget = 8;
+		const size_t rank_key_buffers = 2;
+		REQUIRE(allocations <= results.size() + rank_key_buffers + per_query_budget);
+	}
+}
+
+TEST_CASE("QueryArenaSearchAllocations")
+{
+	SearchConfig config;
+	config.m_MatchMode = MatchMode::E_SOURCE_FILES;
+	config.m_MaxUnmatchedCharactersFromPattern = 2;
+
+	QueryArena arena(4 * 1024 * 1024);
+	for (const char* pattern_str : { "TABLE", "qt base view list" })
+	{
+		size_t result_count = 0;
+		AllocationCounter counter;
+		{
+			const std::pmr::vector<pmr::SearchResult<const char*>> results = Search<const char*>(
+			    pattern_str, std::begin(FuzzySearchBenchmark::FILES), std::end(FuzzySearchBenchmark::FILES), &GetStringFunc, config, arena.Resource());
+			result_count = results.size();
+		}
+		arena.Reset();
+		const size_t allocations = counter.Count();
+
+		WARN("pattern = \"" << pattern_str << "\" heap allocations per arena Search = " << allocations << " for " << result_count << " results");
+
+		// Results and their matches come from the arena, only the fixed per query setup is left on the heap
+		const size_t per_query_budget = 8;
+		REQUIRE(result_count > 0);
+		REQUIRE(allocations <= per_query_budget);
+	}
+}
+
+TEST_CASE("SearcherDoesNotAllocate")
+{
+	SearchConfig config;
+	config.m_MatchMode = MatchMode::E_SOURCE_FILES;
+	config.m_MaxUnmatchedCharactersFromPattern = 2;
+	config.m_OptimalRescoreCount = 10;
+
+	Corpus corpus;
+	for (const char* file : FuzzySearchBenchmark::FILES)
+	{
+		corpus.Add(file);
+	}
+
+	SearcherConfig searcher_config;
+	searcher_config.m_ThreadCount = 4;
+	searcher_config.m_MinStringsPerTask = 256;
+	searcher_config.m_MinResultsPerMergePart = 64;
+
+	Searcher searcher(searcher_config);
+	searcher.SetCorpus(&corpus);
+
+	for (const std::string pattern_str : { "TABLE", "qt base view list", "q" })
+	{
+		for (size_t max_results : { 0, 20 })
+		{
+			// The first search grows the buffers, the same query again has to fit in them
+			const size_t expected_count = searcher.Search(pattern_str, config, max_results).size();
+
+			AllocationCounter counter;
+			const size_t result_count = searcher.Search(pattern_str, config, max_results).size();
+			const size_t allocations = counter.Count();
+
+			INFO("pattern = " << pattern_str << " max_results = " << max_results);
+			REQUIRE(result_count == expected_count);
+			REQUIRE(result_count > 0);
+			REQUIRE(allocations == 0);
+		}
+	}
+}
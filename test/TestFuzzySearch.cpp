@@ -179,3 +179,194 @@ TEST_CASE("Strings")
 		REQUIRE(std::vector({4, 5, 6, 7, 8}) == results[0].m_PatternMatch.m_Matches);
 	}
 }
+
+TEST_CASE("CharacterClasses")
+{
+	SearchConfig config;
+	config.m_MatchMode = MatchMode::E_FILENAMES;
+
+	// Digits and punctuation are neither lower nor upper case, only a lower case letter before 'B' makes it camel case
+	std::vector<std::string> files = { "e:/src/vec3Base.h", "e:/src/vec.Base.h", "e:/src/vecxBase.h" };
+	std::vector<SearchResult<std::string>> results = Search(std::string("base"), files.begin(), files.end(), &GetStringFunc, config);
+	REQUIRE(results.size() == 3);
+	REQUIRE("e:/src/vecxBase.h" == results[0].m_String);
+	REQUIRE(results[0].m_PatternMatch.m_Score > results[1].m_PatternMatch.m_Score);
+	REQUIRE(results[1].m_PatternMatch.m_Score == results[2].m_PatternMatch.m_Score);
+}
+
+TEST_CASE("CompiledPattern")
+{
+	const std::string pattern_str = "hierarchy node base";
+	const CompiledPattern pattern{ FuzzySearchStringRef<std::string>(pattern_str) };
+
+	REQUIRE(pattern.Length() == 19);
+	REQUIRE(pattern.Tokens().size() == 3);
+	REQUIRE(pattern.Tokens()[1].m_Start == 10);
+	REQUIRE(pattern.Tokens()[1].m_Length == 4);
+	REQUIRE(pattern.CalculateWholeWordMatch(10, 4) > 0);
+	REQUIRE(pattern.CalculateWholeWordMatch(10, 3) == 0);
+
+	SECTION("shared between scratches")
+	{
+		const std::string file = "e:/libs/nodehierarchy/main/source/BaseHierarchyNode.cpp";
+
+		SearchConfig config;
+		config.m_MatchMode = MatchMode::E_SOURCE_FILES;
+
+		MatchScratch first_scratch;
+		MatchScratch second_scratch;
+		PatternMatch first_match;
+		PatternMatch second_match;
+		REQUIRE(FuzzyMatch(pattern, first_scratch, FuzzySearchStringRef<std::string>(file), config, first_match));
+		REQUIRE(FuzzyMatch(pattern, second_scratch, FuzzySearchStringRef<std::string>(file), config, second_match));
+		REQUIRE(first_match.m_Score == second_match.m_Score);
+		REQUIRE(std::vector({38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 34, 35, 36, 37}) == first_match.m_Matches);
+		REQUIRE(first_match.m_Matches == second_match.m_Matches);
+	}
+}
+
+TEST_CASE("OptimalMatch")
+{
+	std::vector<std::string> files = {
+	    "e:/libs/nodehierarchy/main/source/BaseEntityNode.cpp",
+	    "e:/libs/nodehierarchy/main/source/BaseHierarchyNodeLoader.cpp",
+	    "e:/libs/nodehierarchy/main/source/BaseObjectNode.cpp",
+	    "e:/libs/nodehierarchy/main/source/CMakeLists.txt",
+	    "e:/libs/otherlib/main/source/no_extension",
+	};
+
+	SearchConfig config;
+	config.m_MatchMode = MatchMode::E_FILENAMES;
+	config.m_MaxUnmatchedCharactersFromPattern = 2;
+
+	SECTION("never scores lower than FuzzyMatch")
+	{
+		for (const char* pattern_str : { "nhl", "bhn", "node loader", "hierarchy node base", "cmakelists" })
+		{
+			InputPattern<std::string> input_pattern{ std::string(pattern_str) };
+			for (const std::string& file : files)
+			{
+				PatternMatch greedy_match;
+				PatternMatch optimal_match;
+				const bool greedy_matched = FuzzyMatch(input_pattern, FuzzySearchStringRef<std::string>(file), config, greedy_match);
+				const bool optimal_matched = OptimalMatch(input_pattern, FuzzySearchStringRef<std::string>(file), config, optimal_match);
+				REQUIRE(optimal_matched >= greedy_matched);
+				REQUIRE(optimal_match.m_Score >= greedy_match.m_Score);
+			}
+		}
+	}
+
+	SECTION("search string = nhl")
+	{
+		std::vector<SearchResult<std::string>> results = Search(std::string("nhl"), files.begin(), files.end(), &GetStringFunc, config);
+		REQUIRE("e:/libs/nodehierarchy/main/source/BaseHierarchyNodeLoader.cpp" == results[0].m_String);
+		REQUIRE(std::vector({47, 51}) == results[0].m_PatternMatch.m_Matches);
+
+		// The greedy pass commits to "Node" and misses the n-H-L acronym
+		config.m_OptimalRescoreCount = 3;
+		results = Search(std::string("nhl"), files.begin(), files.end(), &GetStringFunc, config);
+		REQUIRE("e:/libs/nodehierarchy/main/source/BaseHierarchyNodeLoader.cpp" == results[0].m_String);
+		REQUIRE(std::vector({8, 38, 51}) == results[0].m_PatternMatch.m_Matches);
+		for (size_t index = 1; index < results.size(); ++index)
+		{
+			REQUIRE(results[index - 1].m_PatternMatch.m_Score >= results[index].m_PatternMatch.m_Score);
+		}
+	}
+}
+
+TEST_CASE("RankKeys")
+{
+	REQUIRE(MakeRankKey(10, 5) < MakeRankKey(9, 1));
+	REQUIRE(MakeRankKey(-1, 5) < MakeRankKey(-2, 1));
+	REQUIRE(MakeRankKey(3, 4) < MakeRankKey(3, 5));
+	REQUIRE(ReplaceRankKeyScore(MakeRankKey(1, 7), 20) == MakeRankKey(20, 7));
+
+	// Enough keys for the radix path, few distinct values so there are plenty of ties
+	for (size_t count : { 10, 5000 })
+	{
+		std::vector<RankKey> keys;
+		uint32_t state = 12345;
+		for (uint32_t index = 0; index < count; ++index)
+		{
+			state = state * 1664525u + 1013904223u;
+			const int score = static_cast<int>(state >> 24) - 128;
+			keys.push_back({ MakeRankKey(score, (state >> 8) & 0x7), index });
+		}
+
+		std::vector<RankKey> expected = keys;
+		std::stable_sort(expected.begin(), expected.end(), [](const RankKey& lhs, const RankKey& rhs) { return lhs.m_Key < rhs.m_Key; });
+
+		std::vector<RankKey> buffer;
+		SortRankKeys(keys, buffer);
+
+		REQUIRE(keys.size() == expected.size());
+		for (size_t index = 0; index < keys.size(); ++index)
+		{
+			REQUIRE(keys[index].m_Key == expected[index].m_Key);
+			REQUIRE(keys[index].m_Index == expected[index].m_Index);
+		}
+	}
+}
+
+TEST_CASE("QueryArena")
+{
+	std::vector<std::string> files = {
+	    "e:/libs/nodehierarchy/main/source/BaseEntityNode.cpp",
+	    "e:/libs/nodehierarchy/main/source/BaseHierarchyNodeLoader.cpp",
+	    "e:/libs/nodehierarchy/main/source/BaseObjectNode.cpp",
+	    "e:/libs/nodehierarchy/main/source/CMakeLists.txt",
+	    "e:/libs/otherlib/main/source/no_extension",
+	};
+
+	SearchConfig config;
+	config.m_MatchMode = MatchMode::E_FILENAMES;
+	config.m_OptimalRescoreCount = 2;
+
+	// Small buffer so the second query also has to go past it
+	QueryArena arena(256);
+	for (const char* pattern_str : { "nhl", "base node", "zzz" })
+	{
+		INFO("pattern = " << pattern_str);
+		{
+			const std::vector<SearchResult<std::string>> expected = Search(std::string(pattern_str), files.begin(), files.end(), &GetStringFunc, config);
+			const std::pmr::vector<pmr::SearchResult<std::string>> results =
+			    Search(std::string(pattern_str), files.begin(), files.end(), &GetStringFunc, config, arena.Resource());
+
+			REQUIRE(results.size() == expected.size());
+			for (size_t index = 0; index < results.size(); ++index)
+			{
+				REQUIRE(results[index].m_String == expected[index].m_String);
+				REQUIRE(results[index].m_PatternMatch.m_Score == expected[index].m_PatternMatch.m_Score);
+				REQUIRE(std::equal(results[index].m_PatternMatch.m_Matches.begin(), results[index].m_PatternMatch.m_Matches.end(),
+				                   expected[index].m_PatternMatch.m_Matches.begin(), expected[index].m_PatternMatch.m_Matches.end()));
+				REQUIRE(results[index].m_PatternMatch.m_Matches.get_allocator().resource() == &arena.Resource());
+			}
+		}
+		arena.Reset();
+	}
+}
+
+#if FUZZY_SEARCH_STATS
+TEST_CASE("SearchStats")
+{
+	std::vector<std::string> files = {
+	    "e:/libs/nodehierarchy/main/source/BaseEntityNode.cpp",
+	    "e:/libs/nodehierarchy/main/source/BaseHierarchyNode.cpp",
+	    "e:/libs/nodehierarchy/main/source/CMakeLists.txt",
+	    "e:/libs/otherlib/main/source/no_extension",
+	};
+
+	SearchConfig config;
+	config.m_MatchMode = MatchMode::E_FILENAMES;
+	config.m_MaxUnmatchedCharactersFromPattern = 0;
+
+	SearchStats stats;
+	std::vector<SearchResult<std::string>> results = Search(std::string("hierarchynode"), files.begin(), files.end(), &GetStringFunc, config, &stats);
+	REQUIRE(stats.m_EntriesScanned == files.size());
+	REQUIRE(stats.m_FuzzyMatchCalls == files.size());
+	REQUIRE(stats.m_ResultsKept == results.size());
+	REQUIRE(stats.m_SequentialMatchCalls > 0);
+	REQUIRE(stats.m_EntriesRejectedEarly > 0);
+	REQUIRE(stats.m_EntriesRejectedEarly + stats.m_ResultsKept <= stats.m_EntriesScanned);
+}
+#endif
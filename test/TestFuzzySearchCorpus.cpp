@@ -0,0 +1,314 @@
+#include <catch2/catch_all.hpp>
+
+#include <FuzzySearchCorpus.h>
+
+using namespace FuzzySearch;
+
+static const std::vector<std::string>& CorpusFiles()
+{
+	static const std::vector<std::string> files = {
+	    "e:/libs/nodehierarchy/main/source/BaseEntityNode.cpp",
+	    "e:/libs/nodehierarchy/main/source/BaseEntityNode.h",
+	    "e:/libs/nodehierarchy/main/source/BaseHierarchyNodeLoader.cpp",
+	    "e:/libs/nodehierarchy/main/source/BaseHierarchyNodeLoader.h",
+	    "e:/libs/nodehierarchy/main/source/BaseHierarchyNode.cpp",
+	    "e:/libs/nodehierarchy/main/source/BaseHierarchyNode.h",
+	    "e:/libs/nodehierarchy/main/source/BaseObjectNode.cpp",
+	    "e:/libs/nodehierarchy/main/source/BaseObjectNode.h",
+	    "e:/libs/nodehierarchy/main/source/CMakeLists.txt",
+	    "e:/libs/otherlib/main/source/CMakeLists.txt",
+	    "e:/libs/otherlib/main/source/no_extension",
+	};
+	return files;
+}
+
+static bool SameMatches(MatchSpan lhs, MatchSpan rhs)
+{
+	return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+}
+
+template<typename Matches>
+static bool SameMatches(MatchSpan lhs, const Matches& rhs)
+{
+	return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](uint16_t lhs_index, int rhs_index) { return lhs_index == rhs_index; });
+}
+
+static void RequireSameResults(const CorpusSearchResults& lhs, const CorpusSearchResults& rhs)
+{
+	REQUIRE(lhs.size() == rhs.size());
+	for (size_t index = 0; index < lhs.size(); ++index)
+	{
+		REQUIRE(lhs[index].m_Id == rhs[index].m_Id);
+		REQUIRE(lhs[index].m_Score == rhs[index].m_Score);
+		REQUIRE(SameMatches(lhs.Matches(index), rhs.Matches(index)));
+	}
+}
+
+TEST_CASE("Corpus")
+{
+	SearchConfig search_config;
+	search_config.m_MatchMode = MatchMode::E_SOURCE_FILES;
+
+	Corpus corpus;
+	for (const std::string& file : CorpusFiles())
+	{
+		corpus.Add(file);
+	}
+
+	SECTION("same order as Search")
+	{
+		const std::vector<std::string>& files = CorpusFiles();
+		std::vector<SearchResult<std::string>> expected =
+		    Search(std::string("bhn"), files.begin(), files.end(), [](const std::string& str) -> const std::string& { return str; }, search_config);
+		CorpusSearchResults results = corpus.Search("bhn", search_config);
+
+		REQUIRE(results.size() == expected.size());
+		for (size_t index = 0; index < results.size(); ++index)
+		{
+			REQUIRE(corpus.Get(results[index].m_Id) == expected[index].m_String);
+			REQUIRE(results[index].m_Score == expected[index].m_PatternMatch.m_Score);
+			REQUIRE(SameMatches(results.Matches(index), expected[index].m_PatternMatch.m_Matches));
+		}
+
+		REQUIRE(corpus.Search("bhn", search_config, 2).size() == 2);
+
+		// Ranking all results and picking the best few have to agree
+		const CorpusSearchResults all_results = corpus.Search("bn", search_config);
+		CorpusSearchResults head_results = corpus.Search("bn", search_config, all_results.size() - 1);
+		REQUIRE(head_results.size() == all_results.size() - 1);
+		for (size_t index = 0; index < head_results.size(); ++index)
+		{
+			REQUIRE(head_results[index].m_Id == all_results[index].m_Id);
+			REQUIRE(SameMatches(head_results.Matches(index), all_results.Matches(index)));
+		}
+	}
+
+	SECTION("result set")
+	{
+		CorpusSearchResults results;
+		PatternMatch pattern_match;
+		pattern_match.m_Score = 10;
+		pattern_match.m_Matches = { 1, 2, 3 };
+		results.Append(4, pattern_match);
+		pattern_match.m_Score = 20;
+		pattern_match.m_Matches = { 5 };
+		results.Append(7, pattern_match);
+
+		pattern_match.m_Score = 30;
+		pattern_match.m_Matches = { 8, 9 };
+		results.SetMatch(0, pattern_match);
+		std::swap(*results.begin(), *(results.begin() + 1));
+		results.Compact();
+
+		REQUIRE(results.size() == 2);
+		REQUIRE(results[0].m_Id == 7);
+		REQUIRE(results[1].m_Score == 30);
+		REQUIRE(SameMatches(results.Matches(0), std::vector<int>{ 5 }));
+		REQUIRE(SameMatches(results.Matches(1), std::vector<int>{ 8, 9 }));
+		REQUIRE(results[1].m_MatchOffset == 1);
+
+		results.Truncate(1);
+		REQUIRE(results.size() == 1);
+		results.Clear();
+		REQUIRE(results.empty());
+	}
+
+	SECTION("folded copy")
+	{
+		CorpusConfig config;
+		config.m_KeepFoldedCopy = true;
+
+		Corpus folded_corpus(config);
+		for (const std::string& file : CorpusFiles())
+		{
+			folded_corpus.Add(file);
+		}
+
+		for (MatchMode match_mode : { MatchMode::E_STRINGS, MatchMode::E_FILENAMES, MatchMode::E_SOURCE_FILES })
+		{
+			SearchConfig mode_config;
+			mode_config.m_MatchMode = match_mode;
+			for (const char* pattern_str : { "bhn", "BHNL", "hierarchy node base", "cmakelists node", "no_ext", "zzz" })
+			{
+				INFO("pattern = " << pattern_str);
+				RequireSameResults(corpus.Search(pattern_str, mode_config), folded_corpus.Search(pattern_str, mode_config));
+			}
+		}
+	}
+
+	SECTION("transposed blocks")
+	{
+		CorpusConfig config;
+		config.m_TransposedBlocks = true;
+
+		// Partial blocks, blocks of mixed lengths and strings longer than the transposed rows
+		Corpus plain_corpus;
+		Corpus block_corpus(config);
+		for (int index = 0; index < 40; ++index)
+		{
+			for (const std::string& file : CorpusFiles())
+			{
+				const std::string str = index % 7 == 0 ? file + std::string(150, 'x') + std::to_string(index) : file.substr(index % 5);
+				plain_corpus.Add(str);
+				block_corpus.Add(str);
+			}
+		}
+
+		for (int max_unmatched : { 0, 1, 2 })
+		{
+			for (MatchMode match_mode : { MatchMode::E_STRINGS, MatchMode::E_SOURCE_FILES })
+			{
+				SearchConfig mode_config;
+				mode_config.m_MatchMode = match_mode;
+				mode_config.m_MaxUnmatchedCharactersFromPattern = max_unmatched;
+				for (const char* pattern_str : { "bhn", "BHNL", "hierarchy node base", "cmakelists node", "no_ext", "xxq", "zzz", "abcdefghijklmnop" })
+				{
+					INFO("pattern = " << pattern_str << " max_unmatched = " << max_unmatched);
+					RequireSameResults(plain_corpus.Search(pattern_str, mode_config), block_corpus.Search(pattern_str, mode_config));
+				}
+			}
+		}
+	}
+
+	SECTION("block summaries")
+	{
+		CorpusConfig config;
+		config.m_BlockSummaries = true;
+		CorpusConfig both_config = config;
+		both_config.m_TransposedBlocks = true;
+
+		// Clustered directories so whole blocks lack some pattern characters, plus short strings for the length bound
+		Corpus plain_corpus;
+		Corpus summary_corpus(config);
+		Corpus both_corpus(both_config);
+		for (int index = 0; index < 1000; ++index)
+		{
+			const std::string& file = CorpusFiles()[index / 100 % CorpusFiles().size()];
+			const std::string str = index % 9 == 0 ? file.substr(file.length() - 3) : file + std::to_string(index);
+			plain_corpus.Add(str);
+			summary_corpus.Add(str);
+			both_corpus.Add(str);
+		}
+
+		for (int max_unmatched : { 0, 1, 2 })
+		{
+			SearchConfig mode_config;
+			mode_config.m_MatchMode = MatchMode::E_SOURCE_FILES;
+			mode_config.m_MaxUnmatchedCharactersFromPattern = max_unmatched;
+			for (const char* pattern_str : { "bhn", "BHNL", "hierarchy node base", "cmakelists node", "no_ext", "otherlib txt", "ext 99", "zzz", "a b" })
+			{
+				INFO("pattern = " << pattern_str << " max_unmatched = " << max_unmatched);
+				const CorpusSearchResults expected = plain_corpus.Search(pattern_str, mode_config);
+				RequireSameResults(expected, summary_corpus.Search(pattern_str, mode_config));
+				RequireSameResults(expected, both_corpus.Search(pattern_str, mode_config));
+			}
+		}
+	}
+
+	SECTION("updates")
+	{
+		CorpusConfig config;
+		config.m_KeepFoldedCopy = true;
+		config.m_TransposedBlocks = true;
+		config.m_BlockSummaries = true;
+
+		// Expected strings by id, empty when removed
+		Corpus updated_corpus(config);
+		std::vector<std::string> expected_strings;
+		for (int index = 0; index < 600; ++index)
+		{
+			const std::string& file = CorpusFiles()[index % CorpusFiles().size()];
+			expected_strings.push_back(file + std::to_string(index));
+			REQUIRE(updated_corpus.Add(expected_strings.back()) == static_cast<uint32_t>(index));
+		}
+
+		auto require_same_as_fresh_corpus = [&]()
+		{
+			// Ids keep their order in a freshly built corpus, so ties are broken the same way
+			Corpus fresh_corpus;
+			for (const std::string& str : expected_strings)
+			{
+				if (!str.empty())
+				{
+					fresh_corpus.Add(str);
+				}
+			}
+
+			for (const char* pattern_str : { "bhn", "hierarchy node base", "cmakelists 12", "renamed", "no_ext 5" })
+			{
+				INFO("pattern = " << pattern_str);
+				const CorpusSearchResults expected = fresh_corpus.Search(pattern_str, search_config);
+				const CorpusSearchResults results = updated_corpus.Search(pattern_str, search_config);
+				REQUIRE(results.size() == expected.size());
+				for (size_t index = 0; index < results.size(); ++index)
+				{
+					REQUIRE(updated_corpus.Get(results[index].m_Id) == fresh_corpus.Get(expected[index].m_Id));
+					REQUIRE(results[index].m_Score == expected[index].m_Score);
+					REQUIRE(SameMatches(results.Matches(index), expected.Matches(index)));
+				}
+			}
+		};
+
+		for (uint32_t id = 0; id < 600; id += 3)
+		{
+			updated_corpus.Remove(id);
+			expected_strings[id].clear();
+		}
+		for (uint32_t id = 1; id < 600; id += 7)
+		{
+			if (updated_corpus.IsRemoved(id))
+			{
+				continue;
+			}
+
+			// Some longer than the transposed rows of their block
+			expected_strings[id] = "renamed/" + std::string(id % 2 == 0 ? 200 : 10, 'r') + expected_strings[id];
+			updated_corpus.Rename(id, expected_strings[id]);
+		}
+
+		REQUIRE(updated_corpus.RemovedCount() == 200);
+		REQUIRE(updated_corpus.IsRemoved(3));
+		REQUIRE(updated_corpus.Get(3).empty());
+		REQUIRE(updated_corpus.DeadBytes() > 0);
+		require_same_as_fresh_corpus();
+
+		updated_corpus.Compact();
+		REQUIRE(updated_corpus.DeadBytes() == 0);
+		REQUIRE(updated_corpus.Get(1) == expected_strings[1]);
+		require_same_as_fresh_corpus();
+
+		// Tombstoned ids are reused smallest first after the compaction
+		REQUIRE(updated_corpus.Add("e:/new/BaseHierarchyNode.cpp") == 0);
+		expected_strings[0] = "e:/new/BaseHierarchyNode.cpp";
+		REQUIRE(updated_corpus.RemovedCount() == 199);
+		require_same_as_fresh_corpus();
+	}
+
+	SECTION("short query tables")
+	{
+		CorpusConfig config;
+		config.m_SearchConfig = search_config;
+		config.m_PrecomputeShortQueries = true;
+		config.m_ShortQueryResultCount = 3;
+		config.m_BigramTableSize = 8;
+
+		Corpus indexed_corpus(config);
+		for (const std::string& file : CorpusFiles())
+		{
+			indexed_corpus.Add(file);
+		}
+		indexed_corpus.BuildShortQueryTables();
+
+		for (const char* pattern_str : { "b", "B", "n", "/", ".", "z", "ba", "no", "in", "so", "qq" })
+		{
+			INFO("pattern = " << pattern_str);
+			RequireSameResults(corpus.Search(pattern_str, search_config, 3), indexed_corpus.Search(pattern_str, search_config, 3));
+			RequireSameResults(corpus.Search(pattern_str, search_config, 1), indexed_corpus.Search(pattern_str, search_config, 1));
+			RequireSameResults(corpus.Search(pattern_str, search_config), indexed_corpus.Search(pattern_str, search_config));
+		}
+
+		// Adding invalidates the tables, the new string has to show up
+		const uint32_t id = indexed_corpus.Add("e:/B");
+		REQUIRE(indexed_corpus.Search("b", search_config, 1)[0].m_Id == id);
+	}
+}
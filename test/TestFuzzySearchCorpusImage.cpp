@@ -0,0 +1,245 @@
+#include <catch2/catch_all.hpp>
+
+#include <FuzzySearchCorpusImage.h>
+#include <FuzzySearchSearcher.h>
+
+#include "TemporaryTree.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+using namespace FuzzySearch;
+
+namespace
+{
+	void RequireSameResults(const CorpusSearchResults& expected, const CorpusSearchResults& results)
+	{
+		REQUIRE(results.size() == expected.size());
+		for (size_t index = 0; index < results.size(); ++index)
+		{
+			REQUIRE(results[index].m_Id == expected[index].m_Id);
+			REQUIRE(results[index].m_Score == expected[index].m_Score);
+			REQUIRE(std::equal(results.Matches(index).begin(), results.Matches(index).end(), expected.Matches(index).begin(), expected.Matches(index).end()));
+		}
+	}
+
+	void RequireSameCorpus(const Corpus& expected, const Corpus& corpus)
+	{
+		REQUIRE(corpus.Size() == expected.Size());
+		REQUIRE(corpus.RemovedCount() == expected.RemovedCount());
+		REQUIRE(corpus.DeadBytes() == expected.DeadBytes());
+		REQUIRE(corpus.ByteSize() == expected.ByteSize());
+		for (uint32_t id = 0; id < static_cast<uint32_t>(expected.Size()); ++id)
+		{
+			REQUIRE(corpus.Get(id) == expected.Get(id));
+			REQUIRE(corpus.IsRemoved(id) == expected.IsRemoved(id));
+			REQUIRE(corpus.FilenameStart(id) == expected.FilenameStart(id));
+		}
+
+		for (const char* pattern : { "corpus image", "module12", "src", "inl", "zzz" })
+		{
+			RequireSameResults(expected.Search(pattern, expected.Config().m_SearchConfig), corpus.Search(pattern, expected.Config().m_SearchConfig));
+			RequireSameResults(expected.Search(pattern, SearchConfig{}, 10), corpus.Search(pattern, SearchConfig{}, 10));
+		}
+	}
+
+	std::vector<uint8_t> ReadFile(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		return { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+	}
+
+	void WriteFile(const std::string& path, const std::vector<uint8_t>& bytes)
+	{
+		std::ofstream(path, std::ios::binary | std::ios::trunc).write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	}
+
+	uint64_t ReadUint64(const std::vector<uint8_t>& bytes, size_t offset)
+	{
+		uint64_t value = 0;
+		std::memcpy(&value, bytes.data() + offset, sizeof(value));
+		return value;
+	}
+}
+
+TEST_CASE("CorpusImage")
+{
+	TemporaryTree tree({});
+	const std::string image_path = tree.Path("corpus.image");
+
+	CorpusConfig config;
+	config.m_SearchConfig.m_MatchMode = MatchMode::E_SOURCE_FILES;
+	config.m_KeepFoldedCopy = true;
+	config.m_TransposedBlocks = true;
+	config.m_BlockSummaries = true;
+
+	Corpus corpus(config);
+	for (int index = 0; index < 2000; ++index)
+	{
+		corpus.Add("src/module" + std::to_string(index % 37) + "/FuzzySearchCorpusImage" + std::to_string(index) + (index % 2 == 0 ? ".inl" : ".h"));
+	}
+	// Free ids from removing before a compact, tombstones and dead bytes from removing and renaming after it
+	for (uint32_t id = 0; id < 2000; id += 7)
+	{
+		corpus.Remove(id);
+	}
+	corpus.Compact();
+	for (uint32_t id = 3; id < 2000; id += 11)
+	{
+		corpus.Remove(id);
+	}
+	corpus.Rename(5, "src/renamed/CorpusImageRenamed.h");
+
+	SECTION("attached corpus searches like the original")
+	{
+		REQUIRE(CorpusImage::Write(corpus, 42, image_path) == CorpusImageError::E_NONE);
+
+		Corpus attached;
+		uint64_t version = 0;
+		REQUIRE(CorpusImage::Attach(image_path, attached, &version) == CorpusImageError::E_NONE);
+		REQUIRE(version == 42);
+		REQUIRE(attached.IsAttached());
+		REQUIRE(attached.Config().m_SearchConfig.m_MatchMode == MatchMode::E_SOURCE_FILES);
+		REQUIRE(attached.Config().m_KeepFoldedCopy);
+		REQUIRE(attached.Config().m_TransposedBlocks);
+		REQUIRE(attached.Config().m_BlockSummaries);
+		RequireSameCorpus(corpus, attached);
+
+		Searcher searcher(SearcherConfig{ 2 });
+		searcher.SetCorpus(&attached);
+		RequireSameResults(corpus.Search("corpus image 12", config.m_SearchConfig, 20), searcher.Search("corpus image 12", config.m_SearchConfig, 20));
+
+		SECTION("copies share the mapping")
+		{
+			const Corpus copy = attached;
+			REQUIRE(copy.IsAttached());
+			RequireSameCorpus(corpus, copy);
+		}
+
+		SECTION("updates copy the arrays out of the image")
+		{
+			// Takes a free id, same as on the original
+			const uint32_t id = attached.Add("src/added/FuzzySearchCorpusImageAdded.h");
+			REQUIRE_FALSE(attached.IsAttached());
+			REQUIRE(id == corpus.Add("src/added/FuzzySearchCorpusImageAdded.h"));
+			attached.Remove(10);
+			corpus.Remove(10);
+			RequireSameCorpus(corpus, attached);
+
+			attached.Compact();
+			corpus.Compact();
+			RequireSameCorpus(corpus, attached);
+		}
+
+		SECTION("an image of an attached corpus")
+		{
+			const std::string copy_path = tree.Path("copy.image");
+			REQUIRE(CorpusImage::Write(attached, 43, copy_path) == CorpusImageError::E_NONE);
+			Corpus copy;
+			REQUIRE(CorpusImage::Attach(copy_path, copy) == CorpusImageError::E_NONE);
+			RequireSameCorpus(corpus, copy);
+		}
+	}
+
+	SECTION("default config and empty corpus")
+	{
+		Corpus plain;
+		plain.Add("src/FuzzySearchCorpusImage.h");
+		plain.Add("src/FuzzySearchCorpusImage.inl");
+		REQUIRE(CorpusImage::Write(plain, 1, image_path) == CorpusImageError::E_NONE);
+		Corpus attached;
+		REQUIRE(CorpusImage::Attach(image_path, attached) == CorpusImageError::E_NONE);
+		RequireSameCorpus(plain, attached);
+
+		REQUIRE(CorpusImage::Write(Corpus(config), 2, image_path) == CorpusImageError::E_NONE);
+		REQUIRE(CorpusImage::Attach(image_path, attached) == CorpusImageError::E_NONE);
+		REQUIRE(attached.Size() == 0);
+		REQUIRE(attached.Search("image", config.m_SearchConfig).empty());
+	}
+
+	SECTION("broken images are rejected")
+	{
+		Corpus attached;
+		REQUIRE(CorpusImage::Attach(tree.Path("missing.image"), attached) == CorpusImageError::E_OPEN_FAILED);
+
+		REQUIRE(CorpusImage::Write(corpus, 1, image_path) == CorpusImageError::E_NONE);
+		const std::vector<uint8_t> image = ReadFile(image_path);
+
+		std::vector<uint8_t> broken = image;
+		broken[0] = 'X';
+		WriteFile(image_path, broken);
+		REQUIRE(CorpusImage::Attach(image_path, attached) == CorpusImageError::E_BAD_SIGNATURE);
+
+		broken = image;
+		broken[8] = 99;
+		WriteFile(image_path, broken);
+		REQUIRE(CorpusImage::Attach(image_path, attached) == CorpusImageError::E_UNSUPPORTED_VERSION);
+
+		for (size_t size : { size_t(12), size_t(100), image.size() / 2, image.size() - 1 })
+		{
+			INFO("size " << size);
+			broken.assign(image.begin(), image.begin() + static_cast<std::ptrdiff_t>(size));
+			WriteFile(image_path, broken);
+			REQUIRE(CorpusImage::Attach(image_path, attached) == CorpusImageError::E_TRUNCATED);
+		}
+
+		// The string count follows signature, format version, header size, byte order mark, section count, the config
+		// (16 bytes) and the version
+		constexpr size_t string_count_offset = 48;
+		REQUIRE(ReadUint64(image, string_count_offset) == corpus.Size());
+		broken = image;
+		++broken[string_count_offset];
+		WriteFile(image_path, broken);
+		REQUIRE(CorpusImage::Attach(image_path, attached) == CorpusImageError::E_CORRUPT);
+
+		// The section table follows the nine counts, the string offsets are the third section
+		constexpr size_t offsets_section_offset = string_count_offset + 8 * 8 + 2 * 16;
+		broken = image;
+		const uint64_t first_string_offset = ReadUint64(image, offsets_section_offset);
+		std::memset(broken.data() + first_string_offset, 0xFF, sizeof(uint32_t));
+		WriteFile(image_path, broken);
+		REQUIRE(CorpusImage::Attach(image_path, attached) == CorpusImageError::E_CORRUPT);
+
+		REQUIRE_FALSE(attached.IsAttached());
+	}
+}
+
+TEST_CASE("CorpusImageReader")
+{
+	TemporaryTree tree({});
+	const std::string image_path = tree.Path("corpus.image");
+
+	CorpusImageReader reader(image_path);
+	bool changed = true;
+	REQUIRE(reader.Refresh(&changed) == CorpusImageError::E_OPEN_FAILED);
+	REQUIRE_FALSE(changed);
+	REQUIRE(reader.Acquire() == nullptr);
+
+	Corpus corpus;
+	corpus.Add("src/FuzzySearchCorpusImage.h");
+	REQUIRE(CorpusImage::Write(corpus, 1, image_path) == CorpusImageError::E_NONE);
+	REQUIRE(reader.Refresh(&changed) == CorpusImageError::E_NONE);
+	REQUIRE(changed);
+	REQUIRE(reader.Version() == 1);
+
+	REQUIRE(reader.Refresh(&changed) == CorpusImageError::E_NONE);
+	REQUIRE_FALSE(changed);
+
+	const CorpusImageReader::Snapshot first = reader.Acquire();
+	REQUIRE(first->Size() == 1);
+
+	corpus.Add("src/FuzzySearchCorpusImage.inl");
+	REQUIRE(CorpusImage::Write(corpus, 2, image_path) == CorpusImageError::E_NONE);
+	REQUIRE(reader.Refresh(&changed) == CorpusImageError::E_NONE);
+	REQUIRE(changed);
+	REQUIRE(reader.Version() == 2);
+	REQUIRE(reader.Acquire()->Size() == 2);
+
+	// The replaced image stays mapped for the snapshot that pinned it, even once the file is gone
+	std::filesystem::remove(image_path);
+	REQUIRE(reader.Refresh(&changed) == CorpusImageError::E_OPEN_FAILED);
+	REQUIRE(reader.Acquire()->Size() == 2);
+	REQUIRE(first->Get(0) == "src/FuzzySearchCorpusImage.h");
+	REQUIRE(first->Search("image", SearchConfig{}).size() == 1);
+}
@@ -0,0 +1,120 @@
+#include <catch2/catch_all.hpp>
+
+#include "TemporaryTree.h"
+
+#include <FuzzySearchCrawler.h>
+
+#include <set>
+
+using namespace FuzzySearch;
+
+static std::set<std::string> CorpusStrings(const Corpus& corpus)
+{
+	std::set<std::string> strings;
+	for (uint32_t id = 0; id < static_cast<uint32_t>(corpus.Size()); ++id)
+	{
+		strings.insert(std::string(corpus.Get(id)));
+	}
+	return strings;
+}
+
+TEST_CASE("MatchGlob")
+{
+	REQUIRE(MatchGlob("*.o", "main.o"));
+	REQUIRE_FALSE(MatchGlob("*.o", "main.obj"));
+	REQUIRE(MatchGlob("build*", "build"));
+	REQUIRE(MatchGlob("?ake*.txt", "CMakeLists.txt") == false);
+	REQUIRE(MatchGlob("?Make*.txt", "CMakeLists.txt"));
+	REQUIRE(MatchGlob("file[0-9].[ch]", "file7.h"));
+	REQUIRE_FALSE(MatchGlob("file[!0-9]", "file7"));
+	REQUIRE(MatchGlob("[]x]", "]"));
+	REQUIRE(MatchGlob("a[b", "a[b"));
+	REQUIRE(MatchGlob("\\*", "*"));
+	REQUIRE_FALSE(MatchGlob("\\*", "a"));
+	REQUIRE(MatchGlob("src/*/gen", "src/lib/gen"));
+	REQUIRE_FALSE(MatchGlob("src/*", "src/lib/gen"));
+	REQUIRE_FALSE(MatchGlob("*", "a/b"));
+	REQUIRE(MatchGlob("*a*b*c", "xaybzc"));
+	REQUIRE(MatchGlob("", ""));
+	REQUIRE_FALSE(MatchGlob("", "a"));
+}
+
+TEST_CASE("Crawler")
+{
+	const TemporaryTree tree({
+	    "src/main.cpp",
+	    "src/main.o",
+	    "src/lib/lib.cpp",
+	    "src/lib/gen/generated.cpp",
+	    "src/lib/deep/er/deepest.h",
+	    "build/out.bin",
+	    ".git/HEAD",
+	    "README.md",
+	});
+	const std::string& root = tree.Root();
+
+	CrawlerConfig config;
+	config.m_ThreadCount = 4;
+
+	SECTION("all files")
+	{
+		Crawler crawler(config);
+		Corpus corpus;
+		// A trailing separator on the root does not change the paths
+		const CrawlStats stats = crawler.Crawl({ root + "/" }, corpus);
+
+		REQUIRE(stats.m_Files == 8);
+		REQUIRE(stats.m_Directories == 8);
+		REQUIRE(stats.m_Errors == 0);
+		REQUIRE(CorpusStrings(corpus).count(root + "/src/lib/deep/er/deepest.h") == 1);
+		REQUIRE(CorpusStrings(corpus).size() == 8);
+
+		// Filename offsets are the same as for strings added directly
+		for (uint32_t id = 0; id < static_cast<uint32_t>(corpus.Size()); ++id)
+		{
+			const std::string_view path = corpus.Get(id);
+			REQUIRE(corpus.FilenameStart(id) == static_cast<int>(path.find_last_of('/') + 1));
+		}
+	}
+
+	SECTION("directory callback")
+	{
+		Crawler crawler(config);
+		std::set<std::string> entered;
+		size_t files_before_entered = 0;
+		const CrawlStats stats = crawler.ForEachFile({ Crawler::Root(root) },
+			[&](std::string_view path)
+			{
+				// The directory of a file was entered before the file was listed
+				files_before_entered += entered.count(std::string(path.substr(0, path.find_last_of('/')))) == 0 ? 1 : 0;
+			},
+			[&](const Crawler::CrawlDirectory& directory) { entered.insert(directory.m_Path); });
+
+		REQUIRE(stats.m_Files == 8);
+		REQUIRE(files_before_entered == 0);
+		REQUIRE(entered.size() == 8);
+		REQUIRE(entered.count(root + "/src/lib/deep/er") == 1);
+	}
+
+	SECTION("ignore rules and depth")
+	{
+		config.m_IgnorePatterns = { ".git/", "*.o", "build", "/src/lib/gen", "src/lib/deep/" };
+		Crawler crawler(config);
+		REQUIRE(crawler.IsIgnored("gen", "src/lib/gen", true));
+		REQUIRE_FALSE(crawler.IsIgnored(".git", "nested/.git", false));
+
+		Corpus corpus;
+		const CrawlStats stats = crawler.Crawl({ root }, corpus);
+		REQUIRE(CorpusStrings(corpus) == std::set<std::string>{ root + "/src/main.cpp", root + "/src/lib/lib.cpp", root + "/README.md" });
+		REQUIRE(stats.m_Ignored == 5);
+
+		config.m_IgnorePatterns.clear();
+		config.m_MaxDepth = 1;
+		Crawler shallow_crawler(config);
+		CorpusBatch batch;
+		shallow_crawler.Crawl({ root, root + "/missing" }, batch);
+		Corpus batch_corpus;
+		batch.ApplyTo(batch_corpus);
+		REQUIRE(CorpusStrings(batch_corpus) == std::set<std::string>{ root + "/src/main.cpp", root + "/src/main.o", root + "/build/out.bin", root + "/.git/HEAD", root + "/README.md" });
+	}
+}
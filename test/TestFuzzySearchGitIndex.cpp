@@ -0,0 +1,230 @@
+#include <catch2/catch_all.hpp>
+
+#include "TemporaryTree.h"
+
+#include <FuzzySearchGitIndex.h>
+
+using namespace FuzzySearch;
+
+namespace
+{
+	struct IndexEntry
+	{
+		std::string m_Path;
+		uint32_t m_Mode = 0100644;
+		int m_Stage = 0;
+		bool m_Extended = false;
+	};
+
+	void AppendBigEndian(std::vector<uint8_t>& out, uint32_t value, int byte_count)
+	{
+		for (int byte = byte_count - 1; byte >= 0; --byte)
+		{
+			out.push_back(static_cast<uint8_t>(value >> (byte * 8)));
+		}
+	}
+
+	void AppendGitVarint(std::vector<uint8_t>& out, size_t value)
+	{
+		uint8_t bytes[16];
+		int position = sizeof(bytes) - 1;
+		bytes[position] = value & 0x7F;
+		while (value >>= 7)
+		{
+			bytes[--position] = 0x80 | (--value & 0x7F);
+		}
+		out.insert(out.end(), bytes + position, bytes + sizeof(bytes));
+	}
+
+	// Same layout git writes, stat data and object ids are filler
+	std::vector<uint8_t> BuildIndex(uint32_t version, const std::vector<IndexEntry>& entries, size_t hash_size = 20)
+	{
+		std::vector<uint8_t> index = { 'D', 'I', 'R', 'C' };
+		AppendBigEndian(index, version, 4);
+		AppendBigEndian(index, static_cast<uint32_t>(entries.size()), 4);
+
+		std::string previous_path;
+		for (const IndexEntry& entry : entries)
+		{
+			const size_t entry_start = index.size();
+			index.resize(index.size() + 24, 0xAB);
+			AppendBigEndian(index, entry.m_Mode, 4);
+			index.resize(index.size() + 12 + hash_size, 0xCD);
+
+			const uint32_t flags = (entry.m_Extended ? 0x4000 : 0) | (entry.m_Stage << 12) | std::min<size_t>(entry.m_Path.length(), 0xFFF);
+			AppendBigEndian(index, flags, 2);
+			if (entry.m_Extended)
+			{
+				AppendBigEndian(index, 0x2000, 2);
+			}
+
+			if (version == 4)
+			{
+				size_t common = 0;
+				while (common < previous_path.length() && common < entry.m_Path.length() && previous_path[common] == entry.m_Path[common])
+				{
+					++common;
+				}
+				AppendGitVarint(index, previous_path.length() - common);
+				index.insert(index.end(), entry.m_Path.begin() + common, entry.m_Path.end());
+				index.push_back(0);
+				previous_path = entry.m_Path;
+			}
+			else
+			{
+				index.insert(index.end(), entry.m_Path.begin(), entry.m_Path.end());
+				do
+				{
+					index.push_back(0);
+				} while ((index.size() - entry_start) % 8 != 0);
+			}
+		}
+
+		// An extension and the checksum follow the entries
+		index.insert(index.end(), { 'T', 'R', 'E', 'E', 0, 0, 0, 0 });
+		index.resize(index.size() + hash_size, 0xEF);
+		return index;
+	}
+
+	std::vector<std::string> ParsePaths(const std::vector<uint8_t>& index, GitIndexError& out_error, size_t hash_size = 20)
+	{
+		std::vector<std::string> paths;
+		out_error = ForEachGitIndexPath(index.data(), index.size(), hash_size, [&paths](std::string_view path) { paths.emplace_back(path); });
+		return paths;
+	}
+}
+
+TEST_CASE("ForEachGitIndexPath")
+{
+	const std::vector<std::string> expected_paths = {
+		".gitignore",
+		"CMakeLists.txt",
+		"src/FuzzySearch.h",
+		"src/FuzzySearch.inl",
+		"src/FuzzySearchCorpus.h",
+		"test/CMakeLists.txt",
+		"test/TestFuzzySearch.cpp",
+		std::string(5000, 'x'),
+	};
+
+	std::vector<IndexEntry> entries;
+	for (const std::string& path : expected_paths)
+	{
+		entries.push_back({ path });
+	}
+
+	GitIndexError error = GitIndexError::E_CORRUPT;
+
+	SECTION("version 2")
+	{
+		REQUIRE(ParsePaths(BuildIndex(2, entries), error) == expected_paths);
+		REQUIRE(error == GitIndexError::E_NONE);
+	}
+
+	SECTION("version 3 with extended flags")
+	{
+		entries[1].m_Extended = true;
+		entries[4].m_Extended = true;
+		REQUIRE(ParsePaths(BuildIndex(3, entries), error) == expected_paths);
+		REQUIRE(error == GitIndexError::E_NONE);
+	}
+
+	SECTION("version 4 prefix compression")
+	{
+		REQUIRE(ParsePaths(BuildIndex(4, entries), error) == expected_paths);
+		REQUIRE(error == GitIndexError::E_NONE);
+	}
+
+	SECTION("sha256 object ids")
+	{
+		REQUIRE(ParsePaths(BuildIndex(4, entries, 32), error, 32) == expected_paths);
+		REQUIRE(error == GitIndexError::E_NONE);
+	}
+
+	SECTION("conflicts and sparse directories")
+	{
+		entries.insert(entries.begin() + 3, { "src/FuzzySearch.h", 0100644, 2 });
+		entries.insert(entries.begin() + 3, { "src/FuzzySearch.h", 0100644, 3 });
+		entries[2].m_Stage = 1;
+		entries.insert(entries.begin() + 1, { "build/", 0040000 });
+
+		for (uint32_t version : { 3u, 4u })
+		{
+			INFO(version);
+			REQUIRE(ParsePaths(BuildIndex(version, entries), error) == expected_paths);
+			REQUIRE(error == GitIndexError::E_NONE);
+		}
+	}
+
+	SECTION("errors")
+	{
+		std::vector<uint8_t> index = BuildIndex(2, entries);
+		index[0] = 'X';
+		ParsePaths(index, error);
+		REQUIRE(error == GitIndexError::E_BAD_SIGNATURE);
+
+		index = BuildIndex(5, {});
+		ParsePaths(index, error);
+		REQUIRE(error == GitIndexError::E_UNSUPPORTED_VERSION);
+
+		entries[0].m_Extended = true;
+		ParsePaths(BuildIndex(2, entries), error);
+		REQUIRE(error == GitIndexError::E_CORRUPT);
+		entries[0].m_Extended = false;
+
+		// Cut inside every entry, paths before the cut still come out
+		for (uint32_t version : { 2u, 4u })
+		{
+			index = BuildIndex(version, entries);
+			const size_t entries_end = index.size() - 8 - 20;
+			for (size_t size = 0; size < entries_end; size += 7)
+			{
+				index.resize(size);
+				INFO(version << " " << size);
+				const std::vector<std::string> paths = ParsePaths(index, error);
+				REQUIRE(error == GitIndexError::E_TRUNCATED);
+				REQUIRE(std::equal(paths.begin(), paths.end(), expected_paths.begin()));
+				index = BuildIndex(version, entries);
+			}
+		}
+	}
+}
+
+TEST_CASE("ReadGitIndex")
+{
+	TemporaryTree tree({});
+	const std::string index_path = tree.Path("index");
+	const std::vector<uint8_t> index = BuildIndex(4, { { "a/one.txt" }, { "a/two.txt" }, { "b.txt" } });
+	std::ofstream(index_path, std::ios::binary).write(reinterpret_cast<const char*>(index.data()), index.size());
+
+	GitIndexConfig config;
+	config.m_PathPrefix = "repo/";
+
+	SECTION("corpus")
+	{
+		Corpus corpus;
+		corpus.Add("existing");
+		REQUIRE(ReadGitIndex(index_path, config, corpus) == GitIndexError::E_NONE);
+		REQUIRE(corpus.Size() == 4);
+		REQUIRE(corpus.Get(1) == "repo/a/one.txt");
+		REQUIRE(corpus.Get(2) == "repo/a/two.txt");
+		REQUIRE(corpus.Get(3) == "repo/b.txt");
+	}
+
+	SECTION("batch")
+	{
+		VersionedCorpus versioned_corpus;
+		CorpusBatch batch;
+		REQUIRE(ReadGitIndex(index_path, config, batch) == GitIndexError::E_NONE);
+		REQUIRE(batch.Size() == 3);
+		versioned_corpus.Commit(batch);
+		REQUIRE(versioned_corpus.Acquire()->Get(2) == "repo/b.txt");
+	}
+
+	SECTION("missing file")
+	{
+		Corpus corpus;
+		REQUIRE(ReadGitIndex(tree.Path("missing"), config, corpus) == GitIndexError::E_OPEN_FAILED);
+		REQUIRE(corpus.Size() == 0);
+	}
+}
@@ -0,0 +1,140 @@
+#include <catch2/catch_all.hpp>
+
+#include <FuzzySearch.h>
+
+#include <string>
+
+using namespace FuzzySearch;
+
+// Restores the kernels picked at startup when a test is done forcing others
+class ScopedIsa
+{
+public:
+	ScopedIsa()
+		: m_Isa(ActiveIsa())
+	{}
+
+	~ScopedIsa() { SetIsa(m_Isa); }
+
+private:
+	Isa m_Isa;
+};
+
+TEST_CASE("Isa")
+{
+	ScopedIsa scoped_isa;
+
+	for (Isa isa : { Isa::E_SCALAR, Isa::E_SSE2, Isa::E_AVX2, Isa::E_AVX512 })
+	{
+		Isa parsed_isa = Isa::E_SCALAR;
+		REQUIRE(ParseIsa(IsaName(isa), parsed_isa));
+		REQUIRE(parsed_isa == isa);
+
+		const bool supported = isa <= DetectIsa();
+		REQUIRE(SetIsa(isa) == supported);
+		if (supported)
+		{
+			REQUIRE(ActiveIsa() == isa);
+		}
+	}
+
+	Isa parsed_isa = Isa::E_SCALAR;
+	REQUIRE_FALSE(ParseIsa("neon", parsed_isa));
+	REQUIRE(ActiveIsa() <= DetectIsa());
+}
+
+TEST_CASE("FindLowerByte")
+{
+	ScopedIsa scoped_isa;
+
+	// Long enough for every vector width plus a tail, with upper case, separators and bytes above 0x7F
+	std::string str;
+	uint32_t state = 7;
+	for (int index = 0; index < 200; ++index)
+	{
+		state = state * 1664525u + 1013904223u;
+		const char alphabet[] = "abcXYZ_/. \x80\xC3\xE9";
+		str.push_back(alphabet[(state >> 24) % (sizeof(alphabet) - 1)]);
+	}
+
+	for (Isa isa : { Isa::E_SCALAR, Isa::E_SSE2, Isa::E_AVX2, Isa::E_AVX512 })
+	{
+		if (!SetIsa(isa))
+		{
+			continue;
+		}
+
+		INFO("isa = " << IsaName(isa));
+		for (int length : { 0, 1, 15, 16, 17, 31, 32, 33, 63, 64, 65, 200 })
+		{
+			const std::string_view prefix(str.data(), length);
+			const FuzzySearchStringRef<std::string_view> str_ref(prefix);
+			for (int lower_char : { int('a'), int('x'), int('z'), int('/'), int('\x7f'), '\xE9' | 0x20 })
+			{
+				for (int start_index = 0; start_index <= length; ++start_index)
+				{
+					int expected = start_index;
+					while (expected < length && str_ref.ToLower(expected) != lower_char)
+					{
+						++expected;
+					}
+					REQUIRE(FindLowerByte(str.data(), length, start_index, lower_char) == expected);
+				}
+			}
+		}
+	}
+}
+
+TEST_CASE("BlockPresence")
+{
+	ScopedIsa scoped_isa;
+
+	// Folded bytes as the corpus stores them, zeros are padding
+	std::vector<uint8_t> rows;
+	uint32_t state = 11;
+	for (int index = 0; index < 37 * block_lanes; ++index)
+	{
+		state = state * 1664525u + 1013904223u;
+		const uint8_t byte = static_cast<uint8_t>(state >> 24);
+		rows.push_back((state & 0x700) == 0 ? 0 : static_cast<uint8_t>(byte | 0x20));
+	}
+
+	CharacterBuckets buckets;
+	int bucket = 0;
+	for (char c : std::string("qt basevwl/.xyz\xE9"))
+	{
+		if (c != ' ')
+		{
+			buckets.Add(static_cast<uint8_t>(c | 0x20), bucket++ % 8);
+		}
+	}
+
+	for (int row_count : { 0, 1, 3, 4, 5, 37 })
+	{
+		// Exact bucket bits, the kernels can only add to them
+		std::array<uint8_t, block_lanes> expected{};
+		for (int row = 0; row < row_count; ++row)
+		{
+			for (int lane = 0; lane < block_lanes; ++lane)
+			{
+				expected[lane] |= buckets.m_Buckets[rows[row * block_lanes + lane]];
+			}
+		}
+
+		for (Isa isa : { Isa::E_SCALAR, Isa::E_SSE2, Isa::E_AVX2, Isa::E_AVX512 })
+		{
+			if (!SetIsa(isa))
+			{
+				continue;
+			}
+
+			INFO("isa = " << IsaName(isa) << " rows = " << row_count);
+			std::array<uint8_t, block_lanes> presence{};
+			BlockPresence(rows.data(), row_count, buckets, presence.data());
+			for (int lane = 0; lane < block_lanes; ++lane)
+			{
+				REQUIRE((presence[lane] & expected[lane]) == expected[lane]);
+			}
+		}
+	}
+}
@@ -0,0 +1,146 @@
+#include <catch2/catch_all.hpp>
+
+#include <FuzzySearchProtocol.h>
+
+using namespace FuzzySearch;
+
+TEST_CASE("Protocol requests")
+{
+	SearchRequest request;
+	request.m_RequestId = 0xDEADBEEF;
+	request.m_SearchConfig.m_MatchMode = MatchMode::E_SOURCE_FILES;
+	request.m_SearchConfig.m_MaxUnmatchedCharactersFromPattern = 1;
+	request.m_SearchConfig.m_OptimalRescoreCount = 300;
+	request.m_MaxResults = 70000;
+	request.m_Flags = RequestFlags::E_INCLUDE_STRINGS;
+	request.m_Pattern = "fuzzy search";
+
+	std::vector<uint8_t> stream;
+	REQUIRE(EncodeSearchRequest(request, stream));
+	const size_t first_size = stream.size();
+	REQUIRE(first_size == Protocol::frame_header_size + Protocol::request_fields_size + request.m_Pattern.length());
+	request.m_RequestId = 2;
+	request.m_Pattern = "";
+	REQUIRE(EncodeSearchRequest(request, stream));
+
+	SECTION("round trip")
+	{
+		SearchRequest decoded;
+		size_t frame_size = 0;
+		REQUIRE(DecodeSearchRequest(stream.data(), stream.size(), frame_size, decoded) == DecodeResult::E_OK);
+		REQUIRE(frame_size == first_size);
+		REQUIRE(decoded.m_RequestId == 0xDEADBEEF);
+		REQUIRE(decoded.m_SearchConfig.m_MatchMode == MatchMode::E_SOURCE_FILES);
+		REQUIRE(decoded.m_SearchConfig.m_MaxUnmatchedCharactersFromPattern == 1);
+		REQUIRE(decoded.m_SearchConfig.m_OptimalRescoreCount == 300);
+		REQUIRE(decoded.m_MaxResults == 70000);
+		REQUIRE(decoded.m_Flags == RequestFlags::E_INCLUDE_STRINGS);
+		REQUIRE(decoded.m_Pattern == "fuzzy search");
+
+		REQUIRE(DecodeSearchRequest(stream.data() + frame_size, stream.size() - frame_size, frame_size, decoded) == DecodeResult::E_OK);
+		REQUIRE(decoded.m_RequestId == 2);
+		REQUIRE(decoded.m_Pattern.empty());
+	}
+
+	SECTION("partial frames")
+	{
+		SearchRequest decoded;
+		for (size_t size = 0; size < first_size; ++size)
+		{
+			size_t frame_size = 0;
+			REQUIRE(DecodeSearchRequest(stream.data(), size, frame_size, decoded) == DecodeResult::E_INCOMPLETE);
+		}
+	}
+
+	SECTION("malformed payloads")
+	{
+		SearchRequest decoded;
+		size_t frame_size = 0;
+
+		std::vector<uint8_t> bad_mode(stream.begin(), stream.begin() + static_cast<ptrdiff_t>(first_size));
+		bad_mode[4 + 5] = 7;
+		REQUIRE(DecodeSearchRequest(bad_mode.data(), bad_mode.size(), frame_size, decoded) == DecodeResult::E_MALFORMED);
+		REQUIRE(frame_size == first_size);
+		REQUIRE(decoded.m_RequestId == 0xDEADBEEF);
+
+		// Pattern length past the end of the payload
+		std::vector<uint8_t> bad_length(stream.begin(), stream.begin() + static_cast<ptrdiff_t>(first_size));
+		bad_length[4 + 14] = 0xFF;
+		REQUIRE(DecodeSearchRequest(bad_length.data(), bad_length.size(), frame_size, decoded) == DecodeResult::E_MALFORMED);
+
+		const std::vector<uint8_t> huge_frame = { 0xFF, 0xFF, 0xFF, 0x7F, 1 };
+		REQUIRE(DecodeSearchRequest(huge_frame.data(), huge_frame.size(), frame_size, decoded) == DecodeResult::E_INVALID_FRAME);
+	}
+
+	SECTION("long patterns")
+	{
+		// The longest pattern still makes a frame the decoder accepts
+		std::vector<uint8_t> longest;
+		request.m_Pattern.assign(Protocol::max_pattern_length, 'a');
+		REQUIRE(EncodeSearchRequest(request, longest));
+		SearchRequest decoded;
+		size_t frame_size = 0;
+		REQUIRE(DecodeSearchRequest(longest.data(), longest.size(), frame_size, decoded) == DecodeResult::E_OK);
+		REQUIRE(decoded.m_Pattern == request.m_Pattern);
+
+		// Longer ones are refused instead of cut short
+		for (size_t length : { Protocol::max_pattern_length + 1, size_t(0xFFFF), size_t(0x10000), size_t(100000) })
+		{
+			request.m_Pattern.assign(length, 'a');
+			REQUIRE_FALSE(EncodeSearchRequest(request, stream));
+		}
+		REQUIRE(DecodeSearchRequest(stream.data(), stream.size(), frame_size, decoded) == DecodeResult::E_OK);
+		REQUIRE(frame_size == first_size);
+		REQUIRE(stream.size() == first_size + Protocol::frame_header_size + Protocol::request_fields_size);
+	}
+}
+
+TEST_CASE("Protocol responses")
+{
+	Corpus corpus;
+	corpus.Add("src/FuzzySearch.h");
+	corpus.Add("src/FuzzySearchProtocol.h");
+	corpus.Add("README.md");
+
+	const CorpusSearchResults results = corpus.Search("protocol", SearchConfig(), 0);
+	REQUIRE(results.size() == 1);
+
+	for (bool include_strings : { false, true })
+	{
+		INFO(include_strings);
+		std::vector<uint8_t> stream;
+		EncodeSearchResponse(41, ResponseStatus::E_OK, 9, &corpus, results, include_strings, stream);
+		EncodeSearchResponse(42, ResponseStatus::E_BAD_REQUEST, 9, nullptr, CorpusSearchResults(), include_strings, stream);
+
+		SearchResponse response;
+		size_t frame_size = 0;
+		REQUIRE(DecodeSearchResponse(stream.data(), stream.size(), frame_size, response) == DecodeResult::E_OK);
+		REQUIRE(response.m_RequestId == 41);
+		REQUIRE(response.m_Status == ResponseStatus::E_OK);
+		REQUIRE(response.m_Version == 9);
+		REQUIRE(response.m_Results.size() == 1);
+		REQUIRE(response.m_Results[0].m_Id == results[0].m_Id);
+		REQUIRE(response.m_Results[0].m_Score == results[0].m_Score);
+
+		const MatchSpan expected_matches = results.Matches(0);
+		const MatchSpan matches = response.m_Results.Matches(0);
+		REQUIRE(std::equal(matches.begin(), matches.end(), expected_matches.begin(), expected_matches.end()));
+
+		REQUIRE(response.m_Strings.size() == (include_strings ? 1 : 0));
+		if (include_strings)
+		{
+			REQUIRE(response.m_Strings[0] == "src/FuzzySearchProtocol.h");
+		}
+
+		for (size_t size = 0; size < frame_size; ++size)
+		{
+			size_t partial_frame_size = 0;
+			REQUIRE(DecodeSearchResponse(stream.data(), size, partial_frame_size, response) == DecodeResult::E_INCOMPLETE);
+		}
+
+		REQUIRE(DecodeSearchResponse(stream.data() + frame_size, stream.size() - frame_size, frame_size, response) == DecodeResult::E_OK);
+		REQUIRE(response.m_RequestId == 42);
+		REQUIRE(response.m_Status == ResponseStatus::E_BAD_REQUEST);
+		REQUIRE(response.m_Results.empty());
+	}
+}
@@ -0,0 +1,235 @@
+#include <catch2/catch_all.hpp>
+
+#include <FuzzySearchScheduler.h>
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+
+using namespace FuzzySearch;
+
+namespace
+{
+	struct ReceivedResponse
+	{
+		QueryScheduler::SessionId m_Session = 0;
+		SearchResponse m_Response;
+	};
+
+	// Collects responses until count of them arrived
+	std::map<uint32_t, ReceivedResponse> WaitForResponses(QueryScheduler& scheduler, std::mutex& mutex, std::condition_variable& ready, size_t count)
+	{
+		std::map<uint32_t, ReceivedResponse> responses;
+		while (responses.size() < count)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				ready.wait_for(lock, std::chrono::milliseconds(10));
+			}
+
+			scheduler.TakeResponses([&responses](QueryScheduler::SessionId session, const uint8_t* frame, size_t frame_size)
+			{
+				ReceivedResponse received;
+				received.m_Session = session;
+				size_t decoded_size = 0;
+				REQUIRE(DecodeSearchResponse(frame, frame_size, decoded_size, received.m_Response) == DecodeResult::E_OK);
+				REQUIRE(decoded_size == frame_size);
+				const uint32_t request_id = received.m_Response.m_RequestId;
+				REQUIRE(responses.count(request_id) == 0);
+				responses[request_id] = std::move(received);
+			});
+		}
+		return responses;
+	}
+}
+
+TEST_CASE("QueryScheduler")
+{
+	VersionedCorpus corpus;
+	CorpusBatch batch;
+	for (int index = 0; index < 1000; ++index)
+	{
+		batch.Add("src/module" + std::to_string(index) + "/FuzzySearchScheduler.inl");
+	}
+	corpus.Commit(batch);
+
+	SchedulerConfig config;
+	config.m_SearcherConfig.m_ThreadCount = 2;
+	config.m_MaxResults = 10;
+	QueryScheduler scheduler(corpus, config);
+
+	std::mutex mutex;
+	std::condition_variable ready;
+	auto on_ready = [&]()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		ready.notify_all();
+	};
+
+	SearchRequest request;
+	request.m_MaxResults = 5;
+
+	SECTION("latest wins")
+	{
+		// Queued before the search thread starts, only the last keystroke is searched
+		const std::string typed = "module42";
+		request.m_Flags = RequestFlags::E_LATEST_WINS;
+		for (size_t length = 1; length <= typed.length(); ++length)
+		{
+			request.m_RequestId = static_cast<uint32_t>(length);
+			request.m_Pattern = typed.substr(0, length);
+			scheduler.Submit(1, request);
+			REQUIRE(scheduler.PendingCount(1) == 1);
+		}
+		REQUIRE(scheduler.SupersededCount() == typed.length() - 1);
+
+		scheduler.Start(on_ready);
+		const auto responses = WaitForResponses(scheduler, mutex, ready, typed.length());
+		REQUIRE(scheduler.SearchCount() == 1);
+		REQUIRE(scheduler.PendingCount(1) == 0);
+
+		for (const auto& [request_id, received] : responses)
+		{
+			REQUIRE(received.m_Session == 1);
+			REQUIRE(received.m_Response.m_Status == (request_id == typed.length() ? ResponseStatus::E_OK : ResponseStatus::E_SUPERSEDED));
+		}
+		REQUIRE(responses.at(static_cast<uint32_t>(typed.length())).m_Response.m_Results.size() == 5);
+	}
+
+	SECTION("requests without the flag all run")
+	{
+		for (uint32_t request_id : { 1, 2, 3 })
+		{
+			request.m_RequestId = request_id;
+			request.m_Pattern = "module" + std::to_string(request_id);
+			scheduler.Submit(1, request);
+		}
+		REQUIRE(scheduler.PendingCount(1) == 3);
+
+		scheduler.Start(on_ready);
+		const auto responses = WaitForResponses(scheduler, mutex, ready, 3);
+		REQUIRE(scheduler.SearchCount() == 3);
+		for (const auto& [request_id, received] : responses)
+		{
+			REQUIRE(received.m_Response.m_Status == ResponseStatus::E_OK);
+		}
+	}
+
+	SECTION("identical requests share a search")
+	{
+		request.m_Pattern = "scheduler";
+		for (QueryScheduler::SessionId session : { 1, 2, 3 })
+		{
+			request.m_RequestId = static_cast<uint32_t>(session * 10);
+			scheduler.Submit(session, request);
+		}
+		// Different result limit, searched on its own
+		request.m_RequestId = 40;
+		request.m_MaxResults = 6;
+		scheduler.Submit(4, request);
+		// Over the configured limit, capped to the same search as 0
+		request.m_RequestId = 50;
+		request.m_MaxResults = 0;
+		scheduler.Submit(5, request);
+		request.m_RequestId = 60;
+		request.m_MaxResults = 100;
+		scheduler.Submit(6, request);
+		REQUIRE(scheduler.SharedCount() == 3);
+
+		scheduler.Start(on_ready);
+		const auto responses = WaitForResponses(scheduler, mutex, ready, 6);
+		REQUIRE(scheduler.SearchCount() == 3);
+
+		for (QueryScheduler::SessionId session : { 1, 2, 3, 4, 5, 6 })
+		{
+			const ReceivedResponse& received = responses.at(static_cast<uint32_t>(session * 10));
+			REQUIRE(received.m_Session == session);
+			REQUIRE(received.m_Response.m_Status == ResponseStatus::E_OK);
+			REQUIRE(received.m_Response.m_Results.size() == (session <= 3 ? 5 : session == 4 ? 6 : 10));
+		}
+	}
+
+	SECTION("superseding one session keeps a shared search for the others")
+	{
+		request.m_Pattern = "scheduler";
+		request.m_RequestId = 1;
+		scheduler.Submit(1, request);
+		request.m_RequestId = 2;
+		scheduler.Submit(2, request);
+
+		request.m_RequestId = 3;
+		request.m_Pattern = "module7";
+		request.m_Flags = RequestFlags::E_LATEST_WINS;
+		scheduler.Submit(1, request);
+
+		scheduler.Start(on_ready);
+		const auto responses = WaitForResponses(scheduler, mutex, ready, 3);
+		REQUIRE(scheduler.SearchCount() == 2);
+		REQUIRE(responses.at(1).m_Response.m_Status == ResponseStatus::E_SUPERSEDED);
+		REQUIRE(responses.at(2).m_Response.m_Status == ResponseStatus::E_OK);
+		REQUIRE(responses.at(3).m_Response.m_Status == ResponseStatus::E_OK);
+	}
+
+	SECTION("closed sessions are not answered")
+	{
+		request.m_Pattern = "scheduler";
+		scheduler.Submit(1, request);
+		request.m_RequestId = 2;
+		request.m_Pattern = "module";
+		scheduler.Submit(2, request);
+		scheduler.CloseSession(1);
+		REQUIRE(scheduler.PendingCount(1) == 0);
+
+		scheduler.Start(on_ready);
+		const auto responses = WaitForResponses(scheduler, mutex, ready, 1);
+		REQUIRE(responses.begin()->second.m_Session == 2);
+		REQUIRE(scheduler.SearchCount() == 1);
+	}
+}
+
+TEST_CASE("QueryScheduler cancellation")
+{
+	// Large enough that a scan is still running when the next request arrives
+	VersionedCorpus corpus;
+	CorpusBatch batch;
+	for (int index = 0; index < 300000; ++index)
+	{
+		batch.Add("e:/libs/nodehierarchy/main/source/BaseEntityNode" + std::to_string(index) + ".cpp");
+	}
+	corpus.Commit(batch);
+
+	SchedulerConfig config;
+	config.m_SearcherConfig.m_ThreadCount = 1;
+	QueryScheduler scheduler(corpus, config);
+
+	std::mutex mutex;
+	std::condition_variable ready;
+	scheduler.Start([&]()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		ready.notify_all();
+	});
+
+	SearchRequest request;
+	request.m_Flags = RequestFlags::E_LATEST_WINS;
+	request.m_RequestId = 1;
+	request.m_Pattern = "base entity node";
+	scheduler.Submit(1, request);
+
+	request.m_RequestId = 2;
+	request.m_Pattern = "base entity node 12345";
+	scheduler.Submit(1, request);
+
+	const auto responses = WaitForResponses(scheduler, mutex, ready, 2);
+	REQUIRE(responses.at(2).m_Response.m_Status == ResponseStatus::E_OK);
+
+	// The first search was either still queued, running and cancelled, or already done
+	const ResponseStatus first_status = responses.at(1).m_Response.m_Status;
+	REQUIRE((first_status == ResponseStatus::E_SUPERSEDED || first_status == ResponseStatus::E_OK));
+	if (first_status == ResponseStatus::E_SUPERSEDED)
+	{
+		REQUIRE(scheduler.SearchCount() - scheduler.CancelledCount() == 1);
+	}
+	INFO("searches " << scheduler.SearchCount() << " cancelled " << scheduler.CancelledCount());
+	CHECK(scheduler.SearchCount() <= 2);
+}
@@ -0,0 +1,112 @@
+#include <catch2/catch_all.hpp>
+
+#include <FuzzySearchSearcher.h>
+
+#include <atomic>
+#include <thread>
+
+using namespace FuzzySearch;
+
+static void RequireSameResults(const CorpusSearchResults& expected, const CorpusSearchResults& results)
+{
+	REQUIRE(results.size() == expected.size());
+	for (size_t index = 0; index < results.size(); ++index)
+	{
+		REQUIRE(results[index].m_Id == expected[index].m_Id);
+		REQUIRE(results[index].m_Score == expected[index].m_Score);
+		REQUIRE(std::equal(results.Matches(index).begin(), results.Matches(index).end(), expected.Matches(index).begin(), expected.Matches(index).end()));
+	}
+}
+
+TEST_CASE("ThreadPool")
+{
+	ThreadPool thread_pool(4);
+	REQUIRE(thread_pool.ThreadCount() == 4);
+
+	for (size_t task_count : { 0, 1, 3, 100 })
+	{
+		std::vector<int> runs(task_count, 0);
+		std::atomic<bool> valid_thread_index{ true };
+		thread_pool.Run(task_count, [&](size_t task_index, size_t thread_index)
+		{
+			++runs[task_index];
+			valid_thread_index = valid_thread_index && thread_index < 4;
+		});
+
+		REQUIRE(std::count(runs.begin(), runs.end(), 1) == static_cast<std::ptrdiff_t>(task_count));
+		REQUIRE(valid_thread_index);
+	}
+}
+
+TEST_CASE("Searcher")
+{
+	// Enough strings for every thread to get a few tasks
+	Corpus corpus;
+	for (int index = 0; index < 500; ++index)
+	{
+		const std::string number = std::to_string(index);
+		corpus.Add("e:/libs/nodehierarchy/main/source/BaseEntityNode" + number + ".cpp");
+		corpus.Add("e:/libs/nodehierarchy/main/source/BaseHierarchyNode" + number + ".h");
+		corpus.Add("e:/libs/otherlib/main/source/CMakeLists" + number + ".txt");
+	}
+
+	SearcherConfig searcher_config;
+	searcher_config.m_ThreadCount = 4;
+	searcher_config.m_MinStringsPerTask = 16;
+	searcher_config.m_MinResultsPerMergePart = 8;
+
+	Searcher searcher(searcher_config);
+	REQUIRE(searcher.Search("bhn", {}).empty());
+
+	searcher.SetCorpus(&corpus);
+	REQUIRE(searcher.GetCorpus() == &corpus);
+	REQUIRE(searcher.ThreadCount() == 4);
+
+	for (MatchMode match_mode : { MatchMode::E_STRINGS, MatchMode::E_SOURCE_FILES })
+	{
+		SearchConfig search_config;
+		search_config.m_MatchMode = match_mode;
+		search_config.m_OptimalRescoreCount = 5;
+
+		for (const char* pattern_str : { "bhn", "node 12", "cmakelists", "b", "zzz", "" })
+		{
+			for (size_t max_results : { 0, 1, 10 })
+			{
+				INFO("pattern = " << pattern_str << " max_results = " << max_results);
+				RequireSameResults(corpus.Search(pattern_str, search_config, max_results), searcher.Search(pattern_str, search_config, max_results));
+			}
+		}
+	}
+}
+
+TEST_CASE("Searcher cancellation")
+{
+	Corpus corpus;
+	for (int index = 0; index < 20000; ++index)
+	{
+		corpus.Add("e:/libs/nodehierarchy/main/source/BaseEntityNode" + std::to_string(index) + ".cpp");
+	}
+
+	SearcherConfig searcher_config;
+	searcher_config.m_ThreadCount = 2;
+	Searcher searcher(searcher_config);
+	searcher.SetCorpus(&corpus);
+
+	CancellationToken cancellation;
+	RequireSameResults(corpus.Search("ben 17", {}, 10), searcher.Search("ben 17", {}, 10, &cancellation));
+	RequireSameResults(corpus.Search("ben 17", {}, 0), searcher.Search("ben 17", {}, 0, &cancellation));
+
+	cancellation.Cancel();
+	REQUIRE(searcher.Search("ben 17", {}, 10, &cancellation).empty());
+	REQUIRE(searcher.Search("ben 17", {}, 0, &cancellation).empty());
+
+	// Cancelled from another thread while scanning, the searcher stays usable afterwards
+	cancellation.Reset();
+	std::thread canceller([&cancellation]() { cancellation.Cancel(); });
+	const size_t result_count = searcher.Search("ben", {}, 0, &cancellation).size();
+	canceller.join();
+	REQUIRE((result_count == 0 || result_count == corpus.Size()));
+
+	cancellation.Reset();
+	RequireSameResults(corpus.Search("ben 17", {}, 10), searcher.Search("ben 17", {}, 10, &cancellation));
+}
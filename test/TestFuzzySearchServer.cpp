@@ -0,0 +1,166 @@
+#include <catch2/catch_all.hpp>
+
+#include "TemporaryTree.h"
+
+#include <FuzzySearchServer.h>
+
+#include <map>
+#include <thread>
+
+using namespace FuzzySearch;
+
+#if defined(__unix__) || defined(__APPLE__)
+
+TEST_CASE("Server")
+{
+	TemporaryTree tree({});
+	const std::string socket_path = tree.Path("search.sock");
+
+	VersionedCorpus corpus;
+	CorpusBatch batch;
+	for (const char* path : { "src/FuzzySearch.h", "src/FuzzySearchServer.h", "src/FuzzySearchServer.inl", "test/TestFuzzySearchServer.cpp", "README.md" })
+	{
+		batch.Add(path);
+	}
+	corpus.Commit(batch);
+
+	ServerConfig config;
+	config.m_SchedulerConfig.m_SearcherConfig.m_ThreadCount = 2;
+	config.m_SchedulerConfig.m_MaxResults = 2;
+
+	Server server(corpus, config);
+	REQUIRE(server.Listen(socket_path));
+	std::thread server_thread([&server]() { server.Run(); });
+
+	SearchRequest request;
+	SearchResponse response;
+
+	SECTION("pipelined requests")
+	{
+		Client client;
+		REQUIRE(client.Connect(socket_path));
+
+		const std::vector<std::string> patterns = { "server", "readme", "", "fsh", "zzzz" };
+		for (size_t index = 0; index < patterns.size(); ++index)
+		{
+			request.m_RequestId = static_cast<uint32_t>(100 + index);
+			request.m_Pattern = patterns[index];
+			request.m_Flags = RequestFlags::E_INCLUDE_STRINGS;
+			client.Send(request);
+		}
+		// A pattern too long for a request is refused and nothing is queued for it
+		request.m_RequestId = 300;
+		request.m_Pattern.assign(Protocol::max_pattern_length + 1, 'a');
+		REQUIRE_FALSE(client.Send(request));
+		// Invalid match mode
+		request.m_RequestId = 200;
+		request.m_Pattern.clear();
+		request.m_SearchConfig.m_MatchMode = static_cast<MatchMode>(9);
+		REQUIRE(client.Send(request));
+		REQUIRE(client.Flush());
+
+		// Answers come back as they are ready, the bad request one right away
+		std::map<uint32_t, SearchResponse> responses;
+		for (size_t index = 0; index <= patterns.size(); ++index)
+		{
+			REQUIRE(client.Receive(response));
+			responses[response.m_RequestId] = std::move(response);
+		}
+		REQUIRE(responses.size() == patterns.size() + 1);
+		REQUIRE(responses[200].m_Status == ResponseStatus::E_BAD_REQUEST);
+
+		const Corpus& expected_corpus = *corpus.Acquire();
+		for (size_t index = 0; index < patterns.size(); ++index)
+		{
+			INFO(patterns[index]);
+			const SearchResponse& result_response = responses[static_cast<uint32_t>(100 + index)];
+			REQUIRE(result_response.m_Status == ResponseStatus::E_OK);
+			REQUIRE(result_response.m_Version == 1);
+
+			// Capped by SchedulerConfig::m_MaxResults
+			const CorpusSearchResults expected = expected_corpus.Search(patterns[index], SearchConfig(), 2);
+			REQUIRE(result_response.m_Results.size() == expected.size());
+			REQUIRE(result_response.m_Strings.size() == expected.size());
+			for (size_t result = 0; result < expected.size(); ++result)
+			{
+				REQUIRE(result_response.m_Results[result].m_Id == expected[result].m_Id);
+				REQUIRE(result_response.m_Results[result].m_Score == expected[result].m_Score);
+				REQUIRE(result_response.m_Results.Matches(result).size() == expected.Matches(result).size());
+				REQUIRE(result_response.m_Strings[result] == expected_corpus.Get(expected[result].m_Id));
+			}
+		}
+	}
+
+	SECTION("latest wins")
+	{
+		Client client;
+		REQUIRE(client.Connect(socket_path));
+
+		// Typing "server" one keystroke at a time, every request replaces the ones before it
+		const std::string typed = "server";
+		request.m_Flags = RequestFlags::E_LATEST_WINS;
+		for (size_t length = 1; length <= typed.length(); ++length)
+		{
+			request.m_RequestId = static_cast<uint32_t>(length);
+			request.m_Pattern = typed.substr(0, length);
+			client.Send(request);
+		}
+		REQUIRE(client.Flush());
+
+		std::map<uint32_t, ResponseStatus> statuses;
+		for (size_t index = 0; index < typed.length(); ++index)
+		{
+			REQUIRE(client.Receive(response));
+			statuses[response.m_RequestId] = response.m_Status;
+			if (response.m_RequestId == typed.length())
+			{
+				REQUIRE(response.m_Results.size() == 2);
+			}
+		}
+		REQUIRE(statuses.size() == typed.length());
+		REQUIRE(statuses[static_cast<uint32_t>(typed.length())] == ResponseStatus::E_OK);
+		for (const auto& [request_id, status] : statuses)
+		{
+			REQUIRE((status == ResponseStatus::E_OK || status == ResponseStatus::E_SUPERSEDED));
+		}
+	}
+
+	SECTION("several clients and corpus updates")
+	{
+		Client first;
+		Client second;
+		REQUIRE(first.Connect(socket_path));
+		REQUIRE(second.Connect(socket_path));
+
+		request.m_Pattern = "newfile";
+		first.Send(request);
+		REQUIRE(first.Flush());
+		REQUIRE(first.Receive(response));
+		REQUIRE(response.m_Results.empty());
+
+		batch.Clear();
+		batch.Add("src/NewFile.cpp");
+		corpus.Commit(batch);
+
+		second.Send(request);
+		REQUIRE(second.Flush());
+		REQUIRE(second.Receive(response));
+		REQUIRE(response.m_Version == 2);
+		REQUIRE(response.m_Results.size() == 1);
+		REQUIRE(response.m_Results[0].m_Id == 5);
+		REQUIRE(response.m_Strings.empty());
+
+		// A closed client does not take the server down
+		first.Close();
+		second.Send(request);
+		REQUIRE(second.Flush());
+		REQUIRE(second.Receive(response));
+		REQUIRE(response.m_Results.size() == 1);
+	}
+
+	server.Stop();
+	server_thread.join();
+	REQUIRE(server.RequestCount() > 0);
+}
+
+#endif
@@ -0,0 +1,88 @@
+#include <catch2/catch_all.hpp>
+
+#include <FuzzySearchSpscQueue.h>
+
+#include <memory>
+#include <thread>
+
+using namespace FuzzySearch;
+
+TEST_CASE("SpscQueue")
+{
+	SECTION("capacity is rounded up to a power of two")
+	{
+		REQUIRE(SpscQueue<int>(1).Capacity() == 1);
+		REQUIRE(SpscQueue<int>(5).Capacity() == 8);
+		REQUIRE(SpscQueue<int>(16).Capacity() == 16);
+	}
+
+	SECTION("full and empty")
+	{
+		SpscQueue<int> queue(2);
+		int value = 0;
+		REQUIRE_FALSE(queue.TryPop(value));
+		REQUIRE(queue.TryPush(1));
+		REQUIRE(queue.TryPush(2));
+		REQUIRE_FALSE(queue.TryPush(3));
+		REQUIRE(queue.TryPop(value));
+		REQUIRE(value == 1);
+		REQUIRE(queue.TryPush(3));
+		REQUIRE(queue.TryPop(value));
+		REQUIRE(value == 2);
+		REQUIRE(queue.TryPop(value));
+		REQUIRE(value == 3);
+		REQUIRE_FALSE(queue.TryPop(value));
+	}
+
+	SECTION("pop times out on an empty queue")
+	{
+		SpscQueue<int> queue(4);
+		int value = 0;
+		REQUIRE(queue.Pop(value, std::chrono::milliseconds(0)) == QueueResult::E_TIMEOUT);
+		REQUIRE(queue.Pop(value, std::chrono::milliseconds(5)) == QueueResult::E_TIMEOUT);
+	}
+
+	SECTION("items pushed before close are drained")
+	{
+		SpscQueue<std::unique_ptr<int>> queue(4);
+		queue.Push(std::make_unique<int>(1));
+		queue.Push(std::make_unique<int>(2));
+		queue.Close();
+
+		std::unique_ptr<int> value;
+		REQUIRE(queue.Pop(value) == QueueResult::E_ITEM);
+		REQUIRE(*value == 1);
+		REQUIRE(queue.Pop(value) == QueueResult::E_ITEM);
+		REQUIRE(*value == 2);
+		REQUIRE(queue.Pop(value) == QueueResult::E_CLOSED);
+		REQUIRE(queue.Pop(value, std::chrono::milliseconds(0)) == QueueResult::E_CLOSED);
+	}
+
+	SECTION("order is kept across threads")
+	{
+		// A small queue makes both sides wait for each other many times
+		constexpr int item_count = 100000;
+		SpscQueue<int> queue(4);
+		std::thread producer([&queue]()
+		{
+			for (int item = 0; item < item_count; ++item)
+			{
+				queue.Push(int(item));
+			}
+			queue.Close();
+		});
+
+		int expected = 0;
+		int value = 0;
+		bool in_order = true;
+		while (queue.Pop(value) == QueueResult::E_ITEM)
+		{
+			in_order = in_order && value == expected;
+			++expected;
+		}
+		producer.join();
+
+		REQUIRE(in_order);
+		REQUIRE(expected == item_count);
+	}
+}
@@ -0,0 +1,147 @@
+#include <catch2/catch_all.hpp>
+
+#include <FuzzySearchStreamFilter.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace FuzzySearch;
+
+namespace
+{
+	// Hands out the input a few bytes at a time, so lines are split across reads
+	struct ChunkedInput
+	{
+		size_t operator()(char* buffer, size_t size)
+		{
+			const size_t read_size = std::min({ size, m_ChunkSize, m_Input.size() - m_Position });
+			std::memcpy(buffer, m_Input.data() + m_Position, read_size);
+			m_Position += read_size;
+			return read_size;
+		}
+
+		std::string m_Input;
+		size_t m_ChunkSize = 0;
+		size_t m_Position = 0;
+	};
+}
+
+TEST_CASE("StreamFilter")
+{
+	std::vector<std::string> lines;
+	for (int index = 0; index < 3000; ++index)
+	{
+		lines.push_back("src/module" + std::to_string(index % 97) + "/FuzzySearchStreamFilter" + std::to_string(index) + ".inl");
+		lines.push_back("test/TestFuzzySearch" + std::to_string(index) + ".cpp");
+	}
+	// Ties with earlier lines, only the first of them may be kept
+	lines.push_back(lines[0]);
+	lines.push_back("");
+
+	std::string input;
+	Corpus corpus;
+	for (size_t index = 0; index < lines.size(); ++index)
+	{
+		// Mixed line endings, carriage returns are not part of the lines
+		input += lines[index] + (index % 2 == 0 ? "\r\n" : "\n");
+		corpus.Add(lines[index]);
+	}
+
+	StreamFilterConfig config;
+	config.m_SearchConfig.m_MatchMode = MatchMode::E_SOURCE_FILES;
+	config.m_MatchThreadCount = 2;
+	config.m_QueueCapacity = 2;
+	config.m_UpdateInterval = std::chrono::milliseconds(0);
+
+	auto require_corpus_results = [&](const std::string& pattern, const StreamFilterConfig& filter_config, size_t chunk_size)
+	{
+		INFO(pattern << " read size " << filter_config.m_ReadSize << " chunk size " << chunk_size);
+		const CorpusSearchResults expected = corpus.Search(pattern, filter_config.m_SearchConfig, filter_config.m_MaxResults);
+
+		ChunkedInput read{ input, chunk_size };
+		std::vector<StreamMatch> results;
+		size_t final_count = 0;
+		StreamFilter filter(pattern, filter_config);
+		const StreamStats stats = filter.Run(read, [&](const std::vector<StreamMatch>& update, bool is_final)
+		{
+			REQUIRE(update.size() <= filter_config.m_MaxResults);
+			REQUIRE(std::is_sorted(update.begin(), update.end(), [](const StreamMatch& lhs, const StreamMatch& rhs) { return lhs.m_Score > rhs.m_Score; }));
+			final_count += is_final ? 1 : 0;
+			results = update;
+		});
+
+		REQUIRE(final_count == 1);
+		REQUIRE(stats.m_Lines == lines.size());
+		REQUIRE(stats.m_Bytes == input.size());
+		REQUIRE(stats.m_Updates >= 1);
+		REQUIRE(results.size() == expected.size());
+		for (size_t index = 0; index < results.size(); ++index)
+		{
+			REQUIRE(results[index].m_Index == expected[index].m_Id);
+			REQUIRE(results[index].m_Score == expected[index].m_Score);
+			REQUIRE(results[index].m_Line == lines[results[index].m_Index]);
+			REQUIRE(std::equal(results[index].m_Matches.begin(), results[index].m_Matches.end(), expected.Matches(index).begin(), expected.Matches(index).end()));
+		}
+		return stats;
+	};
+
+	SECTION("same results as a corpus search")
+	{
+		for (const char* pattern : { "stream filter 42", "module7", "test", "inl" })
+		{
+			for (size_t max_results : { 1, 10, 100 })
+			{
+				config.m_MaxResults = max_results;
+				config.m_ReadSize = 4096;
+				require_corpus_results(pattern, config, 4096);
+				config.m_ReadSize = 1000;
+				require_corpus_results(pattern, config, 7);
+			}
+		}
+	}
+
+	SECTION("counts every matching line, not only the kept ones")
+	{
+		config.m_MaxResults = 5;
+		const StreamStats stats = require_corpus_results("test", config, 100);
+		REQUIRE(stats.m_Matches >= 3000);
+	}
+
+	SECTION("updates arrive while reading")
+	{
+		config.m_MaxResults = 10;
+		config.m_ReadSize = 64;
+		const StreamStats stats = require_corpus_results("module", config, 64);
+		REQUIRE(stats.m_Updates > 1);
+	}
+
+	SECTION("input without a final line break")
+	{
+		// Replaces the empty last line and its line break
+		input.pop_back();
+		input += "last/FuzzySearchStreamFilter.h";
+		lines.back() = "last/FuzzySearchStreamFilter.h";
+		corpus = Corpus();
+		for (const std::string& line : lines)
+		{
+			corpus.Add(line);
+		}
+		config.m_MaxResults = 3;
+		require_corpus_results("last stream", config, 13);
+	}
+
+	SECTION("empty input")
+	{
+		input.clear();
+		StreamFilter filter("stream", config);
+		size_t update_count = 0;
+		const StreamStats stats = filter.Run(ChunkedInput{ input, 16 }, [&](const std::vector<StreamMatch>& update, bool is_final)
+		{
+			REQUIRE(update.empty());
+			REQUIRE(is_final);
+			++update_count;
+		});
+		REQUIRE(update_count == 1);
+		REQUIRE(stats.m_Lines == 0);
+	}
+}
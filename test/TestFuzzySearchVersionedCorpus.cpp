@@ -0,0 +1,129 @@
+#include <catch2/catch_all.hpp>
+
+#include <FuzzySearchSearcher.h>
+#include <FuzzySearchVersionedCorpus.h>
+
+#include <atomic>
+#include <thread>
+
+using namespace FuzzySearch;
+
+static std::string NumberedFile(int number)
+{
+	return "e:/libs/nodehierarchy/main/source/BaseHierarchyNode" + std::to_string(number) + ".h";
+}
+
+TEST_CASE("VersionedCorpus")
+{
+	SearchConfig search_config;
+	search_config.m_MatchMode = MatchMode::E_SOURCE_FILES;
+	search_config.m_MaxUnmatchedCharactersFromPattern = 0;
+
+	CorpusConfig corpus_config;
+	corpus_config.m_BlockSummaries = true;
+	VersionedCorpus versioned_corpus(corpus_config);
+	REQUIRE(versioned_corpus.Acquire()->Size() == 0);
+
+	SECTION("snapshots")
+	{
+		CorpusBatch batch;
+		for (int number = 0; number < 100; ++number)
+		{
+			batch.Add(NumberedFile(number));
+		}
+		std::vector<uint32_t> added_ids;
+		REQUIRE(versioned_corpus.Commit(batch, &added_ids) == 1);
+		REQUIRE(added_ids.size() == 100);
+		REQUIRE(added_ids[42] == 42);
+
+		// A pinned snapshot does not see later commits
+		const VersionedCorpus::Snapshot snapshot = versioned_corpus.Acquire();
+		batch.Clear();
+		batch.Remove(42);
+		batch.Rename(7, "e:/libs/renamed.txt");
+		batch.Compact();
+		REQUIRE(versioned_corpus.Commit(batch) == 2);
+
+		REQUIRE(snapshot->Get(42) == NumberedFile(42));
+		REQUIRE(snapshot->Search("bhn", search_config).size() == 100);
+
+		const VersionedCorpus::Snapshot latest = versioned_corpus.Acquire();
+		REQUIRE(latest->IsRemoved(42));
+		REQUIRE(latest->Get(7) == "e:/libs/renamed.txt");
+		REQUIRE(latest->Search("bhn", search_config).size() == 98);
+		REQUIRE(versioned_corpus.Version() == 2);
+
+		// The compaction freed id 42 for the next add
+		batch.Clear();
+		batch.Add("e:/libs/new.txt");
+		added_ids.clear();
+		versioned_corpus.Commit(batch, &added_ids);
+		REQUIRE(added_ids == std::vector<uint32_t>{ 42 });
+	}
+
+	SECTION("previous version reuse")
+	{
+		// Without readers every commit brings the previous version up to date instead of copying
+		Corpus expected_corpus(corpus_config);
+		for (int commit = 0; commit < 10; ++commit)
+		{
+			CorpusBatch batch;
+			for (int number = 0; number < 20; ++number)
+			{
+				batch.Add(NumberedFile(commit * 20 + number));
+			}
+			batch.Remove(static_cast<uint32_t>(commit * 13));
+			batch.Rename(static_cast<uint32_t>(commit * 20 + 1), "e:/libs/renamed" + std::to_string(commit) + ".txt");
+			batch.ApplyTo(expected_corpus);
+			versioned_corpus.Commit(batch);
+		}
+		REQUIRE(versioned_corpus.CopyCount() == 0);
+
+		const VersionedCorpus::Snapshot snapshot = versioned_corpus.Acquire();
+		REQUIRE(snapshot->Size() == expected_corpus.Size());
+		for (uint32_t id = 0; id < static_cast<uint32_t>(expected_corpus.Size()); ++id)
+		{
+			REQUIRE(snapshot->Get(id) == expected_corpus.Get(id));
+		}
+
+		// Holding the published version forces one copy, the commit after that can reuse again
+		CorpusBatch batch;
+		batch.Add("e:/libs/new.txt");
+		versioned_corpus.Commit(batch);
+		versioned_corpus.Commit(batch);
+		REQUIRE(versioned_corpus.CopyCount() == 1);
+	}
+
+	SECTION("concurrent readers")
+	{
+		// Every commit adds 10 matching strings, a consistent snapshot always has a multiple of 10 results
+		std::atomic<bool> done{ false };
+		std::atomic<bool> consistent{ true };
+		std::thread reader([&]()
+		{
+			Searcher searcher;
+			while (!done)
+			{
+				const VersionedCorpus::Snapshot snapshot = versioned_corpus.Acquire();
+				searcher.SetCorpus(snapshot.get());
+				const size_t result_count = searcher.Search("bhn", search_config).size();
+				consistent = consistent && result_count == snapshot->Size() && result_count % 10 == 0;
+			}
+		});
+
+		for (int commit = 0; commit < 100; ++commit)
+		{
+			CorpusBatch batch;
+			for (int number = 0; number < 10; ++number)
+			{
+				batch.Add(NumberedFile(commit * 10 + number));
+			}
+			versioned_corpus.Commit(batch);
+		}
+		done = true;
+		reader.join();
+
+		REQUIRE(consistent);
+		REQUIRE(versioned_corpus.Acquire()->Size() == 1000);
+	}
+}
@@ -0,0 +1,116 @@
+#include <catch2/catch_all.hpp>
+
+#include "TemporaryTree.h"
+
+#include <FuzzySearchWatcher.h>
+
+#include <set>
+
+using namespace FuzzySearch;
+
+#if defined(__linux__)
+
+static std::set<std::string> LivePaths(const Corpus& corpus)
+{
+	std::set<std::string> paths;
+	for (uint32_t id = 0; id < static_cast<uint32_t>(corpus.Size()); ++id)
+	{
+		if (!corpus.IsRemoved(id))
+		{
+			paths.insert(std::string(corpus.Get(id)));
+		}
+	}
+	return paths;
+}
+
+TEST_CASE("Watcher")
+{
+	TemporaryTree tree({ "src/main.cpp", "src/lib/lib.cpp", "src/lib/lib.h", "build/out.o", "README.md" });
+
+	WatcherConfig config;
+	config.m_CrawlerConfig.m_ThreadCount = 2;
+	config.m_CrawlerConfig.m_IgnorePatterns = { "*.o" };
+	config.m_QuietPeriod = std::chrono::milliseconds(20);
+
+	VersionedCorpus corpus;
+	Watcher watcher(corpus, config);
+	REQUIRE(watcher.Start({ tree.Root() }));
+	REQUIRE(watcher.WatchCount() == 4);
+	REQUIRE(LivePaths(*corpus.Acquire()) == std::set<std::string>{ tree.Path("src/main.cpp"), tree.Path("src/lib/lib.cpp"), tree.Path("src/lib/lib.h"), tree.Path("README.md") });
+
+	uint32_t lib_id = 0;
+	REQUIRE(watcher.FindId(tree.Path("src/lib/lib.cpp"), lib_id));
+	REQUIRE(corpus.Acquire()->Get(lib_id) == tree.Path("src/lib/lib.cpp"));
+
+	// One burst: new files, a new directory with files, a removed file, a moved directory and a file that comes and goes
+	tree.AddFile("src/added.cpp");
+	tree.AddFile("build/ignored.o");
+	tree.AddFile("tests/deep/test.cpp");
+	tree.AddFile("tests/deep/test2.cpp");
+	std::filesystem::remove(tree.Path("README.md"));
+	std::filesystem::rename(tree.Path("src/lib"), tree.Path("lib"));
+	tree.AddFile("temporary.txt");
+	std::filesystem::remove(tree.Path("temporary.txt"));
+
+	REQUIRE(watcher.Poll(std::chrono::milliseconds(1000)) > 0);
+	REQUIRE(LivePaths(*corpus.Acquire()) == std::set<std::string>{ tree.Path("src/main.cpp"), tree.Path("src/added.cpp"), tree.Path("tests/deep/test.cpp"),
+	                                                                tree.Path("tests/deep/test2.cpp"), tree.Path("lib/lib.cpp"), tree.Path("lib/lib.h") });
+	REQUIRE_FALSE(watcher.FindId(tree.Path("src/lib/lib.cpp"), lib_id));
+	REQUIRE(watcher.FindId(tree.Path("lib/lib.cpp"), lib_id));
+
+	// Directories picked up by the last commit are watched too
+	tree.AddFile("tests/deep/test3.cpp");
+	std::filesystem::remove_all(tree.Path("lib"));
+	REQUIRE(watcher.Poll(std::chrono::milliseconds(1000)) > 0);
+	REQUIRE(LivePaths(*corpus.Acquire()) == std::set<std::string>{ tree.Path("src/main.cpp"), tree.Path("src/added.cpp"), tree.Path("tests/deep/test.cpp"),
+	                                                                tree.Path("tests/deep/test2.cpp"), tree.Path("tests/deep/test3.cpp") });
+
+	REQUIRE(watcher.Poll(std::chrono::milliseconds(10)) == 0);
+
+	// Same on the background thread
+	watcher.RunInBackground();
+	tree.AddFile("src/background.cpp");
+	const VersionedCorpus::Snapshot before = corpus.Acquire();
+	for (int attempt = 0; attempt < 200 && corpus.Acquire() == before; ++attempt)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	watcher.Stop();
+	REQUIRE(LivePaths(*corpus.Acquire()).count(tree.Path("src/background.cpp")) == 1);
+}
+
+TEST_CASE("Watcher compaction")
+{
+	std::vector<std::string> files;
+	for (int index = 10; index < 22; ++index)
+	{
+		files.push_back("file" + std::to_string(index) + ".txt");
+	}
+	TemporaryTree tree(files);
+
+	WatcherConfig config;
+	config.m_CrawlerConfig.m_ThreadCount = 2;
+	config.m_QuietPeriod = std::chrono::milliseconds(20);
+
+	VersionedCorpus corpus;
+	Watcher watcher(corpus, config);
+	REQUIRE(watcher.Start({ tree.Root() }));
+	REQUIRE(corpus.Acquire()->DeadBytes() == 0);
+
+	// Half of the bytes die in one commit, which compacts
+	for (size_t index = 0; index < 6; ++index)
+	{
+		std::filesystem::remove(tree.Path(files[index]));
+	}
+	REQUIRE(watcher.Poll(std::chrono::milliseconds(1000)) == 6);
+	REQUIRE(corpus.Acquire()->RemovedCount() == 6);
+	REQUIRE(corpus.Acquire()->DeadBytes() == 0);
+
+	// The tombstones stay, but a small removal afterwards does not compact again
+	std::filesystem::remove(tree.Path(files[6]));
+	REQUIRE(watcher.Poll(std::chrono::milliseconds(1000)) == 1);
+	REQUIRE(corpus.Acquire()->DeadBytes() == tree.Path(files[6]).length());
+	REQUIRE(LivePaths(*corpus.Acquire()).size() == 5);
+}
+
+#endif